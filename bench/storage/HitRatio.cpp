@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <afina/Storage.h>
+
+#include "storage/ARC.h"
+#include "storage/SimpleLRU.h"
+#include "storage/TinyLFU.h"
+
+using namespace Afina;
+using namespace Afina::Backend;
+
+// Hit ratio comparison of storage eviction policies on synthetic traces. Each trace is replayed as
+// "cache-aside" client would do: Get and on miss Put the same key
+
+namespace {
+
+const size_t kKeySize = 24;
+const size_t kValueSize = 100;
+
+// Generates keys ranks in [0, n) with probability of rank k proportional to 1 / (k + 1)^s
+class Zipf {
+public:
+    Zipf(size_t n, double s) : _cdf(n) {
+        double sum = 0;
+        for (size_t k = 0; k < n; k++) {
+            sum += 1.0 / std::pow(double(k + 1), s);
+            _cdf[k] = sum;
+        }
+        for (auto &p : _cdf) {
+            p /= sum;
+        }
+    }
+
+    template <typename Random> size_t operator()(Random &random) {
+        double p = std::uniform_real_distribution<double>(0, 1)(random);
+        return std::min(_cdf.size() - 1, size_t(std::lower_bound(_cdf.begin(), _cdf.end(), p) - _cdf.begin()));
+    }
+
+private:
+    std::vector<double> _cdf;
+};
+
+std::string make_key(const char *prefix, size_t id) {
+    std::string key = prefix + std::to_string(id);
+    key.resize(kKeySize, '.');
+    return key;
+}
+
+// Zipfian popularity over the whole universe
+std::vector<std::string> zipf_trace(size_t universe, size_t length, double s) {
+    std::mt19937_64 random(42);
+    Zipf zipf(universe, s);
+    std::vector<std::string> trace;
+    trace.reserve(length);
+    for (size_t i = 0; i < length; i++) {
+        trace.push_back(make_key("key:", zipf(random)));
+    }
+    return trace;
+}
+
+// Zipfian traffic interleaved with long scans over keys nobody asks for again
+std::vector<std::string> scan_trace(size_t universe, size_t length, double s, size_t scan_length) {
+    std::mt19937_64 random(42);
+    Zipf zipf(universe, s);
+    std::vector<std::string> trace;
+    trace.reserve(length);
+    size_t scan_id = 0;
+    while (trace.size() < length) {
+        for (size_t i = 0; i < scan_length && trace.size() < length; i++) {
+            trace.push_back(make_key("key:", zipf(random)));
+        }
+        for (size_t i = 0; i < scan_length && trace.size() < length; i++) {
+            trace.push_back(make_key("scan:", scan_id++));
+        }
+    }
+    return trace;
+}
+
+double hit_ratio(Storage &storage, const std::vector<std::string> &trace) {
+    const std::string value(kValueSize, 'v');
+    std::string out;
+    size_t hits = 0;
+    for (auto &key : trace) {
+        if (storage.Get(key, out)) {
+            hits++;
+        } else {
+            storage.Put(key, value);
+        }
+    }
+    return double(hits) / trace.size();
+}
+
+} // namespace
+
+int main() {
+    const size_t universe = 100000;
+    const size_t length = 2000000;
+
+    struct Trace {
+        const char *name;
+        std::vector<std::string> keys;
+    };
+    std::vector<Trace> traces;
+    traces.push_back({"zipf-0.8", zipf_trace(universe, length, 0.8)});
+    traces.push_back({"zipf-0.99", zipf_trace(universe, length, 0.99)});
+    traces.push_back({"zipf-0.99+scan", scan_trace(universe, length, 0.99, 20000)});
+
+    struct Policy {
+        const char *name;
+        std::function<std::unique_ptr<Storage>(size_t)> create;
+    };
+    std::vector<Policy> policies = {
+        {"lru", [](size_t size) { return std::unique_ptr<Storage>(new SimpleLRU(size)); }},
+        {"clock",
+         [](size_t size) { return std::unique_ptr<Storage>(new SimpleLRU(size, SimpleLRU::Eviction::kClock)); }},
+        {"tinylfu", [](size_t size) { return std::unique_ptr<Storage>(new TinyLFU(size)); }},
+        {"arc", [](size_t size) { return std::unique_ptr<Storage>(new ARC(size)); }},
+    };
+
+    std::printf("%-16s %-8s", "trace", "cache");
+    for (auto &policy : policies) {
+        std::printf(" %10s", policy.name);
+    }
+    std::printf("\n");
+
+    for (auto &trace : traces) {
+        for (size_t percent : {1, 5, 10}) {
+            size_t entries = universe * percent / 100;
+            std::printf("%-16s %7zu%%", trace.name, percent);
+            for (auto &policy : policies) {
+                size_t budget = entries * std::max({SimpleLRU::EntrySize(kKeySize, kValueSize),
+                                                    TinyLFU::EntrySize(kKeySize, kValueSize),
+                                                    ARC::EntrySize(kKeySize, kValueSize)});
+                std::unique_ptr<Storage> storage = policy.create(budget);
+                std::printf(" %9.2f%%", 100 * hit_ratio(*storage, trace.keys));
+            }
+            std::printf("\n");
+        }
+    }
+    return 0;
+}
@@ -1,7 +1,16 @@
 #ifndef AFINA_STORAGE_H
 #define AFINA_STORAGE_H
 
+#include <algorithm>
+#include <cstdint>
+#include <ctime>
+#include <functional>
 #include <string>
+#include <utility>
+#include <vector>
+
+#include <afina/StringRef.h>
+#include <afina/ValueRef.h>
 
 namespace Afina {
 
@@ -16,6 +25,28 @@ public:
     virtual void Start() {}
     virtual void Stop() {}
 
+    /**
+     * Attributes stored along with the value
+     */
+    struct Meta {
+        Meta() : expire(0), version(0), flags(0) {}
+
+        // Unix time, in seconds, when association expires. Zero means never, any moment in the past makes
+        // association expired right away
+        int64_t expire;
+
+        // Version of the association, storage assigns new one on every change of the value. Output only: it is
+        // returned by MultiGet and ignored by all modifications, see CompareAndSet
+        uint64_t version;
+
+        // Opaque client value stored along with the association and returned as is, memcached flags. Replaced by
+        // every modification that takes attributes, kept by the rest: append, prepend, incr and decr
+        uint32_t flags;
+
+        // Is association already expired at the given moment
+        bool expired(int64_t now) const { return expire != 0 && expire <= now; }
+    };
+
     /**
      * Stores association between given key/value pair.
      * If key is already present in storage then replace existing value by
@@ -30,6 +61,40 @@ public:
      */
     virtual bool Put(const std::string &key, const std::string &value) = 0;
 
+    /**
+     * Same as Put, but association also gets given attributes. Once association expires any subsequent access
+     * to storage must indicate that association doesn't exist.
+     *
+     * Default implementation ignores the rest of attributes, but backends without expiration support can't keep
+     * the promise, so association that expires later is refused: method returns false and nothing changes.
+     * Association that has already expired gets removed right away.
+     *
+     * @param key to be associated with value
+     * @param value to be assigned for the key
+     * @param meta attributes of the association
+     */
+    virtual bool Put(const std::string &key, const std::string &value, const Meta &meta) {
+        int64_t now = std::time(nullptr);
+        if (!meta.expired(now) && meta.expire != 0) {
+            return false;
+        }
+        if (!Put(key, value)) {
+            return false;
+        }
+        if (meta.expired(now)) {
+            Delete(key);
+        }
+        return true;
+    }
+
+    /**
+     * Same as Put, but key is referenced rather than owned by the caller, see StringRef.
+     *
+     * Default implementation, as well as all other StringRef based ones, copies key into std::string, backends
+     * able to lookup keys by bytes avoid that allocation.
+     */
+    virtual bool Put(StringRef key, const std::string &value, const Meta &meta) { return Put(key.str(), value, meta); }
+
     /**
      * Stores association between given key/value pair if key isn't present in
      * storage.
@@ -43,6 +108,30 @@ public:
      */
     virtual bool PutIfAbsent(const std::string &key, const std::string &value) = 0;
 
+    /**
+     * Same as PutIfAbsent, but association also gets given attributes, see Put
+     */
+    virtual bool PutIfAbsent(const std::string &key, const std::string &value, const Meta &meta) {
+        int64_t now = std::time(nullptr);
+        if (!meta.expired(now) && meta.expire != 0) {
+            return false;
+        }
+        if (!PutIfAbsent(key, value)) {
+            return false;
+        }
+        if (meta.expired(now)) {
+            Delete(key);
+        }
+        return true;
+    }
+
+    /**
+     * Same as PutIfAbsent, but key is referenced, see Put
+     */
+    virtual bool PutIfAbsent(StringRef key, const std::string &value, const Meta &meta) {
+        return PutIfAbsent(key.str(), value, meta);
+    }
+
     /**
      * Updates existing association between given key/value pair
      * If requested key doesn't present in storage method returns false and
@@ -56,6 +145,121 @@ public:
      */
     virtual bool Set(const std::string &key, const std::string &value) = 0;
 
+    /**
+     * Same as Set, but association also gets given attributes, see Put
+     */
+    virtual bool Set(const std::string &key, const std::string &value, const Meta &meta) {
+        int64_t now = std::time(nullptr);
+        if (!meta.expired(now) && meta.expire != 0) {
+            return false;
+        }
+        if (!Set(key, value)) {
+            return false;
+        }
+        if (meta.expired(now)) {
+            Delete(key);
+        }
+        return true;
+    }
+
+    /**
+     * Same as Set, but key is referenced, see Put
+     */
+    virtual bool Set(StringRef key, const std::string &value, const Meta &meta) { return Set(key.str(), value, meta); }
+
+    /**
+     * Adds given data to the end of the value associated with the key. Attributes of the association stay
+     * unchanged. If key isn't present in storage method returns false and doesn't change anything.
+     *
+     * Concurrent appends to the same key must never lose data. Default implementation is Get followed by Set,
+     * which doesn't guarantee that, so thread safe backends override it.
+     *
+     * @param key to update value of
+     * @param data to be added to the value
+     */
+    virtual bool Append(const std::string &key, const std::string &data) {
+        std::string value;
+        if (!Get(key, value)) {
+            return false;
+        }
+        return Set(key, value + data);
+    }
+
+    /**
+     * Same as Append, but data is added to the beginning of the value
+     */
+    virtual bool Prepend(const std::string &key, const std::string &data) {
+        std::string value;
+        if (!Get(key, value)) {
+            return false;
+        }
+        return Set(key, data + value);
+    }
+
+    /**
+     * Outcome of the conditional update, see CompareAndSet
+     */
+    enum class CasStatus {
+        kStored,  // value is updated
+        kExists,   // association has been changed since the version was read
+        kNotFound, // key isn't present
+        kNotStored // value can't be stored at all, for example it is too large
+    };
+
+    /**
+     * Same as Set, but association is updated only if it still has the given version, see Meta::version. Lets
+     * clients do read-modify-write without locks: read value along with its version, then write the new value
+     * back unless somebody has changed it meanwhile.
+     *
+     * Default implementation uses hash of the value as a version and is Get followed by Set, so it could miss
+     * concurrent update.
+     *
+     * @param key to update value of
+     * @param value to be assigned for the key
+     * @param meta attributes of the association
+     * @param version association must have to be updated
+     */
+    virtual CasStatus CompareAndSet(const std::string &key, const std::string &value, const Meta &meta,
+                                    uint64_t version) {
+        std::string current;
+        if (!Get(key, current)) {
+            return CasStatus::kNotFound;
+        }
+        if (version_of(current.data(), current.size()) != version) {
+            return CasStatus::kExists;
+        }
+        return Set(key, value, meta) ? CasStatus::kStored : CasStatus::kNotStored;
+    }
+
+    /**
+     * Outcome of the counter update, see Increment
+     */
+    enum class CounterStatus {
+        kUpdated,  // value is updated
+        kNotFound, // key isn't present
+        kNotNumber // value isn't a decimal 64-bit unsigned number
+    };
+
+    /**
+     * Treats value associated with the key as a decimal 64-bit unsigned number and adds delta to it, wrapping
+     * around on overflow. Attributes of the association stay unchanged. As for Append concurrent updates must
+     * never be lost, default implementation is Get followed by Set and doesn't guarantee that.
+     *
+     * @param key to update value of
+     * @param delta to be added to the value
+     * @param value output parameter the updated value is written to
+     */
+    virtual CounterStatus Increment(const std::string &key, uint64_t delta, uint64_t &value) {
+        return update_counter(key, delta, false, value);
+    }
+
+    /**
+     * Same as Increment, but delta is subtracted. Result never goes below zero
+     */
+    virtual CounterStatus Decrement(const std::string &key, uint64_t delta, uint64_t &value) {
+        return update_counter(key, delta, true, value);
+    }
+
     /**
      * Removes association for the given key
      * If requested key doesn't present in storage method returns false and
@@ -72,6 +276,11 @@ public:
      */
     virtual bool Delete(const std::string &key) = 0;
 
+    /**
+     * Same as Delete, but key is referenced, see Put
+     */
+    virtual bool Delete(StringRef key) { return Delete(key.str()); }
+
     /**
      * Retrive key for the given value
      * If there is an association for the given key then method copies value
@@ -84,6 +293,270 @@ public:
      * @param value output parameter to copy value to
      */
     virtual bool Get(const std::string &key, std::string &value) = 0;
+
+    /**
+     * Same as Get, but key is referenced, see Put
+     */
+    virtual bool Get(StringRef key, std::string &value) { return Get(key.str(), value); }
+
+    /**
+     * Same as Get, but instead of copying value returns handle pinning it, see ValueRef. Value referenced stays
+     * unchanged even if association gets updated or removed while handle is alive.
+     *
+     * Default implementation copies value into the handle, backends able to pin stored bytes avoid that copy.
+     *
+     * @param key to search for
+     * @param value handle of the value associated with the key
+     */
+    virtual bool Get(const std::string &key, ValueRef &value) {
+        std::string copy;
+        if (!Get(key, copy)) {
+            return false;
+        }
+        value = ValueRef::Copy(std::move(copy));
+        return true;
+    }
+
+    /**
+     * Same as Get, but key is referenced, see Put
+     */
+    virtual bool Get(StringRef key, ValueRef &value) {
+        std::string copy;
+        if (!Get(key, copy)) {
+            return false;
+        }
+        value = ValueRef::Copy(std::move(copy));
+        return true;
+    }
+
+    /**
+     * Batch version of Get. Storage could process the whole batch at once, for example take each lock only
+     * once and prefetch index memory for all keys before the first lookup.
+     *
+     * @param keys to search for
+     * @param values handles of values associated with keys, in the same order. Handle of missing key refers
+     * nothing, see ValueRef::operator bool
+     * @return number of keys found
+     */
+    std::size_t MultiGet(const std::vector<std::string> &keys, std::vector<ValueRef> &values) {
+        return MultiGet(refs_of(keys), values, nullptr, false);
+    }
+
+    /**
+     * Same as MultiGet, but also returns attributes of associations found, including their versions.
+     *
+     * @param keys to search for
+     * @param values handles of values associated with keys, in the same order
+     * @param metas attributes of associations, in the same order. Attributes of missing key are undefined
+     * @return number of keys found
+     */
+    std::size_t MultiGet(const std::vector<std::string> &keys, std::vector<ValueRef> &values,
+                         std::vector<Meta> &metas) {
+        return MultiGet(refs_of(keys), values, &metas, true);
+    }
+
+    /**
+     * Same as MultiGet, but keys are referenced, see Put, and attributes are returned only if metas isn't null.
+     * Meta::version is filled only if versions is set, storage that keeps versions could fill it anyway. All
+     * MultiGet overloads end up here, so that is the one backends implement.
+     *
+     * Default implementation looks keys up one by one. It has no versions stored, so it uses hash of the value
+     * instead, see version_of. Flags aren't stored either, so they are always zero.
+     */
+    virtual std::size_t MultiGet(const std::vector<StringRef> &keys, std::vector<ValueRef> &values,
+                                 std::vector<Meta> *metas, bool versions) {
+        std::size_t found = 0;
+        values.resize(keys.size());
+        if (metas != nullptr) {
+            metas->assign(keys.size(), Meta());
+        }
+        for (std::size_t i = 0; i < keys.size(); i++) {
+            values[i].reset();
+            if (Get(keys[i], values[i])) {
+                found++;
+                if (versions && metas != nullptr) {
+                    (*metas)[i].version = version_of(values[i].data(), values[i].size());
+                }
+            }
+        }
+        return found;
+    }
+
+    /**
+     * Batch version of Put, see MultiGet. Associations are stored in the given order, so later one wins if the
+     * same key appears twice
+     *
+     * @param keys to be associated with values
+     * @param values to be assigned for keys, in the same order
+     * @return number of associations stored
+     */
+    virtual std::size_t MultiPut(const std::vector<std::string> &keys, const std::vector<std::string> &values) {
+        std::size_t stored = 0;
+        for (std::size_t i = 0; i < keys.size() && i < values.size(); i++) {
+            if (Put(keys[i], values[i])) {
+                stored++;
+            }
+        }
+        return stored;
+    }
+
+    /**
+     * Association handed out by Export
+     */
+    struct Item {
+        Item(std::string &&key_, ValueRef &&value_, const Meta &meta_)
+            : key(std::move(key_)), value(std::move(value_)), meta(meta_) {}
+
+        std::string key;
+        ValueRef value;
+        Meta meta;
+    };
+
+    /**
+     * Hands every live association to visit, while storage keeps serving other calls. Storage is walked part
+     * by part, for example shard by shard: part is taken out under its lock with values pinned rather than
+     * copied where backend allows that, and is visited once the lock is released. So visit may take its time
+     * without blocking anybody, but associations of different parts could be taken at different moments.
+     * Associations of a part are visited from the least recently used one.
+     *
+     * Default implementation has no way to enumerate associations.
+     *
+     * @param visit called once per association
+     * @return false if storage doesn't support export
+     */
+    virtual bool Export(const std::function<void(Item &item)> &visit) { return false; }
+
+    /**
+     * Cursor based iteration over the keys. Each call appends keys of the next batch, about count of them, and
+     * returns the cursor to continue from, 0 once iteration is over. Iteration starts with cursor 0. Storage
+     * keeps serving other calls between batches and takes each lock only for a bounded batch: key present
+     * during the whole iteration is returned at least once, even if storage grows meanwhile, some keys could be
+     * returned more than once, keys added or removed meanwhile may or may not be returned.
+     *
+     * Default implementation is a fallback for storages without an index to walk: it takes keys from Export and
+     * uses the number of keys returned so far as the cursor, so each call goes over the whole storage, and the
+     * guarantee holds only while the order of Export is kept.
+     *
+     * @param cursor 0 or the value returned by the previous call
+     * @param count number of keys wanted
+     * @param keys to append keys of the batch to
+     * @return cursor of the next batch or 0
+     */
+    virtual uint64_t Scan(uint64_t cursor, std::size_t count, std::vector<std::string> &keys) {
+        uint64_t position = 0;
+        std::size_t first = keys.size();
+        std::size_t wanted = first + std::max<std::size_t>(count, 1);
+        bool more = false;
+        Export([&](Item &item) {
+            if (position++ < cursor) {
+                return;
+            }
+            if (keys.size() < wanted) {
+                keys.push_back(std::move(item.key));
+            } else {
+                more = true;
+            }
+        });
+        return more ? cursor + (keys.size() - first) : 0;
+    }
+
+    /**
+     * Appends statistics of the storage as name and value pairs, see memcached "stats" command. Default
+     * implementation has none
+     */
+    virtual void Stats(std::vector<std::pair<std::string, std::string>> &stats) {}
+
+    /**
+     * Callback for keys of associations storage drops by itself to make room for others
+     */
+    using EvictionListener = std::function<void(StringRef key)>;
+
+    /**
+     * Sets callback storage calls for every association it evicts. Callback is called within the operation that
+     * has caused eviction, under the same locks, so it sees evictions and modifications of the key in the order
+     * storage has applied them. It must not call storage back. Must be set before storage is used by others.
+     *
+     * Default implementation just keeps the callback, backends report evictions via evicted
+     */
+    virtual void SetEvictionListener(EvictionListener listener) { _eviction_listener = std::move(listener); }
+
+protected:
+    // Reports association dropped to make room, see SetEvictionListener
+    void evicted(StringRef key) const {
+        if (_eviction_listener) {
+            _eviction_listener(key);
+        }
+    }
+
+    /**
+     * Version of the value for backends that don't store versions: FNV-1a hash of its bytes. Equal values have
+     * the same version, so update that restores previous value is not detected
+     */
+    static uint64_t version_of(const char *data, std::size_t size) {
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        for (std::size_t i = 0; i < size; i++) {
+            hash = (hash ^ static_cast<unsigned char>(data[i])) * 0x100000001b3ULL;
+        }
+        return hash;
+    }
+
+    /**
+     * Parses value of the counter, see Increment. Returns false if value isn't a number
+     */
+    static bool parse_counter(const char *data, std::size_t size, uint64_t &value) {
+        if (size == 0 || size > 20) {
+            return false;
+        }
+        value = 0;
+        for (std::size_t i = 0; i < size; i++) {
+            if (data[i] < '0' || data[i] > '9') {
+                return false;
+            }
+            uint64_t next = value * 10 + (data[i] - '0');
+            if (value > UINT64_MAX / 10 || next < value * 10) {
+                return false;
+            }
+            value = next;
+        }
+        return true;
+    }
+
+    /**
+     * Value of the counter after update by delta, see Increment and Decrement
+     */
+    static uint64_t count(uint64_t value, uint64_t delta, bool decrement) {
+        if (decrement) {
+            return value > delta ? value - delta : 0;
+        }
+        return value + delta;
+    }
+
+private:
+    // References to the given keys, see MultiGet
+    static std::vector<StringRef> refs_of(const std::vector<std::string> &keys) {
+        std::vector<StringRef> refs;
+        refs.reserve(keys.size());
+        for (const std::string &key : keys) {
+            refs.emplace_back(key);
+        }
+        return refs;
+    }
+
+    // Default implementation of Increment and Decrement
+    CounterStatus update_counter(const std::string &key, uint64_t delta, bool decrement, uint64_t &value) {
+        std::string current;
+        if (!Get(key, current)) {
+            return CounterStatus::kNotFound;
+        }
+        if (!parse_counter(current.data(), current.size(), value)) {
+            return CounterStatus::kNotNumber;
+        }
+        value = count(value, delta, decrement);
+        return Set(key, std::to_string(value)) ? CounterStatus::kUpdated : CounterStatus::kNotFound;
+    }
+
+    // See SetEvictionListener
+    EvictionListener _eviction_listener;
 };
 
 } // namespace Afina
@@ -0,0 +1,41 @@
+#ifndef AFINA_STRING_REF_H
+#define AFINA_STRING_REF_H
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+namespace Afina {
+
+/**
+ * # Non owning reference to a string
+ * Pointer and length of bytes owned by somebody else, who must keep them alive while reference is used. Lets
+ * callers pass keys found right in their buffers without building temporary std::string.
+ *
+ * Implicitly constructible from std::string only, so calls with string literals keep resolving to std::string
+ * overloads.
+ */
+class StringRef {
+public:
+    StringRef(const char *data, std::size_t size) : _data(data), _size(size) {}
+    StringRef(const std::string &str) : _data(str.data()), _size(str.size()) {}
+
+    const char *data() const { return _data; }
+    std::size_t size() const { return _size; }
+
+    // Copy of the bytes
+    std::string str() const { return std::string(_data, _size); }
+
+    bool operator==(const StringRef &other) const {
+        return _size == other._size && std::memcmp(_data, other._data, _size) == 0;
+    }
+    bool operator!=(const StringRef &other) const { return !(*this == other); }
+
+private:
+    const char *_data;
+    std::size_t _size;
+};
+
+} // namespace Afina
+
+#endif // AFINA_STRING_REF_H
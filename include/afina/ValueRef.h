@@ -0,0 +1,93 @@
+#ifndef AFINA_VALUE_REF_H
+#define AFINA_VALUE_REF_H
+
+#include <cstddef>
+#include <string>
+
+namespace Afina {
+
+/**
+ * # Handle of the value bytes
+ * Refers bytes stored somewhere else, for example right inside the storage, and keeps them pinned: bytes stay
+ * valid and unchanged until the handle is destroyed, regardless of what happens with the association they came
+ * from. Handle is movable but not copyable, its owner is released exactly once.
+ */
+class ValueRef {
+public:
+    // Called once handle gives up the bytes
+    using Release = void (*)(void *owner);
+
+    ValueRef() : _data(nullptr), _size(0), _owner(nullptr), _release(nullptr) {}
+    ValueRef(const char *data, std::size_t size, void *owner, Release release)
+        : _data(data), _size(size), _owner(owner), _release(release) {}
+
+    ValueRef(ValueRef &&other)
+        : _data(other._data), _size(other._size), _owner(other._owner), _release(other._release) {
+        other._data = nullptr;
+        other._size = 0;
+        other._owner = nullptr;
+        other._release = nullptr;
+    }
+
+    ValueRef &operator=(ValueRef &&other) {
+        if (this != &other) {
+            reset();
+            _data = other._data;
+            _size = other._size;
+            _owner = other._owner;
+            _release = other._release;
+            other._data = nullptr;
+            other._size = 0;
+            other._owner = nullptr;
+            other._release = nullptr;
+        }
+        return *this;
+    }
+
+    ~ValueRef() { reset(); }
+
+    /**
+     * Handle holding its own copy of the given value
+     */
+    static ValueRef Copy(std::string &&value) {
+        std::string *owner = new std::string(std::move(value));
+        return ValueRef(owner->data(), owner->size(), owner, &release_string);
+    }
+
+    // Does handle refer any bytes
+    explicit operator bool() const { return _data != nullptr; }
+
+    const char *data() const { return _data; }
+    std::size_t size() const { return _size; }
+
+    // Copy of the bytes
+    std::string str() const { return std::string(_data, _size); }
+
+    /**
+     * Releases bytes, handle refers nothing afterwards
+     */
+    void reset() {
+        if (_release != nullptr) {
+            _release(_owner);
+        }
+        _data = nullptr;
+        _size = 0;
+        _owner = nullptr;
+        _release = nullptr;
+    }
+
+private:
+    ValueRef(const ValueRef &);            // = delete;
+    ValueRef &operator=(const ValueRef &); // = delete;
+
+    static void release_string(void *owner) { delete static_cast<std::string *>(owner); }
+
+    const char *_data;
+    std::size_t _size;
+    void *_owner;
+    Release _release;
+};
+
+} // namespace Afina
+
+#endif // AFINA_VALUE_REF_H
@@ -0,0 +1,68 @@
+#ifndef AFINA_CONCURRENCY_EPOCH_H
+#define AFINA_CONCURRENCY_EPOCH_H
+
+#include <atomic>
+#include <cstdint>
+
+namespace Afina {
+namespace Concurrency {
+
+/**
+ * # Epoch based memory reclamation
+ * Allows readers to traverse shared data structures without any locks while writers unlink and free elements
+ * concurrently.
+ *
+ * Reader wraps every access to shared data into Epoch::Guard, which announces the global epoch the thread has
+ * observed. Writer unlinks element so that new readers can't reach it anymore and passes it to Retire instead
+ * of deleting. Global epoch advances only once every reader inside Guard has observed the current one, so
+ * element retired in epoch E could be referenced by readers of epochs E and E + 1 only and is safe to free once
+ * global epoch reaches E + 2.
+ *
+ * Entering and leaving the guard is wait-free: a couple of atomic stores with no loops. Retired elements are
+ * kept in per thread lists and get freed in batches by the thread that retired them, elements left by exited
+ * threads are freed by any other thread.
+ */
+class Epoch {
+public:
+    /**
+     * Scoped reader critical section. Pointers loaded from shared data stay valid until guard is destroyed.
+     * Guards could be nested
+     */
+    class Guard {
+    public:
+        Guard();
+        ~Guard();
+
+    private:
+        Guard(const Guard &);            // = delete;
+        Guard &operator=(const Guard &); // = delete;
+    };
+
+    /**
+     * Schedules deleter(ptr) call once no reader could reference ptr anymore. Caller must have made ptr
+     * unreachable for new readers already
+     */
+    static void Retire(void *ptr, void (*deleter)(void *));
+
+    /**
+     * Blocks until every reader that was inside Guard at the moment of call leaves it. Must not be called from
+     * inside Guard
+     */
+    static void Synchronize();
+
+    /**
+     * Tries to advance global epoch and frees elements retired by calling thread which are safe to free
+     */
+    static void Collect();
+
+private:
+    // Number of elements thread retires before it tries to free some
+    static constexpr std::size_t kCollectBatch = 64;
+
+    static bool try_advance(uint64_t epoch);
+};
+
+} // namespace Concurrency
+} // namespace Afina
+
+#endif // AFINA_CONCURRENCY_EPOCH_H
@@ -0,0 +1,41 @@
+#ifndef AFINA_EXECUTE_CAS_H
+#define AFINA_EXECUTE_CAS_H
+
+#include <cstdint>
+#include <string>
+
+#include "InsertCommand.h"
+
+namespace Afina {
+namespace Execute {
+
+/**
+ * # Check and set data for the key
+ * Store this data, but only if no one else has updated it since client last
+ * fetched it by "gets", see Storage::CompareAndSet
+ *
+ * Command must write result to the output, which could be:
+ * - "STORED", to indicate success.
+ * - "EXISTS" to indicate that the item has been modified since it was fetched
+ * - "NOT_FOUND" to indicate that the item does not exist or has been deleted
+ * - "NOT_STORED" to indicate the data was not stored, for example because it is too large
+ */
+class Cas : public InsertCommand {
+public:
+    Cas(const std::string &key, uint32_t flags, int32_t expire, uint64_t version)
+        : InsertCommand(key, flags, expire), _version(version) {}
+    ~Cas() {}
+
+    inline uint64_t version() const { return _version; }
+
+    void Execute(Storage &storage, const std::string &args, std::string &out) override;
+
+private:
+    // <cas unique> sent by client, version item had once it was fetched
+    const uint64_t _version;
+};
+
+} // namespace Execute
+} // namespace Afina
+
+#endif // AFINA_EXECUTE_CAS_H
@@ -9,6 +9,8 @@ class Storage;
 
 namespace Execute {
 
+class Response;
+
 /**
  *
  *
@@ -19,6 +21,12 @@ public:
     virtual ~Command() {}
 
     virtual void Execute(Storage &storage, const std::string &args, std::string &out) = 0;
+
+    /**
+     * Same as above, but result is appended to the response, which could reference values right in the storage.
+     * Default implementation appends text produced by the method above
+     */
+    virtual void Execute(Storage &storage, const std::string &args, Response &out);
 };
 
 } // namespace Execute
@@ -4,6 +4,8 @@
 #include <string>
 #include <vector>
 
+#include <afina/StringRef.h>
+
 #include "Command.h"
 
 namespace Afina {
@@ -18,13 +20,16 @@ namespace Execute {
  * the items have been transmitted, the server sends the string
  *
  * Each item sent by the server looks like this:
- * VALUE <key> <bytes>\r\n
+ * VALUE <key> <flags> <bytes>\r\n
  * <data>\r\n
  * VALUE ....
  * END
  *
- * Where <key> is the key for the value, <bytes> is the number of bytes in the
- * value and <data> is the value text
+ * Where <key> is the key for the value, <flags> are the ones given on store,
+ * <bytes> is the number of bytes in the value and <data> is the value text
+ *
+ * "gets" command also sends version of each item, see Storage::Meta::version:
+ * VALUE <key> <flags> <bytes> <cas unique>\r\n
  *
  * If some of the keys appearing in a retrieval request are not sent back
  * by the server in the item list this means that the server does not
@@ -34,15 +39,34 @@ namespace Execute {
  */
 class Get : public Command {
 public:
-    Get(const std::vector<std::string> &keys) : _keys(keys) {}
+    Get(const std::vector<std::string> &keys, bool versions = false);
+
+    // Same as above, but keys are copied from the buffer they are referencing, see Protocol::Parser
+    Get(const std::vector<StringRef> &keys, bool versions);
     ~Get() {}
 
-    inline const std::vector<std::string> &keys() const { return _keys; }
+    // Copies of the keys
+    std::vector<std::string> keys() const;
+    inline bool versions() const { return _versions; }
 
     void Execute(Storage &storage, const std::string &args, std::string &out) override;
 
+    // Values are pinned in the storage instead of being copied into response
+    void Execute(Storage &storage, const std::string &args, Response &out) override;
+
 private:
-    std::vector<std::string> _keys;
+    Get(const Get &);            // = delete;
+    Get &operator=(const Get &); // = delete;
+
+    // Copies keys into _bytes and points _keys to them
+    template <typename K> void assign(const std::vector<K> &keys);
+
+    // Bytes of all keys one after another, single allocation per command
+    std::string _bytes;
+    std::vector<StringRef> _keys;
+
+    // Are versions of items sent as well
+    bool _versions;
 };
 
 } // namespace Execute
@@ -0,0 +1,40 @@
+#ifndef AFINA_EXECUTE_INCR_H
+#define AFINA_EXECUTE_INCR_H
+
+#include <cstdint>
+#include <string>
+
+#include "Command.h"
+
+namespace Afina {
+namespace Execute {
+
+/**
+ * # Increment counter
+ * Increment value of the key by the given amount, wrapping around at 64 bits. Value must be a decimal
+ * representation of a 64-bit unsigned integer
+ *
+ * Command must write result to the output, which could be:
+ * - new value of the counter, to indicate success
+ * - "NOT_FOUND" to indicate that the item with this key was not found
+ * - "CLIENT_ERROR cannot increment or decrement non-numeric value" if value isn't a number
+ */
+class Incr : public Command {
+public:
+    Incr(const std::string &key, uint64_t delta) : _key(key), _delta(delta) {}
+    ~Incr() {}
+
+    inline const std::string &key() const { return _key; }
+    inline uint64_t delta() const { return _delta; }
+
+    void Execute(Storage &storage, const std::string &args, std::string &out) override;
+
+private:
+    std::string _key;
+    uint64_t _delta;
+};
+
+} // namespace Execute
+} // namespace Afina
+
+#endif // AFINA_EXECUTE_INCR_H
@@ -2,8 +2,11 @@
 #define AFINA_EXECUTE_INSERT_COMMAND_H
 
 #include <cstdint>
+#include <ctime>
 #include <string>
 
+#include <afina/Storage.h>
+
 #include "Command.h"
 
 namespace Afina {
@@ -22,7 +25,27 @@ public:
     inline const uint32_t flags() const { return _flags; }
     inline const int32_t expire() const { return _expire; }
 
+    /**
+     * Attributes of the association to be stored. Following memcached, expiration time up to 30 days is
+     * relative to the current moment, anything larger is absolute unix time. Zero means never expire and negative
+     * value - expire immediately. Flags are stored as is
+     */
+    Storage::Meta meta() const {
+        Storage::Meta meta;
+        meta.flags = _flags;
+        if (_expire < 0) {
+            meta.expire = 1;
+        } else if (_expire > kMaxRelativeExpire) {
+            meta.expire = _expire;
+        } else if (_expire > 0) {
+            meta.expire = std::time(nullptr) + _expire;
+        }
+        return meta;
+    }
+
 protected:
+    static constexpr int32_t kMaxRelativeExpire = 60 * 60 * 24 * 30;
+
     const std::string _key;
     const uint32_t _flags;
     const int32_t _expire;
@@ -0,0 +1,62 @@
+#ifndef AFINA_EXECUTE_RESPONSE_H
+#define AFINA_EXECUTE_RESPONSE_H
+
+#include <string>
+#include <vector>
+
+#include <afina/ValueRef.h>
+
+namespace Afina {
+namespace Execute {
+
+/**
+ * # Command response
+ * Sequence of chunks to be sent to the client one after another: text produced by the command and values
+ * pinned right in the storage. Network layer sends all chunks with a single writev, so values never get copied
+ * on their way to the socket.
+ */
+class Response {
+public:
+    Response() {}
+
+    // Appends text chunk
+    void Append(const std::string &text) { Append(text.data(), text.size()); }
+    void Append(const char *data, std::size_t size);
+
+    // Appends value chunk, response keeps value pinned until destroyed
+    void Append(ValueRef &&value);
+
+    // Total number of bytes in the response
+    std::size_t size() const;
+
+    // Response content as a single string
+    std::string str() const;
+
+    /**
+     * Sends the whole response to the given socket, blocking if needed. Returns false on error, errno is set
+     * then
+     */
+    bool Send(int socket) const;
+
+private:
+    Response(const Response &);            // = delete;
+    Response &operator=(const Response &); // = delete;
+
+    // Part of the response: either range of _text or one of _values
+    struct chunk {
+        bool is_value;
+        std::size_t offset;
+        std::size_t size;
+    };
+
+    const char *chunk_data(const chunk &c) const;
+
+    std::string _text;
+    std::vector<ValueRef> _values;
+    std::vector<chunk> _chunks;
+};
+
+} // namespace Execute
+} // namespace Afina
+
+#endif // AFINA_EXECUTE_RESPONSE_H
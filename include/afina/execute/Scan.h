@@ -0,0 +1,48 @@
+#ifndef AFINA_EXECUTE_SCAN_H
+#define AFINA_EXECUTE_SCAN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "Command.h"
+
+namespace Afina {
+namespace Execute {
+
+/**
+ * # Iterate over the keys
+ * Not a part of memcached protocol: returns the next batch of keys stored, see Storage::Scan. Iteration starts
+ * with cursor 0 and is over once the next cursor returned is 0
+ *
+ * scan <cursor> [<count>]\r\n
+ *
+ * Command must write zero or more lines
+ * KEY <key>\r\n
+ * followed by the cursor of the next batch
+ * CURSOR <cursor>\r\n
+ * END
+ */
+class Scan : public Command {
+public:
+    // Batch size if client hasn't asked for any and the maximum one
+    static constexpr std::size_t kDefaultCount = 100;
+    static constexpr std::size_t kMaxCount = 10000;
+
+    Scan(uint64_t cursor, std::size_t count = kDefaultCount) : _cursor(cursor), _count(count) {}
+    ~Scan() {}
+
+    inline uint64_t cursor() const { return _cursor; }
+    inline std::size_t count() const { return _count; }
+
+    void Execute(Storage &storage, const std::string &args, std::string &out) override;
+
+private:
+    uint64_t _cursor;
+    std::size_t _count;
+};
+
+} // namespace Execute
+} // namespace Afina
+
+#endif // AFINA_EXECUTE_SCAN_H
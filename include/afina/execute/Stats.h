@@ -8,6 +8,15 @@
 namespace Afina {
 namespace Execute {
 
+/**
+ * # Storage statistics
+ * stats\r\n
+ *
+ * Command must write a line per statistic the storage has, see Storage::Stats
+ * STAT <name> <value>\r\n
+ * followed by
+ * END
+ */
 class Stats : public Command {
 public:
     Stats() {}
@@ -0,0 +1,167 @@
+#include <afina/concurrency/Epoch.h>
+
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace Afina {
+namespace Concurrency {
+
+namespace {
+
+// Element waiting to be freed
+struct retired {
+    uint64_t epoch;
+    void *ptr;
+    void (*deleter)(void *);
+};
+
+// Per thread state, records are never freed but reused by new threads once owner exits
+struct record {
+    record() : state(0), in_use(true), next(nullptr), nesting(0), since_collect(0) {}
+
+    // Epoch observed by the thread shifted left by one, lowest bit is set while thread is inside Guard
+    std::atomic<uint64_t> state;
+    std::atomic<bool> in_use;
+    record *next;
+
+    // Fields below are accessed by owner thread only
+    std::size_t nesting;
+    std::size_t since_collect;
+
+    // Elements retired by the thread, in order of retire epoch
+    std::deque<retired> limbo;
+};
+
+std::atomic<uint64_t> global_epoch(0);
+std::atomic<record *> records(nullptr);
+
+// Elements left by exited threads
+std::mutex orphans_mutex;
+std::deque<retired> orphans;
+
+// Frees elements safe to free at the given global epoch
+void free_retired(std::deque<retired> &list, uint64_t epoch) {
+    while (!list.empty() && list.front().epoch + 2 <= epoch) {
+        retired item = list.front();
+        list.pop_front();
+        item.deleter(item.ptr);
+    }
+}
+
+record *acquire_record() {
+    for (record *rec = records.load(std::memory_order_acquire); rec != nullptr; rec = rec->next) {
+        bool expected = false;
+        if (!rec->in_use.load(std::memory_order_relaxed) && rec->in_use.compare_exchange_strong(expected, true)) {
+            return rec;
+        }
+    }
+
+    record *rec = new record;
+    record *head = records.load(std::memory_order_relaxed);
+    do {
+        rec->next = head;
+    } while (!records.compare_exchange_weak(head, rec, std::memory_order_release, std::memory_order_relaxed));
+    return rec;
+}
+
+// Owns record of the current thread, gives it back on thread exit
+struct thread_record {
+    thread_record() : rec(acquire_record()) {}
+    ~thread_record() {
+        if (!rec->limbo.empty()) {
+            std::unique_lock<std::mutex> lock(orphans_mutex);
+            orphans.insert(orphans.end(), rec->limbo.begin(), rec->limbo.end());
+            rec->limbo.clear();
+        }
+        rec->state.store(0, std::memory_order_release);
+        rec->in_use.store(false, std::memory_order_release);
+    }
+
+    record *rec;
+};
+
+record &local_record() {
+    static thread_local thread_record local;
+    return *local.rec;
+}
+
+} // namespace
+
+// See Epoch.h
+Epoch::Guard::Guard() {
+    record &rec = local_record();
+    if (rec.nesting++ == 0) {
+        // Announcement must be visible before any load of shared data, full barrier RMW provides that
+        uint64_t epoch = global_epoch.load(std::memory_order_relaxed);
+        rec.state.exchange((epoch << 1) | 1, std::memory_order_seq_cst);
+    }
+}
+
+// See Epoch.h
+Epoch::Guard::~Guard() {
+    record &rec = local_record();
+    if (--rec.nesting == 0) {
+        rec.state.store(rec.state.load(std::memory_order_relaxed) & ~uint64_t(1), std::memory_order_release);
+    }
+}
+
+// See Epoch.h
+void Epoch::Retire(void *ptr, void (*deleter)(void *)) {
+    record &rec = local_record();
+
+    // Element must be unlinked before the epoch it is tagged with is read
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    rec.limbo.push_back(retired{global_epoch.load(std::memory_order_relaxed), ptr, deleter});
+
+    if (++rec.since_collect >= kCollectBatch) {
+        Collect();
+    }
+}
+
+// See Epoch.h
+void Epoch::Synchronize() {
+    uint64_t target = global_epoch.load(std::memory_order_seq_cst) + 2;
+    for (;;) {
+        uint64_t epoch = global_epoch.load(std::memory_order_seq_cst);
+        if (epoch >= target) {
+            break;
+        }
+        if (!try_advance(epoch)) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+// See Epoch.h
+void Epoch::Collect() {
+    record &rec = local_record();
+    rec.since_collect = 0;
+
+    try_advance(global_epoch.load(std::memory_order_relaxed));
+    uint64_t epoch = global_epoch.load(std::memory_order_acquire);
+    free_retired(rec.limbo, epoch);
+
+    std::unique_lock<std::mutex> lock(orphans_mutex, std::try_to_lock);
+    if (lock.owns_lock()) {
+        free_retired(orphans, epoch);
+    }
+}
+
+bool Epoch::try_advance(uint64_t epoch) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for (record *rec = records.load(std::memory_order_acquire); rec != nullptr; rec = rec->next) {
+        uint64_t state = rec->state.load(std::memory_order_acquire);
+        if ((state & 1) != 0 && (state >> 1) != epoch) {
+            // Reader is still in the previous epoch
+            return false;
+        }
+    }
+
+    // Failure means somebody else has advanced the epoch already
+    global_epoch.compare_exchange_strong(epoch, epoch + 1, std::memory_order_acq_rel);
+    return true;
+}
+
+} // namespace Concurrency
+} // namespace Afina
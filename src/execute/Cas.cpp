@@ -0,0 +1,30 @@
+#include <afina/Storage.h>
+#include <afina/execute/Cas.h>
+
+#include <iostream>
+
+namespace Afina {
+namespace Execute {
+
+// memcached protocol: "cas" is a check and set operation which means "store this data but
+// only if no one else has updated since I last fetched it."
+void Cas::Execute(Storage &storage, const std::string &args, std::string &out) {
+    std::cout << "Cas(" << _key << ", " << _version << "): " << args << std::endl;
+    switch (storage.CompareAndSet(_key, args, meta(), _version)) {
+    case Storage::CasStatus::kStored:
+        out = "STORED";
+        break;
+    case Storage::CasStatus::kExists:
+        out = "EXISTS";
+        break;
+    case Storage::CasStatus::kNotFound:
+        out = "NOT_FOUND";
+        break;
+    case Storage::CasStatus::kNotStored:
+        out = "NOT_STORED";
+        break;
+    }
+}
+
+} // namespace Execute
+} // namespace Afina
@@ -1,9 +1,8 @@
 #include <afina/Storage.h>
 #include <afina/execute/Get.h>
+#include <afina/execute/Response.h>
 
 #include <iostream>
-#include <iterator>
-#include <sstream>
 
 namespace Afina {
 namespace Execute {
@@ -12,7 +11,7 @@ namespace Execute {
 
 Each item sent by the server looks like this:
 
-VALUE <key> <flags> <bytes>\r\n
+VALUE <key> <flags> <bytes> [<cas unique>]\r\n
 <data block>\r\n
 
 After all the items have been transmitted, the server sends the string
@@ -21,23 +20,66 @@ to indicate the end of response.
 
 */
 
+Get::Get(const std::vector<std::string> &keys, bool versions) : _versions(versions) { assign(keys); }
+
+Get::Get(const std::vector<StringRef> &keys, bool versions) : _versions(versions) { assign(keys); }
+
+template <typename K> void Get::assign(const std::vector<K> &keys) {
+    std::size_t size = 0;
+    for (const K &key : keys) {
+        size += key.size();
+    }
+
+    // Buffer never grows, so keys referencing it stay valid
+    _bytes.reserve(size);
+    _keys.reserve(keys.size());
+    for (const K &key : keys) {
+        _keys.emplace_back(_bytes.data() + _bytes.size(), key.size());
+        _bytes.append(key.data(), key.size());
+    }
+}
+
+// See Get.h
+std::vector<std::string> Get::keys() const {
+    std::vector<std::string> keys;
+    for (const StringRef &key : _keys) {
+        keys.push_back(key.str());
+    }
+    return keys;
+}
+
 void Get::Execute(Storage &storage, const std::string &args, std::string &out) {
-    std::stringstream keyStream;
-    copy(_keys.begin(), _keys.end(), std::ostream_iterator<std::string>(keyStream, " "));
-    std::cout << "Get(" << keyStream.str() << ")" << std::endl;
+    Response response;
+    Execute(storage, args, response);
+    out = response.str();
+}
 
-    std::stringstream outStream;
+void Get::Execute(Storage &storage, const std::string &args, Response &out) {
+    std::cout << "Get(";
+    for (const StringRef &key : _keys) {
+        std::cout.write(key.data(), key.size()) << " ";
+    }
+    std::cout << ")" << std::endl;
 
-    std::string value;
-    for (auto &key : _keys) {
-        if (!storage.Get(key, value))
+    // Whole multiget is a single batch, so storage could take each lock once. Attributes are needed for flags,
+    // versions only for gets
+    std::vector<ValueRef> values;
+    std::vector<Storage::Meta> metas;
+    storage.MultiGet(_keys, values, &metas, _versions);
+    for (std::size_t i = 0; i < _keys.size(); i++) {
+        if (!values[i])
             continue;
-        outStream << "VALUE " << key << " 0 " << value.size() << "\r\n";
-        outStream << value << "\r\n";
+        std::string header = "VALUE ";
+        header.append(_keys[i].data(), _keys[i].size());
+        header += " " + std::to_string(metas[i].flags) + " " + std::to_string(values[i].size());
+        if (_versions) {
+            header += " " + std::to_string(metas[i].version);
+        }
+        out.Append(header + "\r\n");
+        out.Append(std::move(values[i]));
+        out.Append("\r\n", 2);
     }
-    outStream << "END"; // networking layer should add the last \r\n
-
-    out = outStream.str();
+    out.Append("END", 3); // networking layer should add the last \r\n
 }
 
 } // namespace Execute
@@ -0,0 +1,27 @@
+#include <afina/Storage.h>
+#include <afina/execute/Incr.h>
+
+#include <iostream>
+
+namespace Afina {
+namespace Execute {
+
+// memcached protocol: "incr" changes data for the existing key in place, value is treated as a number
+void Incr::Execute(Storage &storage, const std::string &args, std::string &out) {
+    std::cout << "Incr(" << _key << "): " << _delta << std::endl;
+    uint64_t value;
+    switch (storage.Increment(_key, _delta, value)) {
+    case Storage::CounterStatus::kUpdated:
+        out = std::to_string(value);
+        break;
+    case Storage::CounterStatus::kNotFound:
+        out = "NOT_FOUND";
+        break;
+    case Storage::CounterStatus::kNotNumber:
+        out = "CLIENT_ERROR cannot increment or decrement non-numeric value";
+        break;
+    }
+}
+
+} // namespace Execute
+} // namespace Afina
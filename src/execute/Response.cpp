@@ -0,0 +1,92 @@
+#include <afina/execute/Response.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+
+#include <sys/uio.h>
+
+namespace Afina {
+namespace Execute {
+
+// See Response.h
+void Response::Append(const char *data, std::size_t size) {
+    if (size == 0) {
+        return;
+    }
+    if (!_chunks.empty() && !_chunks.back().is_value) {
+        // Adjacent text chunks are merged
+        _chunks.back().size += size;
+    } else {
+        _chunks.push_back(chunk{false, _text.size(), size});
+    }
+    _text.append(data, size);
+}
+
+// See Response.h
+void Response::Append(ValueRef &&value) {
+    if (value.size() == 0) {
+        return;
+    }
+    _chunks.push_back(chunk{true, _values.size(), value.size()});
+    _values.push_back(std::move(value));
+}
+
+// See Response.h
+std::size_t Response::size() const {
+    std::size_t result = 0;
+    for (auto &c : _chunks) {
+        result += c.size;
+    }
+    return result;
+}
+
+// See Response.h
+std::string Response::str() const {
+    std::string result;
+    result.reserve(size());
+    for (auto &c : _chunks) {
+        result.append(chunk_data(c), c.size);
+    }
+    return result;
+}
+
+const char *Response::chunk_data(const chunk &c) const {
+    return c.is_value ? _values[c.offset].data() : _text.data() + c.offset;
+}
+
+// See Response.h
+bool Response::Send(int socket) const {
+    std::vector<struct iovec> iov(_chunks.size());
+    for (std::size_t i = 0; i < _chunks.size(); i++) {
+        iov[i].iov_base = const_cast<char *>(chunk_data(_chunks[i]));
+        iov[i].iov_len = _chunks[i].size;
+    }
+
+    std::size_t first = 0;
+    while (first < iov.size()) {
+        int count = std::min<std::size_t>(iov.size() - first, IOV_MAX);
+        ssize_t sent = writev(socket, &iov[first], count);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+
+        // Skip fully sent chunks, the partially sent one gets adjusted
+        std::size_t left = sent;
+        while (first < iov.size() && left >= iov[first].iov_len) {
+            left -= iov[first].iov_len;
+            first++;
+        }
+        if (left > 0) {
+            iov[first].iov_base = static_cast<char *>(iov[first].iov_base) + left;
+            iov[first].iov_len -= left;
+        }
+    }
+    return true;
+}
+
+} // namespace Execute
+} // namespace Afina
@@ -0,0 +1,28 @@
+#include <afina/Storage.h>
+#include <afina/execute/Scan.h>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+namespace Afina {
+namespace Execute {
+
+constexpr std::size_t Scan::kDefaultCount;
+constexpr std::size_t Scan::kMaxCount;
+
+// Not a memcached command: one batch of the cursor based iteration over the keys
+void Scan::Execute(Storage &storage, const std::string &args, std::string &out) {
+    std::cout << "Scan(" << _cursor << "): " << _count << std::endl;
+    std::vector<std::string> keys;
+    uint64_t next = storage.Scan(_cursor, std::min(_count, kMaxCount), keys);
+
+    out.clear();
+    for (const std::string &key : keys) {
+        out.append("KEY ").append(key).append("\r\n");
+    }
+    out.append("CURSOR ").append(std::to_string(next)).append("\r\nEND");
+}
+
+} // namespace Execute
+} // namespace Afina
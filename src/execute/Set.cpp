@@ -9,8 +9,7 @@ namespace Execute {
 // memcached protocol: "set" means "store this data".
 void Set::Execute(Storage &storage, const std::string &args, std::string &out) {
     std::cout << "Set(" << _key << "): " << args << std::endl;
-    storage.Put(_key, args);
-    out = "STORED";
+    out = storage.Put(StringRef(_key), args, meta()) ? "STORED" : "NOT_STORED";
 }
 
 } // namespace Execute
@@ -4,11 +4,22 @@
 #include <iostream>
 #include <iterator>
 #include <sstream>
+#include <utility>
+#include <vector>
 
 namespace Afina {
 namespace Execute {
 
-void Stats::Execute(Storage &storage, const std::string &args, std::string &out) { out.assign("END"); }
+void Stats::Execute(Storage &storage, const std::string &args, std::string &out) {
+    std::vector<std::pair<std::string, std::string>> stats;
+    storage.Stats(stats);
+
+    out.clear();
+    for (const auto &stat : stats) {
+        out.append("STAT ").append(stat.first).append(" ").append(stat.second).append("\r\n");
+    }
+    out.append("END");
+}
 
 } // namespace Execute
 } // namespace Afina
@@ -1,8 +1,11 @@
+#include <algorithm>
 #include <chrono>
 #include <iostream>
 #include <memory>
 
 #include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <semaphore.h>
 #include <signal.h>
 #include <thread>
@@ -21,9 +24,17 @@
 #include "network/st_coroutine/ServerImpl.h"
 #include "network/st_nonblocking/ServerImpl.h"
 
+#include "storage/ARC.h"
+#include "storage/ColdTier.h"
+#include "storage/EpochStripedLRU.h"
+#include "storage/LoggedStorage.h"
+#include "storage/SharedMemoryLRU.h"
 #include "storage/SimpleLRU.h"
+#include "storage/Snapshot.h"
 #include "storage/ThreadSafeSimpleLRU.h"
 #include "storage/StripedLockLRU.h"
+#include "storage/ThreadSafeStorage.h"
+#include "storage/TinyLFU.h"
 
 using namespace Afina;
 
@@ -52,16 +63,72 @@ public:
             storage_type = options["storage"].as<std::string>();
         }
 
+        // Cold tier promotes whatever it has read to the single storage taking values from it, so it could serve
+        // neither shards of the striped ones nor storages that don't demote anything
+        if (options.count("cold") > 0) {
+            if (storage_type != "st_lru" && storage_type != "mt_lru" && storage_type != "st_clock") {
+                throw std::runtime_error("--cold is not supported by " + storage_type);
+            }
+            std::size_t cold_size = options.count("cold-size") > 0 ? options["cold-size"].as<int>() : 256;
+            coldTier.reset(new Afina::Backend::ColdTier(options["cold"].as<std::string>(), cold_size << 20));
+        }
+
+        // Values of that many bytes or more are compressed by LRU and CLOCK storages
+        std::size_t compress_from = options.count("compress") > 0 ? options["compress"].as<int>() : 0;
+        if (compress_from != 0 && storage_type != "st_lru" && storage_type != "mt_lru" &&
+            storage_type != "mt_stl_lru" && storage_type != "st_clock" && storage_type != "mt_clock") {
+            throw std::runtime_error("--compress is not supported by " + storage_type);
+        }
+
         if (storage_type == "st_lru") {
-            storage = std::make_shared<Afina::Backend::SimpleLRU>();
+            storage = std::make_shared<Afina::Backend::SimpleLRU>(1024, Afina::Backend::SimpleLRU::Eviction::kLRU,
+                                                                  nullptr, coldTier.get(), compress_from);
         } else if (storage_type == "mt_lru") {
-            storage = std::make_shared<Afina::Backend::ThreadSafeSimplLRU>();
+            storage = std::make_shared<Afina::Backend::ThreadSafeSimplLRU>(
+                1024, Afina::Backend::SimpleLRU::Eviction::kLRU, nullptr, coldTier.get(), compress_from);
         } else if (storage_type == "mt_stl_lru") {
-            storage = std::make_shared<Afina::Backend::StripedLockLRU>();
+            striped = std::make_shared<Afina::Backend::StripedLockLRU>(
+                4 << 20, 0, Afina::Backend::SimpleLRU::Eviction::kLRU, compress_from);
+            storage = striped;
+        } else if (storage_type == "st_clock") {
+            storage = std::make_shared<Afina::Backend::SimpleLRU>(1024, Afina::Backend::SimpleLRU::Eviction::kClock,
+                                                                  nullptr, coldTier.get(), compress_from);
+        } else if (storage_type == "mt_clock") {
+            striped = std::make_shared<Afina::Backend::StripedLockLRU>(
+                4 << 20, 0, Afina::Backend::SimpleLRU::Eviction::kClock, compress_from);
+            storage = striped;
+        } else if (storage_type == "mt_epoch") {
+            storage = std::make_shared<Afina::Backend::EpochStripedLRU>();
+        } else if (storage_type == "st_tinylfu") {
+            storage = std::make_shared<Afina::Backend::TinyLFU>();
+        } else if (storage_type == "mt_tinylfu") {
+            storage = std::make_shared<Afina::Backend::ThreadSafeTinyLFU>();
+        } else if (storage_type == "st_arc") {
+            storage = std::make_shared<Afina::Backend::ARC>();
+        } else if (storage_type == "mt_arc") {
+            storage = std::make_shared<Afina::Backend::ThreadSafeARC>();
+        } else if (storage_type == "mt_shm") {
+            std::string path = options.count("shm") > 0 ? options["shm"].as<std::string>() : "/dev/shm/afina";
+            storage = std::make_shared<Afina::Backend::SharedMemoryLRU>(path);
         } else {
             throw std::runtime_error("Unknown storage type");
         }
 
+        // Operation log goes on top, so it sees every modification
+        backend = storage;
+        if (options.count("oplog") > 0) {
+            int sync = options.count("oplog-sync") > 0 ? options["oplog-sync"].as<int>() : 100;
+            storage = std::make_shared<Afina::Backend::LoggedStorage>(storage, options["oplog"].as<std::string>(),
+                                                                      std::chrono::milliseconds(sync));
+        }
+
+        if (options.count("snapshot") > 0) {
+            snapshotPath = options["snapshot"].as<std::string>();
+        }
+        if (options.count("snapshot-interval") > 0) {
+            snapshotInterval = options["snapshot-interval"].as<int>();
+        }
+
         // Step 2: Configure network
         std::string network_type = "st_block";
         if (options.count("network") > 0) {
@@ -89,9 +156,22 @@ public:
         auto log = logService->select("root");
         log->warn("Start afina server {}", Afina::get_version());
 
+        // Warm the cache up before clients come. Snapshot goes right into the backend, operation log, if any,
+        // is replayed over it then as it has all modifications since the snapshot
+        if (!snapshotPath.empty()) {
+            log->warn("Load snapshot {}", snapshotPath);
+            std::size_t loaded = Backend::LoadSnapshot(*backend, snapshotPath);
+            log->warn("Loaded {} entries", loaded);
+        }
+
         log->warn("Start storage");
         storage->Start();
 
+        if (!snapshotPath.empty() && snapshotInterval > 0) {
+            snapshotStop = false;
+            snapshotter = std::thread(&Application::RunSnapshots, this);
+        }
+
         // TODO: configure network service
         const uint16_t port = 8080;
         log->warn("Start network on {}", port);
@@ -105,16 +185,85 @@ public:
         server->Stop();
         server->Join();
 
+        if (snapshotter.joinable()) {
+            {
+                std::unique_lock<std::mutex> lock(snapshotMutex);
+                snapshotStop = true;
+            }
+            snapshotWake.notify_all();
+            snapshotter.join();
+        }
+
+        // No traffic anymore, so this one is the most recent state
+        if (!snapshotPath.empty()) {
+            SaveSnapshot();
+        }
+
         storage->Stop();
         logService->Stop();
     }
 
+    // Doubles number of shards if grow is set or halves it otherwise, while traffic is served
+    void Reshard(bool grow) {
+        auto log = logService->select("root");
+        if (!striped) {
+            log->warn("Storage has no shards to change");
+            return;
+        }
+        std::size_t shards = striped->shards();
+        std::size_t wanted = grow ? shards * 2 : std::max<std::size_t>(1, shards / 2);
+        if (striped->Reshard(wanted)) {
+            log->warn("Resharding from {} to {} shards", shards, striped->shards());
+        }
+    }
+
 private:
+    // Writes snapshot of the storage every snapshotInterval seconds while traffic is served
+    void RunSnapshots() {
+        std::unique_lock<std::mutex> lock(snapshotMutex);
+        while (!snapshotWake.wait_for(lock, std::chrono::seconds(snapshotInterval), [this] { return snapshotStop; })) {
+            lock.unlock();
+            SaveSnapshot();
+            lock.lock();
+        }
+    }
+
+    void SaveSnapshot() {
+        auto log = logService->select("root");
+        try {
+            auto started = std::chrono::steady_clock::now();
+            std::size_t saved = Backend::SaveSnapshot(*storage, snapshotPath);
+            auto elapsed = std::chrono::steady_clock::now() - started;
+            log->warn("Saved {} entries to {} in {} ms", saved, snapshotPath,
+                      std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count());
+        } catch (std::exception &e) {
+            log->error("Failed to save snapshot: {}", e.what());
+        }
+    }
+
     std::shared_ptr<Logging::Config> logConfig;
     std::shared_ptr<Logging::Service> logService;
 
+    // Tier storage demotes evicted entries to, if any, outlives the storage
+    std::unique_ptr<Afina::Backend::ColdTier> coldTier;
+
     std::shared_ptr<Afina::Storage> storage;
     std::shared_ptr<Network::Server> server;
+
+    // Storage under the operation log, the same as storage if there is no log
+    std::shared_ptr<Afina::Storage> backend;
+
+    // The same as backend if it is sharded one, could be resharded then
+    std::shared_ptr<Afina::Backend::StripedLockLRU> striped;
+
+    // Snapshot file, storage is loaded from it on start and saved to it on stop and periodically
+    std::string snapshotPath;
+    int snapshotInterval = 0;
+
+    std::thread snapshotter;
+    std::mutex snapshotMutex;
+    std::condition_variable snapshotWake;
+    bool snapshotStop = false;
 };
 
 // Signal set that to notify application about time to stop
@@ -127,6 +276,15 @@ void on_term(int signum, siginfo_t *siginfo, void *data) {
     sem_post(&stop_semaphore);
 }
 
+// Signal set that to ask application to change number of storage shards
+volatile sig_atomic_t reshard_signal = 0;
+
+// Catch user desire to grow (SIGUSR1) or shrink (SIGUSR2) number of shards
+void on_reshard(int signum, siginfo_t *siginfo, void *data) {
+    reshard_signal = signum;
+    sem_post(&stop_semaphore);
+}
+
 int main(int argc, char **argv) {
     // Command line arguments parsing
     cxxopts::Options options("afina", "Simple memory caching server");
@@ -135,6 +293,21 @@ int main(int argc, char **argv) {
         // and simplify validation below
         options.add_options()("s,storage", "Type of storage service to use", cxxopts::value<std::string>());
         options.add_options()("n,network", "Type of network service to use", cxxopts::value<std::string>());
+        options.add_options()("snapshot", "File to load storage from on start and to save it to on stop",
+                              cxxopts::value<std::string>());
+        options.add_options()("snapshot-interval", "Seconds between snapshots taken while serving, 0 means never",
+                              cxxopts::value<int>());
+        options.add_options()("oplog", "File to log storage modifications to, replayed on start",
+                              cxxopts::value<std::string>());
+        options.add_options()("oplog-sync", "Milliseconds between syncs of the operation log, 100 by default",
+                              cxxopts::value<int>());
+        options.add_options()("compress", "Minimal size of the value LRU and CLOCK storages compress, 0 means never",
+                              cxxopts::value<int>());
+        options.add_options()("shm", "File mt_shm storage lives in, /dev/shm/afina by default",
+                              cxxopts::value<std::string>());
+        options.add_options()("cold", "Prefix of the files st_lru, mt_lru and st_clock demote evicted entries to",
+                              cxxopts::value<std::string>());
+        options.add_options()("cold-size", "Megabytes of the cold tier files, 256 by default", cxxopts::value<int>());
         options.add_options()("h,help", "Print usage info");
         options.parse(argc, argv);
 
@@ -167,6 +340,10 @@ int main(int argc, char **argv) {
 
         sigaction(SIGINT, &act, NULL);
         sigaction(SIGTERM, &act, NULL);
+
+        act.sa_sigaction = on_reshard;
+        sigaction(SIGUSR1, &act, NULL);
+        sigaction(SIGUSR2, &act, NULL);
     }
 
     // Run app
@@ -174,9 +351,15 @@ int main(int argc, char **argv) {
         // Start services
         app.Start();
 
-        // Freeze main thread until one of signals arrive
-        while (stop_reason == 0 && ((sem_wait(&stop_semaphore) == -1) && (errno == EINTR))) {
-            continue;
+        // Freeze main thread until one of stop signals arrive, resharding is done right here meanwhile
+        while (stop_reason == 0) {
+            if (sem_wait(&stop_semaphore) == -1) {
+                continue;
+            }
+            if (reshard_signal != 0 && stop_reason == 0) {
+                app.Reshard(reshard_signal == SIGUSR1);
+                reshard_signal = 0;
+            }
         }
 
         // Stop services
@@ -19,6 +19,7 @@
 
 #include <afina/Storage.h>
 #include <afina/execute/Command.h>
+#include <afina/execute/Response.h>
 #include <afina/logging/Service.h>
 #include <afina/concurrency/Executor.h>
 
@@ -155,15 +156,15 @@ void ServerImpl::ThreadRun(int client_socket) {
                 if (command_to_execute && arg_remains == 0) {
                     _logger->debug("Start command execution");
 
-                    std::string result;
+                    Execute::Response result;
                     if (argument_for_command.size()) {
                         argument_for_command.resize(argument_for_command.size() - 2);
                     }
                     command_to_execute->Execute(*pStorage, argument_for_command, result);
 
-                    // Send response
-                    result += "\r\n";
-                    if (send(client_socket, result.data(), result.size(), 0) <= 0) {
+                    // Send response, values go to the socket right from the storage, unless client asked not to
+                    result.Append("\r\n", 2);
+                    if (!parser.NoReply() && !result.Send(client_socket)) {
                         throw std::runtime_error("Failed to send response");
                     }
 
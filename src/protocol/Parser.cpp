@@ -6,15 +6,41 @@
 
 #include <afina/execute/Add.h>
 #include <afina/execute/Append.h>
+#include <afina/execute/Cas.h>
 #include <afina/execute/Command.h>
+#include <afina/execute/Decr.h>
 #include <afina/execute/Delete.h>
 #include <afina/execute/Get.h>
+#include <afina/execute/Incr.h>
+#include <afina/execute/Prepend.h>
+#include <afina/execute/Scan.h>
 #include <afina/execute/Set.h>
 #include <afina/execute/Stats.h>
 
 namespace Afina {
 namespace Protocol {
 
+namespace {
+
+// Decimal representation of a 64-bit unsigned integer
+uint64_t parse_number(StringRef field) {
+    if (field.size() == 0) {
+        throw std::runtime_error("Number expected");
+    }
+    uint64_t value = 0;
+    for (std::size_t i = 0; i < field.size(); i++) {
+        char c = field.data()[i];
+        uint64_t next = value * 10 + (c - '0');
+        if (c < '0' || c > '9' || value > UINT64_MAX / 10 || next < value * 10) {
+            throw std::runtime_error("Invalid number: " + field.str());
+        }
+        value = next;
+    }
+    return value;
+}
+
+} // namespace
+
 // See Parse.h
 bool Parser::Parse(const char *input, const size_t size, size_t &parsed) {
     size_t pos;
@@ -28,10 +54,12 @@ bool Parser::Parse(const char *input, const size_t size, size_t &parsed) {
         case State::sName: {
             if (c == ' ' || c == '\r') {
                 // std::cout << "parser debug: name='" << name << "'" << std::endl;
-                if (name == "set" || name == "add" || name == "append" || name == "prepend") {
+                if (name == "set" || name == "add" || name == "append" || name == "prepend" || name == "cas") {
                     state = State::spKey;
-                } else if (name == "get" || name == "gets") {
+                } else if (name == "get" || name == "gets" || name == "scan") {
                     state = State::sgKey;
+                } else if (name == "incr" || name == "decr") {
+                    state = State::siKey;
                 } else if (name == "stats") {
                     state = State::sLF;
                     continue;
@@ -47,32 +75,70 @@ bool Parser::Parse(const char *input, const size_t size, size_t &parsed) {
         case State::spKey: {
             if (c == ' ') {
                 state = State::spFlags;
-                keys.push_back(curKey);
-                // std::cout << "parser debug: key[" << keys.size() - 1 << "]='" << curKey << "'" << std::endl;
+                key_ends.push_back(key_bytes.size());
             } else {
-                curKey.push_back(c);
+                pos = take_key(input, pos, size, false) - 1;
             }
             break;
         }
 
         case State::sgKey: {
             if (c == '\r') {
-                keys.push_back(curKey);
-                // std::cout << "parser debug: total '" << keys.size() << " keys" << std::endl;
+                key_ends.push_back(key_bytes.size());
+                // std::cout << "parser debug: total '" << key_ends.size() << " keys" << std::endl;
 
-                if (keys.size() == 0) {
+                if (key_ends.size() == 0) {
                     throw std::runtime_error("Client provides no key to retrive");
                 }
-
-                curKey.clear();
                 state = State::sLF;
             } else if (c == ' ') {
-                // std::cout << "parser debug: key[" << keys.size() << "]='" << curKey << "'" << std::endl;
                 state = State::sgKey;
-                keys.push_back(curKey);
-                curKey.clear();
+                key_ends.push_back(key_bytes.size());
+            } else {
+                pos = take_key(input, pos, size, true) - 1;
+            }
+            break;
+        }
+
+        case State::siKey: {
+            if (c == '\r') {
+                throw std::runtime_error("Delta expected after the key");
+            } else if (c == ' ') {
+                state = State::siDelta;
+                key_ends.push_back(key_bytes.size());
+            } else {
+                pos = take_key(input, pos, size, true) - 1;
+            }
+            break;
+        }
+
+        case State::siDelta: {
+            if (c == '\r') {
+                state = State::sLF;
+            } else if (c == ' ') {
+                state = State::sNoreply;
+            } else if (c >= '0' && c <= '9') {
+                uint64_t d = (delta * 10) + (c - '0');
+                if (delta > UINT64_MAX / 10 || d < delta * 10) {
+                    // Overflow
+                    throw std::runtime_error("Delta field overflow");
+                }
+                delta = d;
             } else {
-                curKey.push_back(c);
+                throw std::runtime_error("Delta field must be a number");
+            }
+            break;
+        }
+
+        case State::sNoreply: {
+            if (c == '\r') {
+                if (option != "noreply") {
+                    throw std::runtime_error("Unknown option: " + option);
+                }
+                noreply = true;
+                state = State::sLF;
+            } else {
+                option.push_back(c);
             }
             break;
         }
@@ -128,8 +194,13 @@ bool Parser::Parse(const char *input, const size_t size, size_t &parsed) {
 
         case State::spBytes: {
             if (c == '\r') {
+                if (name == "cas") {
+                    throw std::runtime_error("Cas unique expected after the bytes");
+                }
                 state = State::sLF;
                 // std::cout << "parser debug: bytes='" << bytes << "'" << std::endl;
+            } else if (c == ' ' && name == "cas") {
+                state = State::spCasStart;
             } else if (c >= '0' && c <= '9') {
                 uint32_t b = (bytes * 10) + (c - '0');
                 if (b < bytes) {
@@ -141,6 +212,33 @@ bool Parser::Parse(const char *input, const size_t size, size_t &parsed) {
             break;
         }
 
+        case State::spCasStart: {
+            if (c < '0' || c > '9') {
+                throw std::runtime_error("Cas unique field must be a number");
+            }
+            cas = c - '0';
+            state = State::spCas;
+            break;
+        }
+
+        case State::spCas: {
+            if (c == '\r') {
+                state = State::sLF;
+            } else if (c == ' ') {
+                state = State::sNoreply;
+            } else if (c >= '0' && c <= '9') {
+                uint64_t v = (cas * 10) + (c - '0');
+                if (cas > UINT64_MAX / 10 || v < cas * 10) {
+                    // Overflow
+                    throw std::runtime_error("Cas unique field overflow");
+                }
+                cas = v;
+            } else {
+                throw std::runtime_error("Cas unique field must be a number");
+            }
+            break;
+        }
+
         case State::sLF: {
             if (c == '\n') {
                 parse_complete = true;
@@ -161,6 +259,16 @@ bool Parser::Parse(const char *input, const size_t size, size_t &parsed) {
     return parse_complete;
 }
 
+std::size_t Parser::take_key(const char *input, std::size_t pos, std::size_t size, bool line_end) {
+    // Key is copied in one go rather than byte by byte
+    std::size_t end = pos;
+    while (end < size && input[end] != ' ' && !(line_end && input[end] == '\r')) {
+        end++;
+    }
+    key_bytes.append(input + pos, end - pos);
+    return end;
+}
+
 // See Parse.h
 std::unique_ptr<Execute::Command> Parser::Build(size_t &body_size) const {
     if (state != State::sLF) {
@@ -169,15 +277,35 @@ std::unique_ptr<Execute::Command> Parser::Build(size_t &body_size) const {
 
     body_size = bytes;
     if (name == "set") {
-        return std::unique_ptr<Execute::Command>(new Execute::Set(keys[0], flags, exprtime));
+        return std::unique_ptr<Execute::Command>(new Execute::Set(key(0).str(), flags, exprtime));
     } else if (name == "add") {
-        return std::unique_ptr<Execute::Command>(new Execute::Add(keys[0], flags, exprtime));
+        return std::unique_ptr<Execute::Command>(new Execute::Add(key(0).str(), flags, exprtime));
     } else if (name == "append") {
-        return std::unique_ptr<Execute::Command>(new Execute::Append(keys[0], flags, exprtime));
-    } else if (name == "get") {
-        return std::unique_ptr<Execute::Command>(new Execute::Get(keys));
+        return std::unique_ptr<Execute::Command>(new Execute::Append(key(0).str(), flags, exprtime));
+    } else if (name == "prepend") {
+        return std::unique_ptr<Execute::Command>(new Execute::Prepend(key(0).str(), flags, exprtime));
+    } else if (name == "incr") {
+        return std::unique_ptr<Execute::Command>(new Execute::Incr(key(0).str(), delta));
+    } else if (name == "decr") {
+        return std::unique_ptr<Execute::Command>(new Execute::Decr(key(0).str(), delta));
+    } else if (name == "cas") {
+        return std::unique_ptr<Execute::Command>(new Execute::Cas(key(0).str(), flags, exprtime, cas));
+    } else if (name == "get" || name == "gets") {
+        std::vector<StringRef> keys;
+        keys.reserve(key_ends.size());
+        for (std::size_t i = 0; i < key_ends.size(); i++) {
+            keys.push_back(key(i));
+        }
+        return std::unique_ptr<Execute::Command>(new Execute::Get(keys, name == "gets"));
     } else if (name == "stats") {
         return std::unique_ptr<Execute::Command>(new Execute::Stats());
+    } else if (name == "scan") {
+        if (key_ends.empty() || key_ends.size() > 2) {
+            throw std::runtime_error("Scan takes cursor and optional count");
+        }
+        uint64_t cursor = parse_number(key(0));
+        uint64_t count = key_ends.size() > 1 ? parse_number(key(1)) : Execute::Scan::kDefaultCount;
+        return std::unique_ptr<Execute::Command>(new Execute::Scan(cursor, count));
     } else {
         throw std::runtime_error("Unsupported command");
     }
@@ -187,12 +315,16 @@ std::unique_ptr<Execute::Command> Parser::Build(size_t &body_size) const {
 void Parser::Reset() {
     state = State::sName;
     name.clear();
-    keys.clear();
-    curKey.clear();
+    key_bytes.clear();
+    key_ends.clear();
+    option.clear();
+    noreply = false;
     parse_complete = false;
     flags = 0;
     bytes = 0;
     exprtime = 0;
+    delta = 0;
+    cas = 0;
 }
 
 } // namespace Protocol
@@ -8,6 +8,8 @@
 #include <cstddef>
 #include <cstdint>
 
+#include <afina/StringRef.h>
+
 namespace Afina {
 namespace Execute {
 class Command;
@@ -55,21 +57,46 @@ public:
 
     inline const std::string &Name() const { return name; }
 
+    /**
+     * True if client has asked not to send the result of the parsed command back
+     */
+    inline bool NoReply() const { return noreply; }
+
 private:
     /**
      * State of the command parser. Prefixes are:
      * - s: state for PUT and GET commands
      * - sp: for PUT commands only
-     * - sg: for GET commands only
+     * - sg: for GET and SCAN commands only
+     * - si: for INCR/DECR commands only
      */
-    enum State : uint16_t { sCR, sLF, sName, spKey, spFlags, spExprTimeStart, spExprTime, spBytes, sgKey };
+    enum State : uint16_t {
+        sCR,
+        sLF,
+        sName,
+        spKey,
+        spFlags,
+        spExprTimeStart,
+        spExprTime,
+        spBytes,
+        spCasStart,
+        spCas,
+        sgKey,
+        siKey,
+        siDelta,
+        sNoreply
+    };
 
     // Current parser state
     State state;
 
     // vrious fields of the command
     std::string name;
-    std::vector<std::string> keys;
+
+    // Bytes of all keys one after another and the end of each one in them. Buffers are reused by the next
+    // command, so parsing keys allocates nothing once they have grown large enough
+    std::string key_bytes;
+    std::vector<std::size_t> key_ends;
 
     // <flags> is an arbitrary 16-bit unsigned integer (written out in decimal) that the server stores along with
     // the data and sends back when the item is retrieved. Clients may use this as a bit field to store data-specific
@@ -88,9 +115,29 @@ private:
     // it's followed by an empty data block).
     uint32_t bytes;
 
+    // <cas unique> is a unique 64-bit value of an existing entry. Clients should use the value returned from the
+    // "gets" command when issuing "cas" updates.
+    uint64_t cas;
+
+    // <value> is the amount by which the client wants to increase/decrease the item. It is a decimal
+    // representation of a 64-bit unsigned integer.
+    uint64_t delta;
+
+    // Optional last field of the command, the only one known is "noreply": the server does not send the result
+    std::string option;
+    bool noreply;
+
     bool negative;
-    std::string curKey;
     bool parse_complete;
+
+    // Slice of key_bytes holding i-th key
+    StringRef key(std::size_t i) const {
+        std::size_t begin = i == 0 ? 0 : key_ends[i - 1];
+        return StringRef(key_bytes.data() + begin, key_ends[i] - begin);
+    }
+
+    // Appends bytes of the key up to the first delimiter to key_bytes, returns position of the delimiter or size
+    std::size_t take_key(const char *input, std::size_t pos, std::size_t size, bool line_end);
 };
 
 } // namespace Protocol
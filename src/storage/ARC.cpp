@@ -0,0 +1,489 @@
+#include "ARC.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+namespace Afina {
+namespace Backend {
+
+ARC::~ARC() {
+    _index.clear();
+    for (arc_list *list : {&_t1, &_t2, &_b1, &_b2}) {
+        while (list->head != nullptr) {
+            arc_node *next = list->head->next;
+            delete_node(list->head);
+            list->head = next;
+        }
+    }
+}
+
+// See ARC.h
+std::size_t ARC::EntrySize(std::size_t key_size, std::size_t value_size) {
+    // Index keeps load factor between 7/16 and 7/8, so account two slots per entry
+    return sizeof(arc_node) + key_size + value_size + 2 * HashIndex<arc_node>::slot_size();
+}
+
+void ARC::arc_list::push_tail(arc_node &node) {
+    node.prev = tail;
+    node.next = nullptr;
+    if (tail != nullptr) {
+        tail->next = &node;
+    } else {
+        head = &node;
+    }
+    tail = &node;
+    size += node.weight;
+}
+
+void ARC::arc_list::unlink(arc_node &node) {
+    if (node.prev != nullptr) {
+        node.prev->next = node.next;
+    } else {
+        head = node.next;
+    }
+
+    if (node.next != nullptr) {
+        node.next->prev = node.prev;
+    } else {
+        tail = node.prev;
+    }
+    node.prev = nullptr;
+    node.next = nullptr;
+    size -= node.weight;
+}
+
+ARC::arc_node *ARC::new_node(const char *key, std::size_t key_size, const char *value, std::size_t value_size,
+                             std::size_t hash) {
+    void *memory = ::operator new(sizeof(arc_node) + key_size + value_size);
+    arc_node *node = new (memory) arc_node;
+    node->prev = nullptr;
+    node->next = nullptr;
+    node->hash = hash;
+    node->weight = EntrySize(key_size, value_size);
+    node->expire = 0;
+    node->timer_prev = nullptr;
+    node->timer_next = nullptr;
+    node->timer_slot = 0;
+    node->version = 0;
+    node->flags = 0;
+    node->key_size = key_size;
+    node->value_size = value_size;
+    node->list = List::kT1;
+    std::memcpy(node->key(), key, key_size);
+    std::memcpy(node->value(), value, value_size);
+    return node;
+}
+
+void ARC::delete_node(arc_node *node) {
+    node->~arc_node();
+    ::operator delete(node);
+}
+
+ARC::Meta ARC::meta_of(const arc_node &node) {
+    Meta meta;
+    meta.expire = node.expire;
+    meta.version = node.version;
+    meta.flags = node.flags;
+    return meta;
+}
+
+ARC::arc_list &ARC::list_of(List list) {
+    switch (list) {
+    case List::kT1:
+        return _t1;
+    case List::kT2:
+        return _t2;
+    case List::kB1:
+        return _b1;
+    default:
+        return _b2;
+    }
+}
+
+ARC::arc_node *ARC::find_node(StringRef key, std::size_t hash) const {
+    return _index.find(hash, [&](const arc_node &node) {
+        return node.hash == hash && node.key_size == key.size() && std::memcmp(node.key(), key.data(), key.size()) == 0;
+    });
+}
+
+ARC::arc_node *ARC::find_live_node(StringRef key, std::size_t hash) {
+    int64_t moment = now();
+    expire_nodes(moment);
+
+    arc_node *node = find_node(key, hash);
+    if (node != nullptr && node->expire != 0 && node->expire <= moment) {
+        remove(*node);
+        return nullptr;
+    }
+    return node;
+}
+
+void ARC::expire_nodes(int64_t now) {
+    if (now <= 0) {
+        return;
+    }
+    _timers.advance(now, [this](arc_node &node) {
+        // Node is out of the wheel already
+        node.expire = 0;
+        remove(node);
+    });
+}
+
+void ARC::insert(StringRef key, const std::string &value, std::size_t hash, List list, const Meta &meta) {
+    arc_node *node = new_node(key.data(), key.size(), value.data(), value.size(), hash);
+    node->expire = meta.expire;
+    node->flags = meta.flags;
+    node->version = ++_versions;
+    node->list = list;
+    list_of(list).push_tail(*node);
+    _index.insert(node);
+    if (node->expire != 0) {
+        _timers.add(*node);
+    }
+}
+
+void ARC::remove(arc_node &node) {
+    if (node.list == List::kB1 || node.list == List::kB2) {
+        _ghost_bytes -= EntrySize(node.key_size, 0);
+    } else if (node.expire != 0) {
+        _timers.remove(node);
+    }
+    _index.erase(&node);
+    list_of(node.list).unlink(node);
+    delete_node(&node);
+}
+
+void ARC::move(arc_node &node, List list) {
+    list_of(node.list).unlink(node);
+    node.list = list;
+    list_of(list).push_tail(node);
+}
+
+void ARC::to_ghost(arc_node &node) {
+    // Ghost keeps key only, value memory is released
+    evicted(StringRef(node.key(), node.key_size));
+    arc_node *ghost = new_node(node.key(), node.key_size, node.value(), 0, node.hash);
+    ghost->weight = node.weight;
+    ghost->list = node.list == List::kT1 ? List::kB1 : List::kB2;
+    remove(node);
+    list_of(ghost->list).push_tail(*ghost);
+    _index.insert(ghost);
+    _ghost_bytes += EntrySize(ghost->key_size, 0);
+}
+
+void ARC::replace(std::size_t weight, bool in_b2) {
+    // Entries become ghosts while they don't leave room by themselves, then ghosts go
+    while (_t1.size + _t2.size + _ghost_bytes + weight > _max_size) {
+        if (_t1.size + _t2.size + weight <= _max_size) {
+            drop_ghost();
+        } else if (_t1.head != nullptr && (_t1.size > _p || (in_b2 && _t1.size == _p) || _t2.head == nullptr)) {
+            to_ghost(*_t1.head);
+        } else {
+            to_ghost(*_t2.head);
+        }
+    }
+}
+
+void ARC::drop_ghost() {
+    if (_b2.head == nullptr || (_b1.head != nullptr && _b1.size >= _b2.size)) {
+        remove(*_b1.head);
+    } else {
+        remove(*_b2.head);
+    }
+}
+
+void ARC::trim_ghosts() {
+    while (_t1.size + _b1.size > _max_size && _b1.head != nullptr) {
+        remove(*_b1.head);
+    }
+    while (_t1.size + _t2.size + _b1.size + _b2.size > 2 * _max_size && _b2.head != nullptr) {
+        remove(*_b2.head);
+    }
+}
+
+void ARC::put_absent(arc_node *ghost, StringRef key, const std::string &value, std::size_t hash,
+                     const Meta &meta) {
+    std::size_t weight = EntrySize(key.size(), value.size());
+
+    if (ghost != nullptr && ghost->list == List::kB1) {
+        // Recently evicted from T1: recency list deserves more space
+        std::size_t ratio = _b1.size >= _b2.size ? 1 : _b2.size / _b1.size;
+        _p = std::min(_max_size, _p + ratio * ghost->weight);
+        remove(*ghost);
+        replace(weight, false);
+        insert(key, value, hash, List::kT2, meta);
+    } else if (ghost != nullptr) {
+        // Recently evicted from T2: frequency list deserves more space
+        std::size_t ratio = _b2.size >= _b1.size ? 1 : _b1.size / _b2.size;
+        _p -= std::min(_p, ratio * ghost->weight);
+        remove(*ghost);
+        replace(weight, true);
+        insert(key, value, hash, List::kT2, meta);
+    } else {
+        // Completely new key: keep L1 = T1 + B1 within budget
+        while (_t1.size + _b1.size + weight > _max_size && _b1.head != nullptr) {
+            remove(*_b1.head);
+        }
+        while (_t1.size + weight > _max_size && _t1.head != nullptr) {
+            evicted(StringRef(_t1.head->key(), _t1.head->key_size));
+            remove(*_t1.head);
+        }
+        replace(weight, false);
+        insert(key, value, hash, List::kT1, meta);
+    }
+    trim_ghosts();
+}
+
+void ARC::set_node(arc_node &node, const std::string &value, const Meta &meta) {
+    std::string key(node.key(), node.key_size);
+    std::size_t hash = node.hash;
+    remove(node);
+    replace(EntrySize(key.size(), value.size()), false);
+    insert(key, value, hash, List::kT2, meta);
+    trim_ghosts();
+}
+
+// See MapBasedGlobalLockImpl.h
+bool ARC::Put(const std::string &key, const std::string &value) { return ARC::Put(key, value, Meta()); }
+
+// See MapBasedGlobalLockImpl.h
+bool ARC::Put(const std::string &key, const std::string &value, const Meta &meta) {
+    return ARC::Put(StringRef(key), value, meta);
+}
+
+// See MapBasedGlobalLockImpl.h
+bool ARC::Put(StringRef key, const std::string &value, const Meta &meta) {
+    if (EntrySize(key.size(), value.size()) > _max_size) {
+        return false;
+    }
+
+    std::size_t hash = HashKey(key);
+    arc_node *node = find_live_node(key, hash);
+    bool resident = node != nullptr && (node->list == List::kT1 || node->list == List::kT2);
+    if (meta.expired(now())) {
+        if (resident) {
+            remove(*node);
+        }
+    } else if (resident) {
+        set_node(*node, value, meta);
+    } else {
+        put_absent(node, key, value, hash, meta);
+    }
+    return true;
+}
+
+// See MapBasedGlobalLockImpl.h
+bool ARC::PutIfAbsent(const std::string &key, const std::string &value) {
+    return ARC::PutIfAbsent(key, value, Meta());
+}
+
+// See MapBasedGlobalLockImpl.h
+bool ARC::PutIfAbsent(const std::string &key, const std::string &value, const Meta &meta) {
+    return ARC::PutIfAbsent(StringRef(key), value, meta);
+}
+
+// See MapBasedGlobalLockImpl.h
+bool ARC::PutIfAbsent(StringRef key, const std::string &value, const Meta &meta) {
+    if (EntrySize(key.size(), value.size()) > _max_size) {
+        return false;
+    }
+
+    std::size_t hash = HashKey(key);
+    arc_node *node = find_live_node(key, hash);
+    if (node != nullptr && (node->list == List::kT1 || node->list == List::kT2)) {
+        return false;
+    }
+    if (!meta.expired(now())) {
+        put_absent(node, key, value, hash, meta);
+    }
+    return true;
+}
+
+// See MapBasedGlobalLockImpl.h
+bool ARC::Set(const std::string &key, const std::string &value) { return ARC::Set(key, value, Meta()); }
+
+// See MapBasedGlobalLockImpl.h
+bool ARC::Set(const std::string &key, const std::string &value, const Meta &meta) {
+    return ARC::Set(StringRef(key), value, meta);
+}
+
+// See MapBasedGlobalLockImpl.h
+bool ARC::Set(StringRef key, const std::string &value, const Meta &meta) {
+    if (EntrySize(key.size(), value.size()) > _max_size) {
+        return false;
+    }
+
+    arc_node *node = find_live_node(key, HashKey(key));
+    if (node == nullptr || node->list == List::kB1 || node->list == List::kB2) {
+        return false;
+    }
+    if (meta.expired(now())) {
+        remove(*node);
+    } else {
+        set_node(*node, value, meta);
+    }
+    return true;
+}
+
+// See MapBasedGlobalLockImpl.h
+ARC::CasStatus ARC::CompareAndSet(const std::string &key, const std::string &value, const Meta &meta,
+                                  uint64_t version) {
+    arc_node *node = find_live_node(key, HashKey(key));
+    if (node == nullptr || node->list == List::kB1 || node->list == List::kB2) {
+        return CasStatus::kNotFound;
+    } else if (node->version != version) {
+        return CasStatus::kExists;
+    } else if (EntrySize(key.size(), value.size()) > _max_size) {
+        return CasStatus::kNotStored;
+    }
+
+    if (meta.expired(now())) {
+        remove(*node);
+    } else {
+        set_node(*node, value, meta);
+    }
+    return CasStatus::kStored;
+}
+
+bool ARC::join(const std::string &key, const std::string &data, bool front) {
+    arc_node *node = find_live_node(key, HashKey(key));
+    if (node == nullptr || node->list == List::kB1 || node->list == List::kB2 ||
+        EntrySize(key.size(), node->value_size + data.size()) > _max_size) {
+        return false;
+    }
+
+    std::string value;
+    value.reserve(node->value_size + data.size());
+    if (front) {
+        value.append(data).append(node->value(), node->value_size);
+    } else {
+        value.append(node->value(), node->value_size).append(data);
+    }
+    set_node(*node, value, meta_of(*node));
+    return true;
+}
+
+// See MapBasedGlobalLockImpl.h
+bool ARC::Append(const std::string &key, const std::string &data) { return join(key, data, false); }
+
+// See MapBasedGlobalLockImpl.h
+bool ARC::Prepend(const std::string &key, const std::string &data) { return join(key, data, true); }
+
+ARC::CounterStatus ARC::update_node(const std::string &key, uint64_t delta, bool decrement, uint64_t &value) {
+    arc_node *node = find_live_node(key, HashKey(key));
+    if (node == nullptr || node->list == List::kB1 || node->list == List::kB2) {
+        return CounterStatus::kNotFound;
+    }
+    if (!parse_counter(node->value(), node->value_size, value)) {
+        return CounterStatus::kNotNumber;
+    }
+    value = count(value, delta, decrement);
+    set_node(*node, std::to_string(value), meta_of(*node));
+    return CounterStatus::kUpdated;
+}
+
+// See MapBasedGlobalLockImpl.h
+ARC::CounterStatus ARC::Increment(const std::string &key, uint64_t delta, uint64_t &value) {
+    return update_node(key, delta, false, value);
+}
+
+// See MapBasedGlobalLockImpl.h
+ARC::CounterStatus ARC::Decrement(const std::string &key, uint64_t delta, uint64_t &value) {
+    return update_node(key, delta, true, value);
+}
+
+// See MapBasedGlobalLockImpl.h
+bool ARC::Delete(const std::string &key) {
+    arc_node *node = find_live_node(key, HashKey(key));
+    if (node == nullptr) {
+        return false;
+    }
+    bool resident = node->list == List::kT1 || node->list == List::kT2;
+    remove(*node);
+    return resident;
+}
+
+// See MapBasedGlobalLockImpl.h
+bool ARC::Get(const std::string &key, std::string &value) { return ARC::Get(StringRef(key), value); }
+
+// See MapBasedGlobalLockImpl.h
+bool ARC::Get(StringRef key, std::string &value) {
+    arc_node *node = find_live_node(key, HashKey(key));
+    if (node == nullptr || node->list == List::kB1 || node->list == List::kB2) {
+        return false;
+    }
+    value.assign(node->value(), node->value_size);
+    move(*node, List::kT2);
+    return true;
+}
+
+// See MapBasedGlobalLockImpl.h
+std::size_t ARC::MultiGet(const std::vector<StringRef> &keys, std::vector<ValueRef> &values,
+                          std::vector<Meta> *metas, bool versions) {
+    std::size_t found = 0;
+    values.resize(keys.size());
+    if (metas != nullptr) {
+        metas->assign(keys.size(), Meta());
+    }
+    for (std::size_t i = 0; i < keys.size(); i++) {
+        values[i].reset();
+        arc_node *node = find_live_node(keys[i], HashKey(keys[i]));
+        if (node == nullptr || node->list == List::kB1 || node->list == List::kB2) {
+            continue;
+        }
+        values[i] = ValueRef::Copy(std::string(node->value(), node->value_size));
+        if (metas != nullptr) {
+            (*metas)[i] = meta_of(*node);
+        }
+        move(*node, List::kT2);
+        found++;
+    }
+    return found;
+}
+
+// See MapBasedGlobalLockImpl.h
+bool ARC::Export(const std::function<void(Item &item)> &visit) {
+    std::vector<Item> items;
+    Collect(items);
+    for (Item &item : items) {
+        visit(item);
+    }
+    return true;
+}
+
+// See ARC.h
+void ARC::Collect(std::vector<Item> &items) {
+    // Ghosts have no values, entries seen twice go last
+    int64_t moment = now();
+    for (arc_list *list : {&_t1, &_t2}) {
+        for (arc_node *node = list->head; node != nullptr; node = node->next) {
+            Meta meta = meta_of(*node);
+            if (!meta.expired(moment)) {
+                items.emplace_back(std::string(node->key(), node->key_size),
+                                   ValueRef::Copy(std::string(node->value(), node->value_size)), meta);
+            }
+        }
+    }
+}
+
+// See ARC.h
+uint64_t ARC::Scan(uint64_t cursor, std::size_t count, std::vector<std::string> &keys) {
+    int64_t moment = now();
+    std::size_t batch = std::max<std::size_t>(count, 1);
+    std::size_t wanted = keys.size() + batch;
+    for (std::size_t groups = 0; groups < batch && keys.size() < wanted; groups++) {
+        cursor = _index.scan(cursor, [&](const arc_node &node) {
+            if (node.list != List::kB1 && node.list != List::kB2 && (node.expire == 0 || node.expire > moment)) {
+                keys.emplace_back(node.key(), node.key_size);
+            }
+        });
+        if (cursor == 0) {
+            break;
+        }
+    }
+    return cursor;
+}
+
+} // namespace Backend
+} // namespace Afina
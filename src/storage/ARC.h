@@ -0,0 +1,248 @@
+#ifndef AFINA_STORAGE_ARC_H
+#define AFINA_STORAGE_ARC_H
+
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <afina/Storage.h>
+
+#include "HashIndex.h"
+#include "KeyHash.h"
+#include "TimerWheel.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Adaptive Replacement Cache
+ * That is NOT thread safe implementaiton!!
+ *
+ * Resident entries live in two LRU lists:
+ * - T1: entries seen once recently
+ * - T2: entries seen at least twice recently
+ *
+ * Entries evicted from T1/T2 leave only their key in ghost lists B1/B2. Put of a key found in B1 means T1
+ * should be larger, in B2 - that T2 should, so target size of T1 (p) moves accordingly and the cache tunes
+ * itself between recency and frequency heavy traffic.
+ *
+ * All sizes are in bytes: resident entries T1 + T2 never exceed max_size (see EntrySize), ghosts remember
+ * bytes entry used to occupy and T1 + B1 <= max_size, T1 + T2 + B1 + B2 <= 2 * max_size. Ghost keys are held in
+ * memory too, so bytes ghosts really take are charged as well: T1 + T2 and ghost nodes together fit max_size.
+ *
+ * Resident entries that expire are tracked by a TimerWheel, which every lookup advances: expired entry is
+ * dropped and its bytes are released once its time comes, not once the key is touched again.
+ */
+class ARC : public Afina::Storage {
+public:
+    ARC(size_t max_size = 1024)
+        : _max_size(max_size), _p(0), _ghost_bytes(0), _versions(0), _timers(std::time(nullptr)) {}
+    ~ARC();
+
+    // Implements Afina::Storage interface
+    bool Put(const std::string &key, const std::string &value) override;
+
+    // Implements Afina::Storage interface
+    bool Put(const std::string &key, const std::string &value, const Meta &meta) override;
+
+    // Implements Afina::Storage interface
+    bool Put(StringRef key, const std::string &value, const Meta &meta) override;
+
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(const std::string &key, const std::string &value) override;
+
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(const std::string &key, const std::string &value, const Meta &meta) override;
+
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(StringRef key, const std::string &value, const Meta &meta) override;
+
+    // Implements Afina::Storage interface
+    bool Set(const std::string &key, const std::string &value) override;
+
+    // Implements Afina::Storage interface
+    bool Set(const std::string &key, const std::string &value, const Meta &meta) override;
+
+    // Implements Afina::Storage interface
+    bool Set(StringRef key, const std::string &value, const Meta &meta) override;
+
+    // Implements Afina::Storage interface
+    CasStatus CompareAndSet(const std::string &key, const std::string &value, const Meta &meta,
+                            uint64_t version) override;
+
+    // Implements Afina::Storage interface
+    bool Append(const std::string &key, const std::string &data) override;
+
+    // Implements Afina::Storage interface
+    bool Prepend(const std::string &key, const std::string &data) override;
+
+    // Implements Afina::Storage interface
+    CounterStatus Increment(const std::string &key, uint64_t delta, uint64_t &value) override;
+
+    // Implements Afina::Storage interface
+    CounterStatus Decrement(const std::string &key, uint64_t delta, uint64_t &value) override;
+
+    // Implements Afina::Storage interface
+    bool Delete(const std::string &key) override;
+
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, std::string &value) override;
+
+    // Implements Afina::Storage interface
+    bool Get(StringRef key, std::string &value) override;
+
+    // MultiGet of std::string keys is the default one
+    using Afina::Storage::MultiGet;
+
+    // Implements Afina::Storage interface
+    std::size_t MultiGet(const std::vector<StringRef> &keys, std::vector<ValueRef> &values,
+                         std::vector<Meta> *metas, bool versions) override;
+
+    // Implements Afina::Storage interface, the whole storage is a single part
+    bool Export(const std::function<void(Item &item)> &visit) override;
+
+    // Implements Afina::Storage interface. Keys come in the order of index groups, see HashIndex::scan, and each
+    // call visits count groups at most. Ghosts are skipped, they have no association
+    uint64_t Scan(uint64_t cursor, std::size_t count, std::vector<std::string> &keys) override;
+
+    /**
+     * Appends copies of all resident entries to items, see Export. Doesn't change frequencies or lists
+     */
+    virtual void Collect(std::vector<Item> &items);
+
+    /**
+     * Number of bytes of the storage budget single entry with given key and value sizes occupies
+     */
+    static std::size_t EntrySize(std::size_t key_size, std::size_t value_size);
+
+protected:
+    // Current unix time, see Meta::expire
+    virtual int64_t now() const { return std::time(nullptr); }
+
+private:
+    enum class List : uint8_t { kT1, kT2, kB1, kB2 };
+
+    // Cache node, header followed by key bytes and then by value bytes in the same memory block. Ghost nodes
+    // have no value
+    struct arc_node {
+        arc_node *prev;
+        arc_node *next;
+        std::size_t hash;
+
+        // Size of the entry in budget bytes, for ghosts - size entry had when it was resident
+        std::size_t weight;
+
+        // See Meta::expire, ghosts never expire
+        int64_t expire;
+
+        // Links of the expiration timer wheel, used only if entry expires
+        arc_node *timer_prev;
+        arc_node *timer_next;
+        uint8_t timer_slot;
+
+        // Changes along with the value, see Meta::version
+        uint64_t version;
+
+        uint32_t key_size;
+        uint32_t value_size;
+
+        // See Meta::flags
+        uint32_t flags;
+        List list;
+
+        char *key() { return reinterpret_cast<char *>(this + 1); }
+        const char *key() const { return reinterpret_cast<const char *>(this + 1); }
+
+        char *value() { return key() + key_size; }
+        const char *value() const { return key() + key_size; }
+    };
+
+    // Intrusive LRU list, head is the least recently used entry
+    struct arc_list {
+        arc_list() : head(nullptr), tail(nullptr), size(0) {}
+
+        void push_tail(arc_node &node);
+        void unlink(arc_node &node);
+
+        arc_node *head;
+        arc_node *tail;
+
+        // Total weight of entries in the list
+        std::size_t size;
+    };
+
+    static arc_node *new_node(const char *key, std::size_t key_size, const char *value, std::size_t value_size,
+                              std::size_t hash);
+    static void delete_node(arc_node *node);
+
+    // Attributes of the resident entry
+    static Meta meta_of(const arc_node &node);
+
+    arc_list &list_of(List list);
+    arc_node *find_node(StringRef key, std::size_t hash) const;
+
+    // Same as find_node, but resident entry that has expired is removed and not returned
+    arc_node *find_live_node(StringRef key, std::size_t hash);
+
+    // Drops entries expired by the given moment
+    void expire_nodes(int64_t now);
+
+    void insert(StringRef key, const std::string &value, std::size_t hash, List list, const Meta &meta);
+    void remove(arc_node &node);
+    void move(arc_node &node, List list);
+
+    // Turns resident LRU entry of T1 or T2 into ghost of B1 or B2 respectively
+    void to_ghost(arc_node &node);
+
+    // Evicts resident entries and drops ghosts until another weight bytes fit
+    void replace(std::size_t weight, bool in_b2);
+
+    // Drops least recently used ghost of the longer ghost list
+    void drop_ghost();
+
+    // Drops ghosts beyond directory limits
+    void trim_ghosts();
+
+    // Put of the key which isn't resident
+    void put_absent(arc_node *ghost, StringRef key, const std::string &value, std::size_t hash,
+                    const Meta &meta);
+
+    // Replaces value of the resident entry, update is an access as well, so entry goes to T2
+    void set_node(arc_node &node, const std::string &value, const Meta &meta);
+
+    // Adds data to the value of the existing key, at the beginning if front is set or at the end otherwise
+    bool join(const std::string &key, const std::string &data, bool front);
+
+    // Updates counter of the existing key, see Increment
+    CounterStatus update_node(const std::string &key, uint64_t delta, bool decrement, uint64_t &value);
+
+    // Maximum number of bytes could be stored in this cache, see EntrySize
+    std::size_t _max_size;
+
+    // Target size of T1
+    std::size_t _p;
+
+    arc_list _t1;
+    arc_list _t2;
+    arc_list _b1;
+    arc_list _b2;
+
+    // Number of bytes ghost nodes of B1 and B2 take, see EntrySize
+    std::size_t _ghost_bytes;
+
+    // Last version assigned to a node
+    uint64_t _versions;
+
+    // Expiration times of resident entries that expire
+    TimerWheel<arc_node> _timers;
+
+    // Index of both resident and ghost entries
+    HashIndex<arc_node> _index;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_ARC_H
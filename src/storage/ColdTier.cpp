@@ -0,0 +1,252 @@
+#include "ColdTier.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "KeyHash.h"
+
+namespace Afina {
+namespace Backend {
+
+namespace {
+
+// Record header: key size, value size, expiration time and flags, followed by key and value bytes
+const std::size_t kHeaderSize = 4 * sizeof(uint32_t);
+
+// Number of bytes waiting to be written, demotions beyond that are dropped
+const std::size_t kMaxPending = 16 << 20;
+
+std::string failure(const std::string &what, const std::string &path) {
+    return what + " " + path + ": " + std::string(strerror(errno));
+}
+
+bool write_at(int fd, const char *data, std::size_t size, uint64_t offset) {
+    while (size > 0) {
+        ssize_t written = pwrite(fd, data, size, offset);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        } else if (written <= 0) {
+            return false;
+        }
+        data += written;
+        size -= written;
+        offset += written;
+    }
+    return true;
+}
+
+bool read_at(int fd, char *data, std::size_t size, uint64_t offset) {
+    while (size > 0) {
+        ssize_t got = pread(fd, data, size, offset);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        } else if (got <= 0) {
+            return false;
+        }
+        data += got;
+        size -= got;
+        offset += got;
+    }
+    return true;
+}
+
+} // namespace
+
+ColdTier::ColdTier(const std::string &path, std::size_t max_size, std::size_t max_reads)
+    : _path(path), _segment_size(max_size / 2), _max_reads(max_reads), _fds{-1, -1}, _active(0), _end(0),
+      _pending(0), _failed(false), _running(true) {
+    for (int i = 0; i < 2; i++) {
+        std::string segment = _path + "." + std::to_string(i);
+        _fds[i] = open(segment.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+        if (_fds[i] < 0) {
+            std::string error = failure("Failed to open cold tier", segment);
+            if (i > 0) {
+                close(_fds[0]);
+            }
+            throw std::runtime_error(error);
+        }
+    }
+    _worker = std::thread(&ColdTier::run, this);
+}
+
+ColdTier::~ColdTier() {
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _running = false;
+    }
+    _wake.notify_all();
+    _worker.join();
+    for (int i = 0; i < 2; i++) {
+        close(_fds[i]);
+        unlink((_path + "." + std::to_string(i)).c_str());
+    }
+}
+
+// See ColdTier.h
+bool ColdTier::Demote(StringRef key, uint64_t hash, StringRef value, uint32_t expire, uint32_t flags) {
+    std::size_t size = kHeaderSize + key.size() + value.size();
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (_failed || size > _segment_size || _pending + size > kMaxPending) {
+        return false;
+    }
+    if (_end + size > _segment_size) {
+        switch_segment();
+    }
+
+    if (_writes.empty() || _writes.back().truncate || _writes.back().segment != _active ||
+        _writes.back().offset + _writes.back().data.size() != _end) {
+        _writes.push_back(cold_write{_active, _end, std::string(), false});
+    }
+    std::string &data = _writes.back().data;
+    uint32_t header[4] = {static_cast<uint32_t>(key.size()), static_cast<uint32_t>(value.size()), expire, flags};
+    data.append(reinterpret_cast<const char *>(header), kHeaderSize);
+    data.append(key.data(), key.size());
+    data.append(value.data(), value.size());
+
+    _index[hash] = cold_entry{_end, static_cast<uint32_t>(size), expire, _active};
+    _end += size;
+    _pending += size;
+    _wake.notify_one();
+    return true;
+}
+
+// See ColdTier.h
+bool ColdTier::Fetch(uint64_t hash, int64_t now) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    auto it = _index.find(hash);
+    if (it == _index.end()) {
+        return false;
+    }
+    if (it->second.expire != 0 && it->second.expire <= now) {
+        _index.erase(it);
+        return false;
+    }
+
+    if (_reading.count(hash) == 0 && _reading.size() + _results.size() < _max_reads) {
+        _reading.insert(hash);
+        _reads.push_back(cold_read{hash, it->second});
+        _wake.notify_one();
+    }
+    return true;
+}
+
+// See ColdTier.h
+bool ColdTier::Forget(uint64_t hash) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _index.erase(hash) > 0;
+}
+
+// See ColdTier.h
+void ColdTier::Take(std::vector<Promotion> &promoted) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    for (cold_result &result : _results) {
+        auto it = _index.find(result.hash);
+        if (it != _index.end() && it->second.segment == result.entry.segment &&
+            it->second.offset == result.entry.offset) {
+            _index.erase(it);
+            promoted.push_back(std::move(result.promotion));
+        }
+    }
+    _results.clear();
+}
+
+// See ColdTier.h
+std::size_t ColdTier::size() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _index.size();
+}
+
+void ColdTier::switch_segment() {
+    _active ^= 1;
+    for (auto it = _index.begin(); it != _index.end();) {
+        if (it->second.segment == _active) {
+            it = _index.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    _writes.push_back(cold_write{_active, 0, std::string(), true});
+    _end = 0;
+}
+
+void ColdTier::run() {
+    std::deque<cold_write> writes;
+    std::vector<cold_read> reads;
+    std::vector<cold_result> results;
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+        _wake.wait(lock, [this] { return !_writes.empty() || !_reads.empty() || !_running; });
+        if (!_running) {
+            break;
+        }
+
+        // Writes go first, so every record requested is on disk by the time it is read
+        writes.swap(_writes);
+        reads.swap(_reads);
+        _pending = 0;
+        lock.unlock();
+
+        bool ok = true;
+        for (const cold_write &write : writes) {
+            if (write.truncate) {
+                ok = ok && ftruncate(_fds[write.segment], 0) == 0;
+            } else {
+                ok = ok && write_at(_fds[write.segment], write.data.data(), write.data.size(), write.offset);
+            }
+        }
+        for (const cold_read &request : reads) {
+            Promotion promotion;
+            if (ok && read(request, promotion)) {
+                results.push_back(cold_result{request.hash, request.entry, std::move(promotion)});
+            }
+        }
+        writes.clear();
+
+        lock.lock();
+        if (!ok) {
+            // Records are lost, so are the values
+            _failed = true;
+            _index.clear();
+        }
+        for (const cold_read &request : reads) {
+            _reading.erase(request.hash);
+        }
+        for (cold_result &result : results) {
+            _results.push_back(std::move(result));
+        }
+        reads.clear();
+        results.clear();
+    }
+}
+
+bool ColdTier::read(const cold_read &request, Promotion &promotion) {
+    std::string record(request.entry.size, '\0');
+    if (!read_at(_fds[request.entry.segment], &record[0], record.size(), request.entry.offset)) {
+        // Segment has been truncated meanwhile
+        return false;
+    }
+
+    uint32_t header[4];
+    std::memcpy(header, record.data(), kHeaderSize);
+    if (kHeaderSize + uint64_t(header[0]) + header[1] != record.size()) {
+        return false;
+    }
+    StringRef key(record.data() + kHeaderSize, header[0]);
+    if (HashKey(key) != request.hash) {
+        return false;
+    }
+
+    promotion.key = key.str();
+    promotion.value.assign(record.data() + kHeaderSize + header[0], header[1]);
+    promotion.expire = header[2];
+    promotion.flags = header[3];
+    return true;
+}
+
+} // namespace Backend
+} // namespace Afina
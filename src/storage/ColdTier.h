@@ -0,0 +1,145 @@
+#ifndef AFINA_STORAGE_COLD_TIER_H
+#define AFINA_STORAGE_COLD_TIER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <afina/StringRef.h>
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # File backed second tier for values evicted from memory
+ * Values are appended to one of two segment files, the index in memory maps key hash to the record location
+ * only, so it takes a few dozen bytes per value whatever key and value sizes are. Once the active segment is
+ * full the other one is truncated, dropping its values, and becomes active: the tier keeps the most recently
+ * demoted values, from half to the whole of max_size bytes.
+ *
+ * Callers never touch the disk. Demote and Fetch only enqueue the work for the I/O thread, which writes records
+ * out and then reads requested ones back. Both queues are bounded: demotion that doesn't fit is dropped, as is
+ * fetch beyond the limit of reads in flight, value is just lost or read later then. Values that have been read
+ * wait in Take for the storage to promote them.
+ *
+ * Thread safe. Files are scratch space: they are truncated on start and removed once the tier is destroyed.
+ */
+class ColdTier {
+public:
+    // Value read back from the tier
+    struct Promotion {
+        std::string key;
+        std::string value;
+        uint32_t expire;
+        uint32_t flags;
+    };
+
+    /**
+     * Opens segment files path.0 and path.1, throws std::runtime_error if that fails
+     *
+     * @param path prefix of the segment files
+     * @param max_size number of bytes both segments could take
+     * @param max_reads number of reads in flight
+     */
+    ColdTier(const std::string &path, std::size_t max_size = 256 << 20, std::size_t max_reads = 64);
+    ~ColdTier();
+
+    /**
+     * Enqueues value for writing, returns false if it is dropped
+     */
+    bool Demote(StringRef key, uint64_t hash, StringRef value, uint32_t expire, uint32_t flags);
+
+    /**
+     * Requests value of the key to be read back, if tier has it. Returns true if it has, value could be taken
+     * once read
+     */
+    bool Fetch(uint64_t hash, int64_t now);
+
+    /**
+     * Drops value of the key, if any, as storage has a newer one. Returns true if there was value
+     */
+    bool Forget(uint64_t hash);
+
+    /**
+     * Moves values read so far to promoted and drops them from the tier. Value that has been demoted again or
+     * forgotten meanwhile is skipped
+     */
+    void Take(std::vector<Promotion> &promoted);
+
+    // Number of values tier has
+    std::size_t size();
+
+private:
+    // Location of the record in the segment
+    struct cold_entry {
+        uint64_t offset;
+        uint32_t size;
+        uint32_t expire;
+        uint8_t segment;
+    };
+
+    // Work of the I/O thread: records to write out or segment to truncate
+    struct cold_write {
+        uint8_t segment;
+        uint64_t offset;
+        std::string data;
+        bool truncate;
+    };
+
+    struct cold_read {
+        uint64_t hash;
+        cold_entry entry;
+    };
+
+    struct cold_result {
+        uint64_t hash;
+        cold_entry entry;
+        Promotion promotion;
+    };
+
+    ColdTier(const ColdTier &);            // = delete;
+    ColdTier &operator=(const ColdTier &); // = delete;
+
+    // I/O thread
+    void run();
+
+    // Reads the record back, returns false if it is gone
+    bool read(const cold_read &request, Promotion &promotion);
+
+    // Makes the other segment active, dropping its values
+    void switch_segment();
+
+    std::string _path;
+    std::size_t _segment_size;
+    std::size_t _max_reads;
+    int _fds[2];
+
+    std::mutex _mutex;
+    std::condition_variable _wake;
+
+    std::unordered_map<uint64_t, cold_entry> _index;
+    uint8_t _active;
+    uint64_t _end;
+
+    std::deque<cold_write> _writes;
+    std::size_t _pending;
+    std::vector<cold_read> _reads;
+    std::unordered_set<uint64_t> _reading;
+    std::vector<cold_result> _results;
+
+    // Set once I/O has failed, tier takes nothing from then on
+    bool _failed;
+    bool _running;
+    std::thread _worker;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_COLD_TIER_H
@@ -0,0 +1,173 @@
+#include "CuckooFilter.h"
+
+#include <afina/concurrency/Epoch.h>
+
+namespace Afina {
+namespace Backend {
+
+namespace {
+
+const uint64_t kLaneOnes = 0x0001000100010001ULL;
+const uint64_t kLaneHighs = 0x8000800080008000ULL;
+
+uint16_t lane(uint64_t bucket, std::size_t i) { return static_cast<uint16_t>(bucket >> (16 * i)); }
+
+uint64_t with_lane(uint64_t bucket, std::size_t i, uint16_t fp) {
+    return (bucket & ~(uint64_t(0xFFFF) << (16 * i))) | (uint64_t(fp) << (16 * i));
+}
+
+} // namespace
+
+CuckooFilter::table::table(std::size_t number)
+    : buckets(new std::atomic<uint64_t>[number]), mask(number - 1), stash(0), size(0) {
+    for (std::size_t i = 0; i < number; i++) {
+        buckets[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+CuckooFilter::CuckooFilter() : _table(new table(kMinBuckets)), _moves(0), _random(2463534242u) {}
+
+CuckooFilter::~CuckooFilter() { delete _table.load(); }
+
+// See CuckooFilter.h
+bool CuckooFilter::contains(std::size_t hash) const {
+    Concurrency::Epoch::Guard guard;
+    uint64_t moves = _moves.load(std::memory_order_acquire);
+    if (moves & 1) {
+        return true;
+    }
+
+    const table &t = *_table.load(std::memory_order_acquire);
+    uint16_t fp = fingerprint(hash);
+    std::size_t first = hash & t.mask;
+    std::size_t second = alternative(t, first, fp);
+    uint64_t stash = t.stash.load(std::memory_order_acquire);
+    bool found = find(t.buckets[first].load(std::memory_order_acquire), fp) < kSlots ||
+                 find(t.buckets[second].load(std::memory_order_acquire), fp) < kSlots ||
+                 (stash >> 32 == fp && ((stash & t.mask) == first || (stash & t.mask) == second));
+
+    // Fingerprint could have been in neither bucket while looked up if it was moved meanwhile
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return found || _moves.load(std::memory_order_relaxed) != moves;
+}
+
+// See CuckooFilter.h
+bool CuckooFilter::insert(std::size_t hash) {
+    table &t = *_table.load(std::memory_order_relaxed);
+    return add(t, hash) && t.size * 100 < (t.mask + 1) * kSlots * kMaxLoadPercent;
+}
+
+// See CuckooFilter.h
+void CuckooFilter::erase(std::size_t hash) {
+    table &t = *_table.load(std::memory_order_relaxed);
+    uint16_t fp = fingerprint(hash);
+    std::size_t first = hash & t.mask;
+    std::size_t second = alternative(t, first, fp);
+
+    uint64_t stash = t.stash.load(std::memory_order_relaxed);
+    if (stash >> 32 == fp && ((stash & t.mask) == first || (stash & t.mask) == second)) {
+        t.stash.store(0, std::memory_order_release);
+        t.size--;
+        return;
+    }
+    for (std::size_t bucket : {first, second}) {
+        uint64_t value = t.buckets[bucket].load(std::memory_order_relaxed);
+        std::size_t i = find(value, fp);
+        if (i < kSlots) {
+            t.buckets[bucket].store(with_lane(value, i, 0), std::memory_order_release);
+            t.size--;
+            return;
+        }
+    }
+}
+
+// See CuckooFilter.h
+void CuckooFilter::rebuild(const std::vector<std::size_t> &hashes) {
+    std::size_t number = kMinBuckets;
+    while (number * kSlots < 2 * hashes.size()) {
+        number *= 2;
+    }
+
+    // Nobody sees new table until it is complete, so it is filled as is, just grows if anything gets stashed
+    table *fresh = nullptr;
+    for (bool complete = false; !complete; number *= 2) {
+        delete fresh;
+        fresh = new table(number);
+        complete = true;
+        for (std::size_t hash : hashes) {
+            if (!add(*fresh, hash)) {
+                complete = false;
+                break;
+            }
+        }
+    }
+
+    table *old = _table.exchange(fresh, std::memory_order_acq_rel);
+    Concurrency::Epoch::Retire(old, &delete_table);
+}
+
+void CuckooFilter::delete_table(void *t) { delete static_cast<table *>(t); }
+
+std::size_t CuckooFilter::find(uint64_t bucket, uint16_t fp) {
+    // Lanes equal to the fingerprint turn into zero ones
+    uint64_t diff = bucket ^ (fp * kLaneOnes);
+    uint64_t zeros = (diff - kLaneOnes) & ~diff & kLaneHighs;
+    if (zeros == 0) {
+        return kSlots;
+    }
+    for (std::size_t i = 0; i < kSlots; i++) {
+        if (lane(bucket, i) == fp) {
+            return i;
+        }
+    }
+    return kSlots;
+}
+
+bool CuckooFilter::put(table &t, std::size_t bucket, uint16_t fp) {
+    uint64_t value = t.buckets[bucket].load(std::memory_order_relaxed);
+    for (std::size_t i = 0; i < kSlots; i++) {
+        if (lane(value, i) == 0) {
+            t.buckets[bucket].store(with_lane(value, i, fp), std::memory_order_release);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CuckooFilter::add(table &t, std::size_t hash) {
+    uint16_t fp = fingerprint(hash);
+    std::size_t bucket = hash & t.mask;
+    t.size++;
+    if (put(t, bucket, fp) || put(t, alternative(t, bucket, fp), fp)) {
+        return true;
+    }
+
+    // Random walk: fingerprint takes place of a random one, which goes to its other bucket, and so on
+    uint64_t moves = _moves.load(std::memory_order_relaxed);
+    _moves.store(moves + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    bool placed = false;
+    for (std::size_t kick = 0; kick < kMaxKicks && !placed; kick++) {
+        _random ^= _random << 13;
+        _random ^= _random >> 17;
+        _random ^= _random << 5;
+        std::size_t i = _random % kSlots;
+
+        uint64_t value = t.buckets[bucket].load(std::memory_order_relaxed);
+        uint16_t victim = lane(value, i);
+        t.buckets[bucket].store(with_lane(value, i, fp), std::memory_order_relaxed);
+        fp = victim;
+        bucket = alternative(t, bucket, fp);
+        placed = put(t, bucket, fp);
+    }
+    if (!placed) {
+        t.stash.store((uint64_t(fp) << 32) | bucket, std::memory_order_relaxed);
+    }
+
+    _moves.store(moves + 2, std::memory_order_release);
+    return placed;
+}
+
+} // namespace Backend
+} // namespace Afina
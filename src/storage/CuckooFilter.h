@@ -0,0 +1,114 @@
+#ifndef AFINA_STORAGE_CUCKOO_FILTER_H
+#define AFINA_STORAGE_CUCKOO_FILTER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Cuckoo filter of key hashes
+ * Approximate set of hashes: contains may answer yes for the hash never added, but never answers no for the one
+ * added, and unlike Bloom filter hash could be removed. Each hash is kept as 16 bit fingerprint in one of two
+ * buckets of 4 slots, the second bucket is derived from the first one and the fingerprint, so adding hash to the
+ * full bucket moves fingerprints found there to their other buckets. Bucket is a single 8 byte word, so lookup
+ * reads two words, about 8 / 65536 of hashes not added are reported as present.
+ *
+ * Filter is modified by one thread at a time, the owner's lock holder, but contains could be called concurrently
+ * without any lock. Fingerprints moved between buckets are announced by the sequence counter, lookup that has
+ * overlapped such move reports hash as present. Table grown is replaced as a whole, the old one is freed via
+ * Concurrency::Epoch.
+ */
+class CuckooFilter {
+public:
+    CuckooFilter();
+    ~CuckooFilter();
+
+    /**
+     * Could the hash be in the set. Safe to call concurrently with modifications
+     */
+    bool contains(std::size_t hash) const;
+
+    /**
+     * Adds hash to the set. Hash is always added, but if false is returned filter has got too full and must be
+     * rebuilt before the next insert, see rebuild
+     */
+    bool insert(std::size_t hash);
+
+    /**
+     * Removes one copy of the hash added before
+     */
+    void erase(std::size_t hash);
+
+    /**
+     * Replaces the set with given hashes in the table sized for them with room to grow
+     */
+    void rebuild(const std::vector<std::size_t> &hashes);
+
+    // Number of bytes table takes
+    std::size_t bytes() const { return (_table.load(std::memory_order_relaxed)->mask + 1) * sizeof(uint64_t); }
+
+private:
+    CuckooFilter(const CuckooFilter &);            // = delete;
+    CuckooFilter &operator=(const CuckooFilter &); // = delete;
+
+    static constexpr std::size_t kMinBuckets = 64;
+    static constexpr std::size_t kSlots = 4;
+
+    // Number of fingerprints moved before insert gives up and stashes the last one
+    static constexpr std::size_t kMaxKicks = 256;
+
+    // Table is rebuilt once that part of slots is taken, and rebuilt table has at most half of them taken
+    static constexpr std::size_t kMaxLoadPercent = 90;
+
+    struct table {
+        explicit table(std::size_t buckets);
+
+        // Buckets of kSlots fingerprints, zero one is an empty slot
+        std::unique_ptr<std::atomic<uint64_t>[]> buckets;
+        std::size_t mask;
+
+        // Fingerprint that hasn't found a place, shifted left by 32 and combined with its bucket, or 0
+        std::atomic<uint64_t> stash;
+
+        // Number of fingerprints in the table
+        std::size_t size;
+    };
+
+    static void delete_table(void *t);
+
+    static uint16_t fingerprint(std::size_t hash) {
+        uint16_t fp = static_cast<uint16_t>(hash >> 48);
+        return fp == 0 ? 1 : fp;
+    }
+
+    static std::size_t alternative(const table &t, std::size_t bucket, uint16_t fp) {
+        return (bucket ^ (fp * 0x5bd1e995u)) & t.mask;
+    }
+
+    // Lane of the bucket holding given fingerprint, or kSlots if there is none
+    static std::size_t find(uint64_t bucket, uint16_t fp);
+
+    // Puts fingerprint into free slot of the bucket, returns false if bucket is full
+    static bool put(table &t, std::size_t bucket, uint16_t fp);
+
+    // Adds fingerprint to the table, returns false if it has been stashed
+    bool add(table &t, std::size_t hash);
+
+    std::atomic<table *> _table;
+
+    // Odd while fingerprints are moved between buckets, see contains
+    std::atomic<uint64_t> _moves;
+
+    // State of the generator picking fingerprints to move
+    uint32_t _random;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_CUCKOO_FILTER_H
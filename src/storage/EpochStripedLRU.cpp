@@ -0,0 +1,592 @@
+#include "EpochStripedLRU.h"
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <new>
+
+#include <afina/concurrency/Epoch.h>
+
+#include "KeyHash.h"
+
+namespace Afina {
+namespace Backend {
+
+namespace {
+
+// Number of buckets new shard table starts with
+constexpr std::size_t kInitialBuckets = 16;
+
+uint64_t reverse_bits(uint64_t value) {
+    uint64_t result = 0;
+    for (int i = 0; i < 64; i++) {
+        result = (result << 1) | (value & 1);
+        value >>= 1;
+    }
+    return result;
+}
+
+} // namespace
+
+EpochStripedLRU::shard::shard(std::size_t max_size)
+    : table(new epoch_table(kInitialBuckets, 0)), space_left(max_size), count(0), versions(0), head(nullptr),
+      tail(nullptr), timers(std::time(nullptr)) {}
+
+EpochStripedLRU::EpochStripedLRU(size_t shard_size, size_t num_shards) : _shard_size(shard_size) {
+    for (size_t i = 0; i < num_shards; i++) {
+        _shards.emplace_back(new shard(_shard_size));
+    }
+}
+
+EpochStripedLRU::~EpochStripedLRU() {
+    // Nobody could read storage being destroyed, so nodes are released directly. Retired ones are released by epoch
+    for (auto &s : _shards) {
+        while (s->head != nullptr) {
+            epoch_node *next = s->head->next;
+            delete_node(s->head);
+            s->head = next;
+        }
+        delete s->table.load(std::memory_order_relaxed);
+    }
+}
+
+// See EpochStripedLRU.h
+std::size_t EpochStripedLRU::EntrySize(std::size_t key_size, std::size_t value_size) {
+    // Table keeps load factor between 1/2 and 1, so account two buckets per entry
+    return sizeof(epoch_node) + key_size + value_size + 2 * sizeof(std::atomic<epoch_node *>);
+}
+
+EpochStripedLRU::epoch_node *EpochStripedLRU::new_node(const char *key, std::size_t key_size, const char *value,
+                                                       std::size_t value_size, std::size_t hash) {
+    void *memory = ::operator new(sizeof(epoch_node) + key_size + value_size);
+    epoch_node *node = new (memory) epoch_node;
+    node->chain[0].store(nullptr, std::memory_order_relaxed);
+    node->chain[1].store(nullptr, std::memory_order_relaxed);
+    node->prev = nullptr;
+    node->next = nullptr;
+    node->timer_prev = nullptr;
+    node->timer_next = nullptr;
+    node->timer_slot = 0;
+    node->hash = hash;
+    node->key_size = key_size;
+    node->value_size = value_size;
+    node->version = 0;
+    node->flags = 0;
+    node->expire = 0;
+    node->refs.store(1, std::memory_order_relaxed);
+    node->referenced.store(false, std::memory_order_relaxed);
+    std::memcpy(node->key(), key, key_size);
+    std::memcpy(node->value(), value, value_size);
+    return node;
+}
+
+void EpochStripedLRU::delete_node(void *node) {
+    epoch_node *n = static_cast<epoch_node *>(node);
+    if (n->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        n->~epoch_node();
+        ::operator delete(n);
+    }
+}
+
+std::atomic<EpochStripedLRU::epoch_node *> &EpochStripedLRU::find_link(shard &s, const char *key,
+                                                                       std::size_t key_size,
+                                                                       std::size_t hash) const {
+    epoch_table *table = s.table.load(std::memory_order_relaxed);
+    std::atomic<epoch_node *> *link = &table->buckets[bucket_of(hash) & table->mask];
+    for (;;) {
+        epoch_node *node = link->load(std::memory_order_relaxed);
+        if (node == nullptr ||
+            (node->hash == hash && node->key_size == key_size && std::memcmp(node->key(), key, key_size) == 0)) {
+            return *link;
+        }
+        link = &node->chain[table->link];
+    }
+}
+
+std::atomic<EpochStripedLRU::epoch_node *> &EpochStripedLRU::find_live_link(shard &s, StringRef key,
+                                                                            std::size_t hash) {
+    int64_t moment = now();
+    expire_nodes(s, moment);
+
+    std::atomic<epoch_node *> &link = find_link(s, key.data(), key.size(), hash);
+    epoch_node *node = link.load(std::memory_order_relaxed);
+    if (node == nullptr || node->expire == 0 || node->expire > moment) {
+        return link;
+    }
+
+    // Chain now goes on with the next node, so terminating link is looked up again
+    remove_node(s, link);
+    return find_link(s, key.data(), key.size(), hash);
+}
+
+EpochStripedLRU::Meta EpochStripedLRU::meta_of(const epoch_node &node) {
+    Meta meta;
+    meta.expire = node.expire;
+    meta.version = node.version;
+    meta.flags = node.flags;
+    return meta;
+}
+
+void EpochStripedLRU::unlink(shard &s, epoch_node &node) {
+    if (node.prev != nullptr) {
+        node.prev->next = node.next;
+    } else {
+        s.head = node.next;
+    }
+
+    if (node.next != nullptr) {
+        node.next->prev = node.prev;
+    } else {
+        s.tail = node.prev;
+    }
+    node.prev = nullptr;
+    node.next = nullptr;
+}
+
+void EpochStripedLRU::link_tail(shard &s, epoch_node &node) {
+    node.prev = s.tail;
+    node.next = nullptr;
+    if (s.tail != nullptr) {
+        s.tail->next = &node;
+    } else {
+        s.head = &node;
+    }
+    s.tail = &node;
+}
+
+void EpochStripedLRU::remove_node(shard &s, std::atomic<epoch_node *> &link) {
+    epoch_node *node = link.load(std::memory_order_relaxed);
+    if (node->expire != 0) {
+        s.timers.remove(*node);
+    }
+    drop_node(s, link);
+}
+
+void EpochStripedLRU::drop_node(shard &s, std::atomic<epoch_node *> &link) {
+    epoch_node *node = link.load(std::memory_order_relaxed);
+    uint8_t index = s.table.load(std::memory_order_relaxed)->link;
+
+    // Readers standing on the node still see the rest of the chain
+    link.store(node->chain[index].load(std::memory_order_relaxed), std::memory_order_release);
+    unlink(s, *node);
+    s.space_left += EntrySize(node->key_size, node->value_size);
+    s.count--;
+    Concurrency::Epoch::Retire(node, &delete_node);
+}
+
+void EpochStripedLRU::expire_nodes(shard &s, int64_t now) {
+    if (now <= 0) {
+        return;
+    }
+
+    // Readers could still see the node, so its expire stays as is, and the node is dropped bypassing the wheel
+    s.timers.advance(now, [this, &s](epoch_node &node) {
+        drop_node(s, find_link(s, node.key(), node.key_size, node.hash));
+    });
+}
+
+void EpochStripedLRU::free_head(shard &s, epoch_node *keep) {
+    // Second chance: referenced entries go to the tail with bit cleared
+    while (s.head == keep || s.head->referenced.load(std::memory_order_relaxed)) {
+        epoch_node *node = s.head;
+        node->referenced.store(false, std::memory_order_relaxed);
+        unlink(s, *node);
+        link_tail(s, *node);
+    }
+    evicted(StringRef(s.head->key(), s.head->key_size));
+    remove_node(s, find_link(s, s.head->key(), s.head->key_size, s.head->hash));
+}
+
+void EpochStripedLRU::add_node(shard &s, StringRef key, const std::string &value, std::size_t hash,
+                               const Meta &meta) {
+    std::size_t size = EntrySize(key.size(), value.size());
+    while (size > s.space_left) {
+        free_head(s, nullptr);
+    }
+
+    epoch_node *node = new_node(key.data(), key.size(), value.data(), value.size(), hash);
+    node->version = ++s.versions;
+    node->flags = meta.flags;
+    node->expire = meta.expire;
+    epoch_table *table = s.table.load(std::memory_order_relaxed);
+    std::atomic<epoch_node *> &bucket = table->buckets[bucket_of(hash) & table->mask];
+    node->chain[table->link].store(bucket.load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+    // Publish fully initialized node
+    bucket.store(node, std::memory_order_release);
+    link_tail(s, *node);
+    if (node->expire != 0) {
+        s.timers.add(*node);
+    }
+    s.space_left -= size;
+    s.count++;
+
+    if (s.count > table->mask + 1) {
+        grow(s);
+    }
+}
+
+void EpochStripedLRU::set_node(shard &s, epoch_node &node, const std::string &value, const Meta &meta) {
+    std::size_t old_size = EntrySize(node.key_size, node.value_size);
+    std::size_t new_size = EntrySize(node.key_size, value.size());
+    while (new_size > s.space_left + old_size) {
+        free_head(s, &node);
+    }
+
+    // Eviction could have changed the chain, so link is looked up only now
+    epoch_node *fresh = new_node(node.key(), node.key_size, value.data(), value.size(), node.hash);
+    fresh->version = ++s.versions;
+    fresh->flags = meta.flags;
+    fresh->expire = meta.expire;
+    std::atomic<epoch_node *> &link = find_link(s, node.key(), node.key_size, node.hash);
+    uint8_t index = s.table.load(std::memory_order_relaxed)->link;
+    fresh->chain[index].store(node.chain[index].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    fresh->referenced.store(true, std::memory_order_relaxed);
+    link.store(fresh, std::memory_order_release);
+
+    unlink(s, node);
+    link_tail(s, *fresh);
+    if (node.expire != 0) {
+        s.timers.remove(node);
+    }
+    if (fresh->expire != 0) {
+        s.timers.add(*fresh);
+    }
+    s.space_left = s.space_left + old_size - new_size;
+    Concurrency::Epoch::Retire(&node, &delete_node);
+}
+
+void EpochStripedLRU::grow(shard &s) {
+    epoch_table *old_table = s.table.load(std::memory_order_relaxed);
+    epoch_table *new_table = new epoch_table(2 * (old_table->mask + 1), old_table->link ^ 1);
+
+    // Readers of the old table follow the other link of each node, so they don't see chains being rebuilt
+    for (epoch_node *node = s.head; node != nullptr; node = node->next) {
+        std::atomic<epoch_node *> &bucket = new_table->buckets[bucket_of(node->hash) & new_table->mask];
+        node->chain[new_table->link].store(bucket.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        bucket.store(node, std::memory_order_relaxed);
+    }
+    s.table.store(new_table, std::memory_order_release);
+
+    // Links of the old table get reused by the next growth, so wait for all its readers to leave. Growth is
+    // rare and Get is short, so that is cheap enough to do under the shard lock
+    Concurrency::Epoch::Synchronize();
+    delete old_table;
+}
+
+// See MapBasedGlobalLockImpl.h
+bool EpochStripedLRU::Put(const std::string &key, const std::string &value) { return Put(key, value, Meta()); }
+
+// See MapBasedGlobalLockImpl.h
+bool EpochStripedLRU::Put(const std::string &key, const std::string &value, const Meta &meta) {
+    return Put(StringRef(key), value, meta);
+}
+
+// See MapBasedGlobalLockImpl.h
+bool EpochStripedLRU::Put(StringRef key, const std::string &value, const Meta &meta) {
+    if (EntrySize(key.size(), value.size()) > _shard_size) {
+        return false;
+    }
+
+    std::size_t hash = HashKey(key);
+    shard &s = shard_of(hash);
+    std::unique_lock<std::mutex> lock(s.mutex);
+    std::atomic<epoch_node *> &link = find_live_link(s, key, hash);
+    epoch_node *node = link.load(std::memory_order_relaxed);
+    if (meta.expired(now())) {
+        if (node != nullptr) {
+            remove_node(s, link);
+        }
+    } else if (node != nullptr) {
+        set_node(s, *node, value, meta);
+    } else {
+        add_node(s, key, value, hash, meta);
+    }
+    return true;
+}
+
+// See MapBasedGlobalLockImpl.h
+bool EpochStripedLRU::PutIfAbsent(const std::string &key, const std::string &value) {
+    return PutIfAbsent(key, value, Meta());
+}
+
+// See MapBasedGlobalLockImpl.h
+bool EpochStripedLRU::PutIfAbsent(const std::string &key, const std::string &value, const Meta &meta) {
+    return PutIfAbsent(StringRef(key), value, meta);
+}
+
+// See MapBasedGlobalLockImpl.h
+bool EpochStripedLRU::PutIfAbsent(StringRef key, const std::string &value, const Meta &meta) {
+    if (EntrySize(key.size(), value.size()) > _shard_size) {
+        return false;
+    }
+
+    std::size_t hash = HashKey(key);
+    shard &s = shard_of(hash);
+    std::unique_lock<std::mutex> lock(s.mutex);
+    if (find_live_link(s, key, hash).load(std::memory_order_relaxed) != nullptr) {
+        return false;
+    }
+    if (!meta.expired(now())) {
+        add_node(s, key, value, hash, meta);
+    }
+    return true;
+}
+
+// See MapBasedGlobalLockImpl.h
+bool EpochStripedLRU::Set(const std::string &key, const std::string &value) { return Set(key, value, Meta()); }
+
+// See MapBasedGlobalLockImpl.h
+bool EpochStripedLRU::Set(const std::string &key, const std::string &value, const Meta &meta) {
+    return Set(StringRef(key), value, meta);
+}
+
+// See MapBasedGlobalLockImpl.h
+bool EpochStripedLRU::Set(StringRef key, const std::string &value, const Meta &meta) {
+    if (EntrySize(key.size(), value.size()) > _shard_size) {
+        return false;
+    }
+
+    std::size_t hash = HashKey(key);
+    shard &s = shard_of(hash);
+    std::unique_lock<std::mutex> lock(s.mutex);
+    std::atomic<epoch_node *> &link = find_live_link(s, key, hash);
+    epoch_node *node = link.load(std::memory_order_relaxed);
+    if (node == nullptr) {
+        return false;
+    }
+    if (meta.expired(now())) {
+        remove_node(s, link);
+    } else {
+        set_node(s, *node, value, meta);
+    }
+    return true;
+}
+
+bool EpochStripedLRU::join(const std::string &key, const std::string &data, bool front) {
+    std::size_t hash = HashKey(key);
+    shard &s = shard_of(hash);
+    std::unique_lock<std::mutex> lock(s.mutex);
+    epoch_node *node = find_live_link(s, key, hash).load(std::memory_order_relaxed);
+    if (node == nullptr || EntrySize(key.size(), node->value_size + data.size()) > _shard_size) {
+        return false;
+    }
+
+    // Readers may stand on the node, so new value always goes to a new one
+    std::string value;
+    value.reserve(node->value_size + data.size());
+    if (front) {
+        value.append(data).append(node->value(), node->value_size);
+    } else {
+        value.append(node->value(), node->value_size).append(data);
+    }
+    set_node(s, *node, value, meta_of(*node));
+    return true;
+}
+
+// See MapBasedGlobalLockImpl.h
+bool EpochStripedLRU::Append(const std::string &key, const std::string &data) { return join(key, data, false); }
+
+// See MapBasedGlobalLockImpl.h
+bool EpochStripedLRU::Prepend(const std::string &key, const std::string &data) { return join(key, data, true); }
+
+EpochStripedLRU::CounterStatus EpochStripedLRU::update_node(const std::string &key, uint64_t delta, bool decrement,
+                                                            uint64_t &value) {
+    std::size_t hash = HashKey(key);
+    shard &s = shard_of(hash);
+    std::unique_lock<std::mutex> lock(s.mutex);
+    epoch_node *node = find_live_link(s, key, hash).load(std::memory_order_relaxed);
+    if (node == nullptr) {
+        return CounterStatus::kNotFound;
+    }
+    if (!parse_counter(node->value(), node->value_size, value)) {
+        return CounterStatus::kNotNumber;
+    }
+    value = count(value, delta, decrement);
+    set_node(s, *node, std::to_string(value), meta_of(*node));
+    return CounterStatus::kUpdated;
+}
+
+// See MapBasedGlobalLockImpl.h
+EpochStripedLRU::CounterStatus EpochStripedLRU::Increment(const std::string &key, uint64_t delta, uint64_t &value) {
+    return update_node(key, delta, false, value);
+}
+
+// See MapBasedGlobalLockImpl.h
+EpochStripedLRU::CounterStatus EpochStripedLRU::Decrement(const std::string &key, uint64_t delta, uint64_t &value) {
+    return update_node(key, delta, true, value);
+}
+
+// See MapBasedGlobalLockImpl.h
+EpochStripedLRU::CasStatus EpochStripedLRU::CompareAndSet(const std::string &key, const std::string &value,
+                                                          const Meta &meta, uint64_t version) {
+    if (EntrySize(key.size(), value.size()) > _shard_size) {
+        return CasStatus::kNotStored;
+    }
+
+    std::size_t hash = HashKey(key);
+    shard &s = shard_of(hash);
+    std::unique_lock<std::mutex> lock(s.mutex);
+    std::atomic<epoch_node *> &link = find_live_link(s, key, hash);
+    epoch_node *node = link.load(std::memory_order_relaxed);
+    if (node == nullptr) {
+        return CasStatus::kNotFound;
+    }
+    if (node->version != version) {
+        return CasStatus::kExists;
+    }
+    if (meta.expired(now())) {
+        remove_node(s, link);
+    } else {
+        set_node(s, *node, value, meta);
+    }
+    return CasStatus::kStored;
+}
+
+// See MapBasedGlobalLockImpl.h
+bool EpochStripedLRU::Delete(const std::string &key) {
+    std::size_t hash = HashKey(key);
+    shard &s = shard_of(hash);
+    std::unique_lock<std::mutex> lock(s.mutex);
+    std::atomic<epoch_node *> &link = find_live_link(s, key, hash);
+    if (link.load(std::memory_order_relaxed) == nullptr) {
+        return false;
+    }
+    remove_node(s, link);
+    return true;
+}
+
+EpochStripedLRU::epoch_node *EpochStripedLRU::get_node(StringRef key) const {
+    std::size_t hash = HashKey(key);
+    shard &s = shard_of(hash);
+
+    epoch_table *table = s.table.load(std::memory_order_acquire);
+    epoch_node *node = table->buckets[bucket_of(hash) & table->mask].load(std::memory_order_acquire);
+    while (node != nullptr) {
+        if (node->hash == hash && node->key_size == key.size() &&
+            std::memcmp(node->key(), key.data(), key.size()) == 0) {
+            if (node->expire != 0 && node->expire <= now()) {
+                // Expired node is removed by the next modification of the key
+                return nullptr;
+            }
+            if (!node->referenced.load(std::memory_order_relaxed)) {
+                // Avoid cache line invalidation if bit is already set
+                node->referenced.store(true, std::memory_order_relaxed);
+            }
+            return node;
+        }
+        node = node->chain[table->link].load(std::memory_order_acquire);
+    }
+    return nullptr;
+}
+
+// See MapBasedGlobalLockImpl.h
+bool EpochStripedLRU::Get(const std::string &key, std::string &value) {
+    Concurrency::Epoch::Guard guard;
+    epoch_node *node = get_node(key);
+    if (node == nullptr) {
+        return false;
+    }
+    value.assign(node->value(), node->value_size);
+    return true;
+}
+
+// See MapBasedGlobalLockImpl.h
+bool EpochStripedLRU::Get(const std::string &key, ValueRef &value) {
+    Concurrency::Epoch::Guard guard;
+    epoch_node *node = get_node(key);
+    if (node == nullptr) {
+        return false;
+    }
+
+    // Node can't be released by storage before guard is left, so reference taken here keeps it
+    node->refs.fetch_add(1, std::memory_order_relaxed);
+    value = ValueRef(node->value(), node->value_size, node, &delete_node);
+    return true;
+}
+
+// See MapBasedGlobalLockImpl.h
+std::size_t EpochStripedLRU::MultiGet(const std::vector<StringRef> &keys, std::vector<ValueRef> &values,
+                                      std::vector<Meta> *metas, bool versions) {
+    values.resize(keys.size());
+    if (metas != nullptr) {
+        metas->assign(keys.size(), Meta());
+    }
+
+    Concurrency::Epoch::Guard guard;
+    std::size_t found = 0;
+    for (std::size_t i = 0; i < keys.size(); i++) {
+        values[i].reset();
+        epoch_node *node = get_node(keys[i]);
+        if (node != nullptr) {
+            node->refs.fetch_add(1, std::memory_order_relaxed);
+            values[i] = ValueRef(node->value(), node->value_size, node, &delete_node);
+            if (metas != nullptr) {
+                (*metas)[i] = meta_of(*node);
+            }
+            found++;
+        }
+    }
+    return found;
+}
+
+// See MapBasedGlobalLockImpl.h
+bool EpochStripedLRU::Export(const std::function<void(Item &item)> &visit) {
+    std::vector<Item> items;
+    for (std::unique_ptr<shard> &s : _shards) {
+        {
+            // Nodes are immutable, so pinning them is all that has to be done under the lock
+            std::unique_lock<std::mutex> lock(s->mutex);
+            int64_t moment = now();
+            for (epoch_node *node = s->head; node != nullptr; node = node->next) {
+                Meta meta = meta_of(*node);
+                if (meta.expired(moment)) {
+                    continue;
+                }
+                node->refs.fetch_add(1, std::memory_order_relaxed);
+                items.emplace_back(std::string(node->key(), node->key_size),
+                                   ValueRef(node->value(), node->value_size, node, &delete_node), meta);
+            }
+        }
+        for (Item &item : items) {
+            visit(item);
+        }
+        items.clear();
+    }
+    return true;
+}
+
+// See MapBasedGlobalLockImpl.h
+uint64_t EpochStripedLRU::Scan(uint64_t cursor, std::size_t count, std::vector<std::string> &keys) {
+    std::size_t number = cursor >> kShardShift;
+    uint64_t bucket = cursor & ((uint64_t(1) << kShardShift) - 1);
+    if (number >= _shards.size()) {
+        return 0;
+    }
+
+    int64_t moment = now();
+    std::size_t batch = std::max<std::size_t>(count, 1);
+    std::size_t wanted = keys.size() + batch;
+    for (std::size_t buckets = 0; buckets < batch && keys.size() < wanted; buckets++) {
+        // Table could be replaced between buckets, cursor stays valid for any of them as tables only grow
+        Concurrency::Epoch::Guard guard;
+        const epoch_table *table = _shards[number]->table.load(std::memory_order_acquire);
+        uint64_t mask = table->mask;
+        epoch_node *node = table->buckets[bucket & mask].load(std::memory_order_acquire);
+        for (; node != nullptr; node = node->chain[table->link].load(std::memory_order_acquire)) {
+            if (node->expire == 0 || node->expire > moment) {
+                keys.emplace_back(node->key(), node->key_size);
+            }
+        }
+
+        // Increment of the reversed bucket number, bits above the mask carry over and vanish
+        bucket = reverse_bits(reverse_bits(bucket | ~mask) + 1);
+        if (bucket == 0 && ++number == _shards.size()) {
+            return 0;
+        }
+    }
+    return (uint64_t(number) << kShardShift) | bucket;
+}
+
+} // namespace Backend
+} // namespace Afina
@@ -0,0 +1,258 @@
+#ifndef AFINA_STORAGE_EPOCH_STRIPED_LRU_H
+#define AFINA_STORAGE_EPOCH_STRIPED_LRU_H
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <afina/Storage.h>
+
+#include "TimerWheel.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Striped LRU with lock free reads
+ * Thread safe implementation. Storage is split in shards by key hash just like StripedLockLRU, but only
+ * modifications take shard mutex: Get is wait-free and never writes anything shared except the reference bit
+ * of the entry found.
+ *
+ * Each shard keeps entries in a chained hash table published through an atomic pointer. Entries are immutable
+ * once linked into the table: update links new entry in place of the old one, and removed entries are handed
+ * to Concurrency::Epoch, which frees them once no reader could still reference them. Table grows by building
+ * new chains over the second pair of entry links and publishing the new table, so readers of the old one are
+ * never disturbed. Eviction is CLOCK, see SimpleLRU::Eviction::kClock, as readers can't reorder the list.
+ *
+ * Entries that expire are tracked by a TimerWheel per shard, which modifications advance under the shard mutex:
+ * expired entry is dropped and its bytes are released once its time comes, not once the key is touched again.
+ * Get only treats expired entry as absent.
+ *
+ * Retired node is released rather than freed: ValueRef returned by Get holds its own reference to the node, so
+ * the value could outlive both the grace period and the storage.
+ */
+class EpochStripedLRU : public Afina::Storage {
+public:
+    EpochStripedLRU(size_t shard_size = 1 << 20, size_t num_shards = 4);
+    ~EpochStripedLRU();
+
+    // Implements Afina::Storage interface
+    bool Put(const std::string &key, const std::string &value) override;
+
+    // Implements Afina::Storage interface
+    bool Put(const std::string &key, const std::string &value, const Meta &meta) override;
+
+    // Implements Afina::Storage interface
+    bool Put(StringRef key, const std::string &value, const Meta &meta) override;
+
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(const std::string &key, const std::string &value) override;
+
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(const std::string &key, const std::string &value, const Meta &meta) override;
+
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(StringRef key, const std::string &value, const Meta &meta) override;
+
+    // Implements Afina::Storage interface
+    bool Set(const std::string &key, const std::string &value) override;
+
+    // Implements Afina::Storage interface
+    bool Set(const std::string &key, const std::string &value, const Meta &meta) override;
+
+    // Implements Afina::Storage interface
+    bool Set(StringRef key, const std::string &value, const Meta &meta) override;
+
+    // Implements Afina::Storage interface
+    bool Append(const std::string &key, const std::string &data) override;
+
+    // Implements Afina::Storage interface
+    bool Prepend(const std::string &key, const std::string &data) override;
+
+    // Implements Afina::Storage interface
+    CounterStatus Increment(const std::string &key, uint64_t delta, uint64_t &value) override;
+
+    // Implements Afina::Storage interface
+    CounterStatus Decrement(const std::string &key, uint64_t delta, uint64_t &value) override;
+
+    // Implements Afina::Storage interface
+    CasStatus CompareAndSet(const std::string &key, const std::string &value, const Meta &meta,
+                            uint64_t version) override;
+
+    // Implements Afina::Storage interface
+    bool Delete(const std::string &key) override;
+
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, std::string &value) override;
+
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, ValueRef &value) override;
+
+    // MultiGet of std::string keys is the default one
+    using Afina::Storage::MultiGet;
+
+    // Implements Afina::Storage interface
+    std::size_t MultiGet(const std::vector<StringRef> &keys, std::vector<ValueRef> &values,
+                         std::vector<Meta> *metas, bool versions) override;
+
+    // Implements Afina::Storage interface, shards are visited one by one
+    bool Export(const std::function<void(Item &item)> &visit) override;
+
+    // Implements Afina::Storage interface. Shards are scanned one after another without any lock, the same way Get
+    // reads them. Cursor keeps shard number above kShardShift and the bucket number in reverse binary order below,
+    // see HashIndex::scan, so table growth between batches neither skips nor repeats keys
+    uint64_t Scan(uint64_t cursor, std::size_t count, std::vector<std::string> &keys) override;
+
+    /**
+     * Number of bytes of the shard budget single entry with given key and value sizes occupies
+     */
+    static std::size_t EntrySize(std::size_t key_size, std::size_t value_size);
+
+protected:
+    // Current unix time, see Meta::expire
+    virtual int64_t now() const { return std::time(nullptr); }
+
+private:
+    // Position of the shard number in the scan cursor
+    static constexpr int kShardShift = 48;
+
+    // Storage entry, header followed by key bytes and then by value bytes in the same memory block
+    struct epoch_node {
+        // Next entry in the hash table chain, one link per table generation
+        std::atomic<epoch_node *> chain[2];
+
+        // Eviction list, guarded by shard mutex
+        epoch_node *prev;
+        epoch_node *next;
+
+        // Links of the expiration timer wheel, used only if node expires. Guarded by shard mutex as well
+        epoch_node *timer_prev;
+        epoch_node *timer_next;
+        uint8_t timer_slot;
+
+        std::size_t hash;
+        uint32_t key_size;
+        uint32_t value_size;
+
+        // Changes along with the value, see Meta::version. Immutable as the rest of the node
+        uint64_t version;
+
+        // Opaque client flags, see Meta::flags
+        uint32_t flags;
+
+        // See Meta::expire
+        int64_t expire;
+
+        // Number of references: one of the storage, while node is in it or retired, and one per ValueRef
+        std::atomic<uint32_t> refs;
+
+        // Was there any Get of the entry since eviction has passed over it last time
+        std::atomic<bool> referenced;
+
+        char *key() { return reinterpret_cast<char *>(this + 1); }
+        const char *key() const { return reinterpret_cast<const char *>(this + 1); }
+
+        char *value() { return key() + key_size; }
+        const char *value() const { return key() + key_size; }
+    };
+
+    // Hash table generation
+    struct epoch_table {
+        epoch_table(std::size_t size, uint8_t link_)
+            : mask(size - 1), link(link_), buckets(new std::atomic<epoch_node *>[size]()) {}
+
+        std::size_t mask;
+
+        // Index of epoch_node::chain used by this generation
+        uint8_t link;
+
+        std::unique_ptr<std::atomic<epoch_node *>[]> buckets;
+    };
+
+    struct shard {
+        shard(std::size_t max_size);
+
+        // Current table, replaced only under mutex
+        std::atomic<epoch_table *> table;
+
+        // Guards everything below and any modification of the table
+        std::mutex mutex;
+
+        std::size_t space_left;
+        std::size_t count;
+
+        // Last version assigned to a node
+        uint64_t versions;
+
+        // Eviction list in order of insertion, owns all nodes
+        epoch_node *head;
+        epoch_node *tail;
+
+        // Expiration times of nodes that expire
+        TimerWheel<epoch_node> timers;
+    };
+
+    static epoch_node *new_node(const char *key, std::size_t key_size, const char *value, std::size_t value_size,
+                                std::size_t hash);
+
+    // Drops one reference to the node, frees it once there are no references left
+    static void delete_node(void *node);
+
+    shard &shard_of(std::size_t hash) const { return *_shards[hash % _shards.size()]; }
+    std::size_t bucket_of(std::size_t hash) const { return hash / _shards.size(); }
+
+    // Link pointing to the node with the given key in the current table, or the terminating link of the chain
+    std::atomic<epoch_node *> &find_link(shard &s, const char *key, std::size_t key_size, std::size_t hash) const;
+
+    // Same as find_link, but node that has expired is removed first, so the link never points to one
+    std::atomic<epoch_node *> &find_live_link(shard &s, StringRef key, std::size_t hash);
+
+    void unlink(shard &s, epoch_node &node);
+    void link_tail(shard &s, epoch_node &node);
+
+    // Unlinks node from the table and the list and retires it
+    void remove_node(shard &s, std::atomic<epoch_node *> &link);
+
+    // Same as remove_node, but node is out of the timer wheel already
+    void drop_node(shard &s, std::atomic<epoch_node *> &link);
+
+    // Drops nodes of the shard expired by the given moment
+    void expire_nodes(shard &s, int64_t now);
+
+    // Evicts one node, other than keep
+    void free_head(shard &s, epoch_node *keep);
+
+    // Puts new node into the shard, key must be absent
+    void add_node(shard &s, StringRef key, const std::string &value, std::size_t hash, const Meta &meta);
+
+    // Replaces node with a new one having given value and attributes
+    void set_node(shard &s, epoch_node &node, const std::string &value, const Meta &meta);
+
+    // Attributes of the node, see Meta
+    static Meta meta_of(const epoch_node &node);
+
+    // Adds data to the value of the existing key, at the beginning if front is set or at the end otherwise
+    bool join(const std::string &key, const std::string &data, bool front);
+
+    // Updates counter of the existing key, see Increment
+    CounterStatus update_node(const std::string &key, uint64_t delta, bool decrement, uint64_t &value);
+
+    // Doubles the table of a shard
+    void grow(shard &s);
+
+    // Looks node up without any lock, must be called inside Concurrency::Epoch::Guard
+    epoch_node *get_node(StringRef key) const;
+
+    std::size_t _shard_size;
+    std::vector<std::unique_ptr<shard>> _shards;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_EPOCH_STRIPED_LRU_H
@@ -0,0 +1,110 @@
+#ifndef AFINA_STORAGE_FREQUENCY_SKETCH_H
+#define AFINA_STORAGE_FREQUENCY_SKETCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Count-min sketch of access frequencies
+ * Approximate popularity of keys over recent history. Four rows of 4-bit saturating counters packed 16 per
+ * 64-bit word. Estimation of the key is the minimum of its counters over all rows, so it could overestimate
+ * because of collisions but never underestimates.
+ *
+ * Aging: once number of increments reaches 10x number of counters in a row all counters get halved, so
+ * frequencies reflect recent history and formerly popular keys fade away.
+ */
+class FrequencySketch {
+public:
+    /**
+     * @param expected_entries approximate number of distinct keys to track
+     */
+    FrequencySketch(std::size_t expected_entries) : _additions(0) {
+        std::size_t width = 64;
+        while (width < expected_entries) {
+            width <<= 1;
+        }
+        _mask = width - 1;
+        _sample_size = 10 * width;
+        _table.assign(kDepth * width / kCountersPerWord, 0);
+    }
+
+    /**
+     * Estimated number of occurrences of the given hash, in range [0, 15]
+     */
+    uint32_t frequency(std::size_t hash) const {
+        uint32_t result = kMaxCount;
+        for (std::size_t row = 0; row < kDepth; row++) {
+            uint32_t count = counter(row, hash);
+            if (count < result) {
+                result = count;
+            }
+        }
+        return result;
+    }
+
+    /**
+     * Register one more occurrence of the given hash
+     */
+    void increment(std::size_t hash) {
+        bool added = false;
+        for (std::size_t row = 0; row < kDepth; row++) {
+            std::size_t index = this->index(row, hash);
+            uint64_t &word = _table[index / kCountersPerWord];
+            std::size_t shift = (index % kCountersPerWord) * 4;
+            if (((word >> shift) & kMaxCount) != kMaxCount) {
+                word += uint64_t(1) << shift;
+                added = true;
+            }
+        }
+
+        if (added && ++_additions >= _sample_size) {
+            reset();
+        }
+    }
+
+private:
+    static constexpr std::size_t kDepth = 4;
+    static constexpr std::size_t kCountersPerWord = 16;
+    static constexpr uint32_t kMaxCount = 15;
+
+    // Halve all counters: shift whole word and drop bits that crossed counter borders
+    void reset() {
+        for (auto &word : _table) {
+            word = (word >> 1) & 0x7777777777777777ULL;
+        }
+        _additions /= 2;
+    }
+
+    // Each row uses its own derivative of the hash
+    std::size_t index(std::size_t row, std::size_t hash) const {
+        static const uint64_t seeds[kDepth] = {0xc3a5c85c97cb3127ULL, 0xb492b66fbe98f273ULL, 0x9ae16a3b2f90404fULL,
+                                               0xcbf29ce484222325ULL};
+        uint64_t h = (uint64_t(hash) + seeds[row]) * seeds[row];
+        h ^= h >> 32;
+        return row * (_mask + 1) + (h & _mask);
+    }
+
+    uint32_t counter(std::size_t row, std::size_t hash) const {
+        std::size_t index = this->index(row, hash);
+        return (_table[index / kCountersPerWord] >> ((index % kCountersPerWord) * 4)) & kMaxCount;
+    }
+
+    // Number of counters in a row minus one, row width is power of 2
+    std::size_t _mask;
+
+    // Number of increments since last reset and limit when next reset happens
+    std::size_t _additions;
+    std::size_t _sample_size;
+
+    // All rows one after another
+    std::vector<uint64_t> _table;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_FREQUENCY_SKETCH_H
@@ -0,0 +1,311 @@
+#ifndef AFINA_STORAGE_HASH_INDEX_H
+#define AFINA_STORAGE_HASH_INDEX_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Open addressing hash index
+ * Swiss-table like index of pointers to externally owned elements. Index doesn't own nor copy keys: element
+ * must expose public `std::size_t hash` field and lookups are done by hash plus caller provided equality
+ * predicate.
+ *
+ * Slots are split in groups of 16. For each slot there is one control byte that is either a special marker
+ * (empty, deleted) or 7 low bits of the element hash. Lookup compares all 16 control bytes of a group at once
+ * (SSE2 if available) and only touches elements with matching fingerprint. Groups are probed in triangular
+ * order starting from the "home" group selected by low bits of hash >> 7.
+ */
+template <typename T> class HashIndex {
+public:
+    HashIndex() : _groups(0), _size(0), _used(0) {}
+    ~HashIndex() {}
+
+    // Number of elements in the index
+    std::size_t size() const { return _size; }
+
+    // Number of slots allocated
+    std::size_t capacity() const { return _groups * kGroupWidth; }
+
+    /**
+     * Returns element with the given hash for which eq(element) holds or nullptr if there is no such
+     */
+    template <typename Eq> T *find(std::size_t hash, Eq eq) const {
+        if (_groups == 0) {
+            return nullptr;
+        }
+
+        const int8_t h2 = fingerprint(hash);
+        std::size_t group = home(hash);
+        for (std::size_t step = 1; step <= _groups; step++) {
+            Group g(&_ctrl[group * kGroupWidth]);
+            for (uint32_t match = g.match(h2); match != 0; match &= match - 1) {
+                T *candidate = _slots[group * kGroupWidth + lowest_bit(match)];
+                if (eq(*candidate)) {
+                    return candidate;
+                }
+            }
+
+            if (g.match_empty() != 0) {
+                return nullptr;
+            }
+            group = (group + step) & (_groups - 1);
+        }
+        return nullptr;
+    }
+
+    /**
+     * Hint CPU that lookup of the given hash is coming soon
+     */
+    void prefetch(std::size_t hash) const {
+        if (_groups != 0) {
+            __builtin_prefetch(&_ctrl[home(hash) * kGroupWidth]);
+        }
+    }
+
+    /**
+     * Adds element into index. Caller must guarantee that there is no equal element in the index yet
+     */
+    void insert(T *value) {
+        if ((_used + 1) * 8 > capacity() * 7) {
+            // Rehash in place if most of used slots are tombstones, grow otherwise
+            rehash((_size + 1) * 16 > capacity() * 7 ? std::max<std::size_t>(1, _groups * 2) : _groups);
+        }
+
+        std::size_t slot = find_free(value->hash);
+        if (_ctrl[slot] == kEmpty) {
+            _used++;
+        }
+        _ctrl[slot] = fingerprint(value->hash);
+        _slots[slot] = value;
+        _size++;
+    }
+
+    /**
+     * Removes given element from index. Returns false if element wasn't found
+     */
+    bool erase(const T *value) {
+        std::size_t slot;
+        if (!locate(value, slot)) {
+            return false;
+        }
+
+        // If there is an empty slot in the group then no probe sequence has passed through it, so slot could be
+        // made empty, otherwise tombstone is required to keep probe chains intact
+        std::size_t group = slot / kGroupWidth;
+        if (Group(&_ctrl[group * kGroupWidth]).match_empty() != 0) {
+            _ctrl[slot] = kEmpty;
+            _used--;
+        } else {
+            _ctrl[slot] = kDeleted;
+        }
+        _slots[slot] = nullptr;
+        _size--;
+        return true;
+    }
+
+    /**
+     * Visits elements of the home group cursor points to and returns cursor of the next home group, 0 once all
+     * groups are visited. Elements of the group are found along its probe sequence, so they are visited wherever
+     * they have been placed. Cursor goes over group numbers in reverse binary order: once index of n groups
+     * grows, group i splits into groups i and i + n, which either both have been visited already or both have
+     * not. So element present during the whole iteration is visited exactly once whatever the index does between
+     * calls, as index never shrinks
+     */
+    template <typename Visit> std::size_t scan(std::size_t cursor, Visit visit) const {
+        if (_groups == 0) {
+            return 0;
+        }
+
+        std::size_t mask = _groups - 1;
+        std::size_t home_group = cursor & mask;
+        std::size_t group = home_group;
+        for (std::size_t step = 1; step <= _groups; step++) {
+            Group g(&_ctrl[group * kGroupWidth]);
+            for (uint32_t full = ~g.match_free() & 0xFFFF; full != 0; full &= full - 1) {
+                const T *element = _slots[group * kGroupWidth + lowest_bit(full)];
+                if (home(element->hash) == home_group) {
+                    visit(*element);
+                }
+            }
+
+            if (g.match_empty() != 0) {
+                break;
+            }
+            group = (group + step) & mask;
+        }
+
+        // Increment of the reversed group number, bits above the mask carry over and vanish
+        cursor = reverse_bits(reverse_bits(cursor | ~mask) + 1);
+        return cursor;
+    }
+
+    /**
+     * Drops all elements, keeping allocated memory
+     */
+    void clear() {
+        if (_groups != 0) {
+            std::memset(_ctrl.get(), kEmpty, capacity());
+            std::memset(_slots.get(), 0, capacity() * sizeof(T *));
+        }
+        _size = 0;
+        _used = 0;
+    }
+
+    /**
+     * Number of bytes index uses per element slot
+     */
+    static constexpr std::size_t slot_size() { return sizeof(T *) + sizeof(int8_t); }
+
+private:
+    static constexpr std::size_t kGroupWidth = 16;
+    static constexpr int8_t kEmpty = -128;
+    static constexpr int8_t kDeleted = -2;
+
+    /**
+     * Bit masks of 16 control bytes, bit i set if i-th byte matches
+     */
+    class Group {
+    public:
+        explicit Group(const int8_t *ctrl) : _ctrl(ctrl) {}
+
+#ifdef __SSE2__
+        uint32_t match(int8_t h2) const {
+            __m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i *>(_ctrl));
+            return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl)));
+        }
+
+        uint32_t match_empty() const { return match(kEmpty); }
+
+        // Both kEmpty and kDeleted have the sign bit set, fingerprints don't
+        uint32_t match_free() const {
+            __m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i *>(_ctrl));
+            return static_cast<uint32_t>(_mm_movemask_epi8(ctrl));
+        }
+#else
+        uint32_t match(int8_t h2) const {
+            uint32_t result = 0;
+            for (std::size_t i = 0; i < kGroupWidth; i++) {
+                result |= uint32_t(_ctrl[i] == h2) << i;
+            }
+            return result;
+        }
+
+        uint32_t match_empty() const { return match(kEmpty); }
+
+        uint32_t match_free() const {
+            uint32_t result = 0;
+            for (std::size_t i = 0; i < kGroupWidth; i++) {
+                result |= uint32_t(_ctrl[i] < 0) << i;
+            }
+            return result;
+        }
+#endif
+
+    private:
+        const int8_t *_ctrl;
+    };
+
+    static int8_t fingerprint(std::size_t hash) { return static_cast<int8_t>(hash & 0x7F); }
+
+    static std::size_t lowest_bit(uint32_t mask) { return __builtin_ctz(mask); }
+
+    static std::size_t reverse_bits(std::size_t value) {
+        std::size_t result = 0;
+        for (std::size_t i = 0; i < sizeof(value) * 8; i++) {
+            result = (result << 1) | (value & 1);
+            value >>= 1;
+        }
+        return result;
+    }
+
+    std::size_t home(std::size_t hash) const { return (hash >> 7) & (_groups - 1); }
+
+    // Finds first empty or deleted slot in the probe sequence of the given hash
+    std::size_t find_free(std::size_t hash) const {
+        std::size_t group = home(hash);
+        for (std::size_t step = 1;; step++) {
+            uint32_t match = Group(&_ctrl[group * kGroupWidth]).match_free();
+            if (match != 0) {
+                return group * kGroupWidth + lowest_bit(match);
+            }
+            group = (group + step) & (_groups - 1);
+        }
+    }
+
+    // Finds slot holding exactly the given element
+    bool locate(const T *value, std::size_t &slot) const {
+        if (_groups == 0) {
+            return false;
+        }
+
+        const int8_t h2 = fingerprint(value->hash);
+        std::size_t group = home(value->hash);
+        for (std::size_t step = 1; step <= _groups; step++) {
+            Group g(&_ctrl[group * kGroupWidth]);
+            for (uint32_t match = g.match(h2); match != 0; match &= match - 1) {
+                std::size_t candidate = group * kGroupWidth + lowest_bit(match);
+                if (_slots[candidate] == value) {
+                    slot = candidate;
+                    return true;
+                }
+            }
+
+            if (g.match_empty() != 0) {
+                return false;
+            }
+            group = (group + step) & (_groups - 1);
+        }
+        return false;
+    }
+
+    void rehash(std::size_t groups) {
+        std::unique_ptr<int8_t[]> old_ctrl(std::move(_ctrl));
+        std::unique_ptr<T *[]> old_slots(std::move(_slots));
+        std::size_t old_capacity = capacity();
+
+        _groups = groups;
+        _ctrl.reset(new int8_t[capacity()]);
+        _slots.reset(new T *[capacity()]);
+        clear();
+
+        for (std::size_t i = 0; i < old_capacity; i++) {
+            if (old_ctrl[i] >= 0) {
+                std::size_t slot = find_free(old_slots[i]->hash);
+                _ctrl[slot] = old_ctrl[i];
+                _slots[slot] = old_slots[i];
+                _size++;
+                _used++;
+            }
+        }
+    }
+
+    // Number of groups, always power of 2 (or zero until first insert)
+    std::size_t _groups;
+
+    // Number of elements in index
+    std::size_t _size;
+
+    // Number of non-empty slots: elements plus tombstones
+    std::size_t _used;
+
+    // Control bytes, one per slot
+    std::unique_ptr<int8_t[]> _ctrl;
+
+    // Pointers to the elements
+    std::unique_ptr<T *[]> _slots;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_HASH_INDEX_H
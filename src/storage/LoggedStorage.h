@@ -0,0 +1,227 @@
+#ifndef AFINA_STORAGE_LOGGED_STORAGE_H
+#define AFINA_STORAGE_LOGGED_STORAGE_H
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <afina/Storage.h>
+
+#include "KeyHash.h"
+#include "OperationLog.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Storage with modifications written ahead to the OperationLog
+ * Wraps any thread safe storage. Every successful modification enqueues its record, reads go straight to the
+ * wrapped storage. Start replays the log into the storage and compacts it, so storage state survives restart up
+ * to the last sync of the log, see OperationLog.
+ *
+ * Records carry outcomes where they are known: whatever stores the given value is logged as Put of it, so replay
+ * doesn't depend on the key being present or absent at the moment. Evictions are logged as deletes, so keys
+ * storage has dropped by itself don't come back on replay.
+ *
+ * Modification and its enqueue are done under the lock of the key stripe, so records of the same key get into
+ * the log in the order storage has applied them. Modifications of different stripes don't wait for each other.
+ */
+class LoggedStorage : public Afina::Storage {
+public:
+    /**
+     * @param storage to be wrapped
+     * @param path of the log file
+     * @param sync_interval see OperationLog
+     */
+    LoggedStorage(std::shared_ptr<Afina::Storage> storage, const std::string &path,
+                  std::chrono::milliseconds sync_interval)
+        : _storage(storage), _log(path, sync_interval) {}
+
+    ~LoggedStorage() {}
+
+    // see OperationLog.h, storage is recovered from the log before anything else
+    void Start() override {
+        _storage->Start();
+        _log.Recover(*_storage);
+        _storage->SetEvictionListener([this](StringRef key) {
+            _log.Write(OperationLog::Op::kDelete, key, StringRef(nullptr, 0), Meta());
+            evicted(key);
+        });
+        _log.Start();
+    }
+
+    // see OperationLog.h
+    void Stop() override {
+        _log.Stop();
+        _storage->Stop();
+    }
+
+    // see Storage.h
+    bool Put(const std::string &key, const std::string &value) override { return Put(key, value, Meta()); }
+
+    // see Storage.h
+    bool Put(const std::string &key, const std::string &value, const Meta &meta) override {
+        return Put(StringRef(key), value, meta);
+    }
+
+    // see Storage.h
+    bool Put(StringRef key, const std::string &value, const Meta &meta) override {
+        std::unique_lock<std::mutex> lock(stripe_of(key));
+        if (!_storage->Put(key, value, meta)) {
+            return false;
+        }
+        _log.Write(OperationLog::Op::kPut, key, value, meta);
+        return true;
+    }
+
+    // see Storage.h
+    bool PutIfAbsent(const std::string &key, const std::string &value) override {
+        return PutIfAbsent(key, value, Meta());
+    }
+
+    // see Storage.h
+    bool PutIfAbsent(const std::string &key, const std::string &value, const Meta &meta) override {
+        return PutIfAbsent(StringRef(key), value, meta);
+    }
+
+    // see Storage.h
+    bool PutIfAbsent(StringRef key, const std::string &value, const Meta &meta) override {
+        std::unique_lock<std::mutex> lock(stripe_of(key));
+        if (!_storage->PutIfAbsent(key, value, meta)) {
+            return false;
+        }
+        _log.Write(OperationLog::Op::kPut, key, value, meta);
+        return true;
+    }
+
+    // see Storage.h
+    bool Set(const std::string &key, const std::string &value) override { return Set(key, value, Meta()); }
+
+    // see Storage.h
+    bool Set(const std::string &key, const std::string &value, const Meta &meta) override {
+        return Set(StringRef(key), value, meta);
+    }
+
+    // see Storage.h
+    bool Set(StringRef key, const std::string &value, const Meta &meta) override {
+        std::unique_lock<std::mutex> lock(stripe_of(key));
+        if (!_storage->Set(key, value, meta)) {
+            return false;
+        }
+        _log.Write(OperationLog::Op::kPut, key, value, meta);
+        return true;
+    }
+
+    // see Storage.h
+    CasStatus CompareAndSet(const std::string &key, const std::string &value, const Meta &meta,
+                            uint64_t version) override {
+        std::unique_lock<std::mutex> lock(stripe_of(key));
+        CasStatus status = _storage->CompareAndSet(key, value, meta, version);
+        if (status == CasStatus::kStored) {
+            _log.Write(OperationLog::Op::kPut, key, value, meta);
+        }
+        return status;
+    }
+
+    // see Storage.h
+    bool Append(const std::string &key, const std::string &data) override {
+        std::unique_lock<std::mutex> lock(stripe_of(key));
+        if (!_storage->Append(key, data)) {
+            return false;
+        }
+        _log.Write(OperationLog::Op::kAppend, key, data, Meta());
+        return true;
+    }
+
+    // see Storage.h
+    bool Prepend(const std::string &key, const std::string &data) override {
+        std::unique_lock<std::mutex> lock(stripe_of(key));
+        if (!_storage->Prepend(key, data)) {
+            return false;
+        }
+        _log.Write(OperationLog::Op::kPrepend, key, data, Meta());
+        return true;
+    }
+
+    // see Storage.h
+    CounterStatus Increment(const std::string &key, uint64_t delta, uint64_t &value) override {
+        std::unique_lock<std::mutex> lock(stripe_of(key));
+        CounterStatus status = _storage->Increment(key, delta, value);
+        if (status == CounterStatus::kUpdated) {
+            _log.Write(OperationLog::Op::kIncrement, key, std::to_string(delta), Meta());
+        }
+        return status;
+    }
+
+    // see Storage.h
+    CounterStatus Decrement(const std::string &key, uint64_t delta, uint64_t &value) override {
+        std::unique_lock<std::mutex> lock(stripe_of(key));
+        CounterStatus status = _storage->Decrement(key, delta, value);
+        if (status == CounterStatus::kUpdated) {
+            _log.Write(OperationLog::Op::kDecrement, key, std::to_string(delta), Meta());
+        }
+        return status;
+    }
+
+    // see Storage.h
+    bool Delete(const std::string &key) override {
+        std::unique_lock<std::mutex> lock(stripe_of(key));
+        if (!_storage->Delete(key)) {
+            return false;
+        }
+        _log.Write(OperationLog::Op::kDelete, key, StringRef(nullptr, 0), Meta());
+        return true;
+    }
+
+    // see Storage.h
+    bool Get(const std::string &key, std::string &value) override { return _storage->Get(key, value); }
+
+    // see Storage.h
+    bool Get(StringRef key, std::string &value) override { return _storage->Get(key, value); }
+
+    // see Storage.h
+    bool Get(const std::string &key, ValueRef &value) override { return _storage->Get(key, value); }
+
+    // see Storage.h
+    bool Get(StringRef key, ValueRef &value) override { return _storage->Get(key, value); }
+
+    // MultiGet of std::string keys is the default one
+    using Afina::Storage::MultiGet;
+
+    // see Storage.h
+    std::size_t MultiGet(const std::vector<StringRef> &keys, std::vector<ValueRef> &values,
+                         std::vector<Meta> *metas, bool versions) override {
+        return _storage->MultiGet(keys, values, metas, versions);
+    }
+
+    // see Storage.h
+    bool Export(const std::function<void(Item &item)> &visit) override { return _storage->Export(visit); }
+
+    // see Storage.h
+    uint64_t Scan(uint64_t cursor, std::size_t count, std::vector<std::string> &keys) override {
+        return _storage->Scan(cursor, count, keys);
+    }
+
+    // see Storage.h
+    void Stats(std::vector<std::pair<std::string, std::string>> &stats) override { _storage->Stats(stats); }
+
+    // Log modifications are written to
+    const OperationLog &log() const { return _log; }
+
+private:
+    // Number of key stripes, power of two
+    static constexpr std::size_t kStripes = 64;
+
+    std::mutex &stripe_of(StringRef key) { return _stripes[HashKey(key) & (kStripes - 1)]; }
+
+    std::shared_ptr<Afina::Storage> _storage;
+    OperationLog _log;
+    std::mutex _stripes[kStripes];
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_LOGGED_STORAGE_H
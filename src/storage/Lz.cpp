@@ -0,0 +1,175 @@
+#include "Lz.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace Afina {
+namespace Backend {
+
+namespace {
+
+const std::size_t kMinMatch = 4;
+const std::size_t kMaxOffset = 65535;
+
+// Hash table of 4096 positions fits L1 cache
+const int kHashBits = 12;
+
+uint32_t read32(const char *p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+uint32_t hash32(uint32_t value) { return (value * 2654435761u) >> (32 - kHashBits); }
+
+// Writes the part of length beyond the token nibble, returns false if output is full
+bool put_length(char *&op, const char *end, std::size_t length) {
+    for (; length >= 255; length -= 255) {
+        if (op == end) {
+            return false;
+        }
+        *op++ = static_cast<char>(255);
+    }
+    if (op == end) {
+        return false;
+    }
+    *op++ = static_cast<char>(length);
+    return true;
+}
+
+bool get_length(const uint8_t *&ip, const uint8_t *end, std::size_t &length) {
+    uint8_t byte;
+    do {
+        if (ip == end) {
+            return false;
+        }
+        byte = *ip++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+// Writes literals followed by the match, zero match_size means the last sequence of the block
+bool put_sequence(char *&op, const char *end, const char *literals, std::size_t literal_size, std::size_t offset,
+                  std::size_t match_size) {
+    if (op == end) {
+        return false;
+    }
+    char *token = op++;
+    std::size_t match_code = match_size == 0 ? 0 : match_size - kMinMatch;
+    *token = static_cast<char>((std::min<std::size_t>(literal_size, 15) << 4) | std::min<std::size_t>(match_code, 15));
+
+    if (literal_size >= 15 && !put_length(op, end, literal_size - 15)) {
+        return false;
+    }
+    if (static_cast<std::size_t>(end - op) < literal_size) {
+        return false;
+    }
+    std::memcpy(op, literals, literal_size);
+    op += literal_size;
+    if (match_size == 0) {
+        return true;
+    }
+
+    if (end - op < 2) {
+        return false;
+    }
+    *op++ = static_cast<char>(offset & 0xff);
+    *op++ = static_cast<char>(offset >> 8);
+    return match_code < 15 || put_length(op, end, match_code - 15);
+}
+
+} // namespace
+
+// See Lz.h
+std::size_t LzCompress(const char *src, std::size_t size, char *dst, std::size_t capacity) {
+    uint32_t table[1 << kHashBits] = {0};
+    char *op = dst;
+    const char *end = dst + capacity;
+
+    std::size_t ip = 0;
+    std::size_t anchor = 0;
+    while (ip + kMinMatch <= size) {
+        uint32_t sequence = read32(src + ip);
+        uint32_t &slot = table[hash32(sequence)];
+        std::size_t candidate = slot;
+        slot = ip;
+
+        if (candidate < ip && ip - candidate <= kMaxOffset && read32(src + candidate) == sequence) {
+            std::size_t match = kMinMatch;
+            while (ip + match < size && src[candidate + match] == src[ip + match]) {
+                match++;
+            }
+            if (!put_sequence(op, end, src + anchor, ip - anchor, ip - candidate, match)) {
+                return 0;
+            }
+            ip += match;
+            anchor = ip;
+        } else {
+            // The longer there is no match, the bigger the step: incompressible input is passed quickly
+            ip += 1 + ((ip - anchor) >> 6);
+        }
+    }
+
+    if (!put_sequence(op, end, src + anchor, size - anchor, 0, 0)) {
+        return 0;
+    }
+    return op - dst;
+}
+
+// See Lz.h
+bool LzDecompress(const char *src, std::size_t size, char *dst, std::size_t raw_size) {
+    const uint8_t *ip = reinterpret_cast<const uint8_t *>(src);
+    const uint8_t *end = ip + size;
+    char *op = dst;
+    char *out_end = dst + raw_size;
+
+    while (ip < end) {
+        uint8_t token = *ip++;
+        std::size_t literals = token >> 4;
+        if (literals == 15 && !get_length(ip, end, literals)) {
+            return false;
+        }
+        if (static_cast<std::size_t>(end - ip) < literals || static_cast<std::size_t>(out_end - op) < literals) {
+            return false;
+        }
+        std::memcpy(op, ip, literals);
+        op += literals;
+        ip += literals;
+        if (ip == end) {
+            // The last sequence has no match
+            break;
+        }
+
+        if (end - ip < 2) {
+            return false;
+        }
+        std::size_t offset = ip[0] | (std::size_t(ip[1]) << 8);
+        ip += 2;
+        std::size_t match = token & 15;
+        if (match == 15 && !get_length(ip, end, match)) {
+            return false;
+        }
+        match += kMinMatch;
+        if (offset == 0 || offset > static_cast<std::size_t>(op - dst) ||
+            static_cast<std::size_t>(out_end - op) < match) {
+            return false;
+        }
+
+        const char *from = op - offset;
+        if (offset >= match) {
+            std::memcpy(op, from, match);
+        } else {
+            // Overlapping match repeats the last offset bytes
+            for (std::size_t i = 0; i < match; i++) {
+                op[i] = from[i];
+            }
+        }
+        op += match;
+    }
+    return op == out_end;
+}
+
+} // namespace Backend
+} // namespace Afina
@@ -0,0 +1,34 @@
+#ifndef AFINA_STORAGE_LZ_H
+#define AFINA_STORAGE_LZ_H
+
+#include <cstddef>
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # LZ77 block codec
+ * Byte oriented format of the LZ4 block kind, fast enough to run on every Put and Get. Block is a sequence of
+ * tokens: high nibble is number of literals following the token, low one is match length minus 4, 15 means
+ * extra length bytes follow, each adding up to 255. Literals are followed by 2 byte little endian offset of the
+ * match back from the current position. The last token has literals only, block ends right after them.
+ *
+ * Compressor finds matches with a single hash table of 4 byte sequences and skips faster through the input
+ * that doesn't compress, so text like JSON shrinks 2-4 times while random bytes cost little time.
+ */
+
+/**
+ * Compresses size bytes of src into dst. Returns compressed size or 0 if it doesn't fit capacity bytes
+ */
+std::size_t LzCompress(const char *src, std::size_t size, char *dst, std::size_t capacity);
+
+/**
+ * Decompresses block of size bytes into dst, which must have room for raw_size bytes. Returns false unless
+ * block is well formed and decompresses exactly to raw_size bytes
+ */
+bool LzDecompress(const char *src, std::size_t size, char *dst, std::size_t raw_size);
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_LZ_H
@@ -0,0 +1,97 @@
+#ifndef AFINA_STORAGE_MEMORY_BUDGET_H
+#define AFINA_STORAGE_MEMORY_BUDGET_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Byte budget shared by several storages
+ * Pool of bytes storages borrow from once their own reserve is not enough for a new entry and return to once
+ * they have more than they need. Lock free, so storages guarded by different locks share it freely.
+ *
+ * Storage that fails to borrow evicts its own entries instead and records how much it wanted. Storages not
+ * short of space themselves repay that demand by evicting their entries into the pool, so capacity moves to
+ * the storages under eviction pressure. Storage that has nothing to evict could overdraw the pool, the debt is
+ * repaid by other storages the same way.
+ */
+class MemoryBudget {
+public:
+    /**
+     * @param size total number of bytes
+     */
+    MemoryBudget(std::size_t size) : _size(size), _free(size), _wanted(0) {}
+
+    // Total number of bytes
+    std::size_t size() const { return _size; }
+
+    // Number of bytes storage could keep unused without returning them, also the borrowing step
+    std::size_t slack() const { return _size / 256; }
+
+    /**
+     * Takes exactly size bytes if there are that many free, returns false otherwise
+     */
+    bool borrow(std::size_t size) {
+        int64_t free = _free.load(std::memory_order_relaxed);
+        do {
+            if (free < static_cast<int64_t>(size)) {
+                return false;
+            }
+        } while (!_free.compare_exchange_weak(free, free - size, std::memory_order_relaxed));
+
+        // Demand is satisfied by the same amount
+        int64_t wanted = _wanted.load(std::memory_order_relaxed);
+        while (wanted > 0 &&
+               !_wanted.compare_exchange_weak(wanted, std::max<int64_t>(0, wanted - size), std::memory_order_relaxed)) {
+        }
+        return true;
+    }
+
+    /**
+     * Takes size bytes regardless of how many are free, storages repay the debt later, see debt
+     */
+    void overdraw(std::size_t size) { _free.fetch_sub(size, std::memory_order_relaxed); }
+
+    /**
+     * Puts size bytes back to the pool
+     */
+    void give(std::size_t size) { _free.fetch_add(size, std::memory_order_relaxed); }
+
+    /**
+     * Records that storage has evicted its entries as it failed to borrow size bytes. Demand is capped, so at
+     * most 1/8 of the budget moves between storages at once
+     */
+    void want(std::size_t size) {
+        int64_t wanted = _wanted.load(std::memory_order_relaxed);
+        int64_t limit = _size / 8;
+        while (wanted < limit && !_wanted.compare_exchange_weak(wanted, std::min<int64_t>(limit, wanted + size),
+                                                                std::memory_order_relaxed)) {
+        }
+    }
+
+    // Number of bytes taken over the budget, must be repaid by any storage able to
+    std::size_t debt() const { return std::max<int64_t>(0, -_free.load(std::memory_order_relaxed)); }
+
+    // Number of bytes storages under pressure are waiting for and the pool lacks
+    std::size_t owed() const {
+        return std::max<int64_t>(0, _wanted.load(std::memory_order_relaxed) - _free.load(std::memory_order_relaxed));
+    }
+
+private:
+    const std::size_t _size;
+
+    // Bytes nobody has borrowed, negative once budget is overdrawn
+    std::atomic<int64_t> _free;
+
+    // Bytes storages failed to borrow recently
+    std::atomic<int64_t> _wanted;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_MEMORY_BUDGET_H
@@ -0,0 +1,156 @@
+#include "NodePool.h"
+
+#include <mutex>
+#include <new>
+
+namespace Afina {
+namespace Backend {
+
+namespace {
+
+const std::size_t kClasses = NodePool::kMaxBlock / NodePool::kGranularity;
+
+// Number of blocks thread moves between its cache and the shared list at once
+const std::size_t kBatch = 32;
+
+struct free_block {
+    free_block *next;
+};
+
+struct shared_class {
+    std::mutex mutex;
+    free_block *head = nullptr;
+};
+
+shared_class *shared_classes() {
+    // Never destroyed: thread caches give blocks back on thread exit, which could happen after static destructors
+    static shared_class *classes = new shared_class[kClasses];
+    return classes;
+}
+
+std::size_t class_of(std::size_t size) { return size == 0 ? 0 : (size - 1) / NodePool::kGranularity; }
+
+// Free blocks of a single thread
+struct thread_cache {
+    free_block *heads[kClasses];
+    std::size_t counts[kClasses];
+
+    thread_cache() {
+        for (std::size_t c = 0; c < kClasses; c++) {
+            heads[c] = nullptr;
+            counts[c] = 0;
+        }
+    }
+
+    ~thread_cache() {
+        for (std::size_t c = 0; c < kClasses; c++) {
+            if (counts[c] > 0) {
+                give_back(c, counts[c]);
+            }
+        }
+    }
+
+    // Moves the first number blocks of the class to the shared list
+    void give_back(std::size_t c, std::size_t number) {
+        free_block *first = heads[c];
+        free_block *last = first;
+        for (std::size_t i = 1; i < number; i++) {
+            last = last->next;
+        }
+        heads[c] = last->next;
+        counts[c] -= number;
+
+        shared_class &shared = shared_classes()[c];
+        std::unique_lock<std::mutex> lock(shared.mutex);
+        last->next = shared.head;
+        shared.head = first;
+    }
+
+    // Takes a batch of blocks from the shared list or, if it is empty, carves a new slab
+    void refill(std::size_t c) {
+        {
+            shared_class &shared = shared_classes()[c];
+            std::unique_lock<std::mutex> lock(shared.mutex);
+            while (shared.head != nullptr && counts[c] < kBatch) {
+                free_block *block = shared.head;
+                shared.head = block->next;
+                block->next = heads[c];
+                heads[c] = block;
+                counts[c]++;
+            }
+        }
+        if (counts[c] > 0) {
+            return;
+        }
+
+        // Thread takes a batch, the rest of the slab is for everybody
+        std::size_t size = (c + 1) * NodePool::kGranularity;
+        char *slab = static_cast<char *>(::operator new(NodePool::kSlabSize));
+        free_block *rest = nullptr;
+        free_block *rest_last = nullptr;
+        for (std::size_t offset = 0; offset + size <= NodePool::kSlabSize; offset += size) {
+            free_block *block = reinterpret_cast<free_block *>(slab + offset);
+            if (counts[c] < kBatch) {
+                block->next = heads[c];
+                heads[c] = block;
+                counts[c]++;
+            } else {
+                block->next = rest;
+                rest = block;
+                if (rest_last == nullptr) {
+                    rest_last = block;
+                }
+            }
+        }
+        if (rest != nullptr) {
+            shared_class &shared = shared_classes()[c];
+            std::unique_lock<std::mutex> lock(shared.mutex);
+            rest_last->next = shared.head;
+            shared.head = rest;
+        }
+    }
+};
+
+thread_cache &local_cache() {
+    static thread_local thread_cache cache;
+    return cache;
+}
+
+} // namespace
+
+// See NodePool.h
+void *NodePool::Allocate(std::size_t size) {
+    if (size > kMaxBlock) {
+        return ::operator new(size);
+    }
+
+    std::size_t c = class_of(size);
+    thread_cache &cache = local_cache();
+    if (cache.heads[c] == nullptr) {
+        cache.refill(c);
+    }
+    free_block *block = cache.heads[c];
+    cache.heads[c] = block->next;
+    cache.counts[c]--;
+    return block;
+}
+
+// See NodePool.h
+void NodePool::Free(void *block, std::size_t size) {
+    if (size > kMaxBlock) {
+        ::operator delete(block);
+        return;
+    }
+
+    std::size_t c = class_of(size);
+    thread_cache &cache = local_cache();
+    free_block *freed = static_cast<free_block *>(block);
+    freed->next = cache.heads[c];
+    cache.heads[c] = freed;
+    if (++cache.counts[c] >= 2 * kBatch) {
+        cache.give_back(c, kBatch);
+    }
+}
+
+} // namespace Backend
+} // namespace Afina
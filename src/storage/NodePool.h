@@ -0,0 +1,46 @@
+#ifndef AFINA_STORAGE_NODE_POOL_H
+#define AFINA_STORAGE_NODE_POOL_H
+
+#include <cstddef>
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Size class pool for small storage nodes
+ * Process wide allocator of blocks up to kMaxBlock bytes. Each size class, kGranularity bytes apart, carves its
+ * blocks out of kSlabSize slabs back to back, so small entry pays neither general allocator header nor its
+ * rounding, and entries of the same size class sit densely in memory. Larger blocks go to the general allocator.
+ *
+ * Thread safe. Every thread has its own cache of free blocks per class and exchanges them with the shared lists
+ * in batches only, so nodes freed by the last ValueRef in any thread don't contend with storage allocating new
+ * ones. Slabs are never given back: memory freed by a class stays with that class.
+ */
+class NodePool {
+public:
+    static constexpr std::size_t kGranularity = 16;
+    static constexpr std::size_t kMaxBlock = 256;
+    static constexpr std::size_t kSlabSize = 64 << 10;
+
+    /**
+     * Block of at least size bytes, aligned as ::operator new does
+     */
+    static void *Allocate(std::size_t size);
+
+    /**
+     * Frees block allocated with the same size
+     */
+    static void Free(void *block, std::size_t size);
+
+    /**
+     * Number of bytes actually taken by the block of given size
+     */
+    static std::size_t BlockSize(std::size_t size) {
+        return size > kMaxBlock ? size : (size + kGranularity - 1) / kGranularity * kGranularity;
+    }
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_NODE_POOL_H
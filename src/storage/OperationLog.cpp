@@ -0,0 +1,325 @@
+#include "OperationLog.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Varint.h"
+
+namespace Afina {
+namespace Backend {
+
+namespace {
+
+// Size of the checksum preceding each record
+const std::size_t kChecksumSize = 4;
+
+std::string failure(const std::string &what, const std::string &path) {
+    return what + " " + path + ": " + std::string(strerror(errno));
+}
+
+// FNV-1a, enough to tell torn record from the complete one
+uint32_t checksum(const char *data, std::size_t size) {
+    uint32_t hash = 0x811c9dc5;
+    for (std::size_t i = 0; i < size; i++) {
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * 0x01000193;
+    }
+    return hash;
+}
+
+// Appends record to out
+void put_record(std::string &out, OperationLog::Op op, StringRef key, StringRef value,
+                const Afina::Storage::Meta &meta) {
+    std::size_t start = out.size();
+    out.append(kChecksumSize, '\0');
+    out.push_back(static_cast<char>(op));
+    PutVarint(out, key.size());
+    PutVarint(out, value.size());
+    PutVarint(out, meta.expire);
+    PutVarint(out, meta.flags);
+    out.append(key.data(), key.size());
+    out.append(value.data(), value.size());
+
+    uint32_t sum = checksum(&out[start + kChecksumSize], out.size() - start - kChecksumSize);
+    for (std::size_t i = 0; i < kChecksumSize; i++) {
+        out[start + i] = static_cast<char>(sum >> (8 * i));
+    }
+}
+
+// Whole content of the file at path, empty if there is no such file
+std::string read_file(const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (errno == ENOENT) {
+            return std::string();
+        }
+        throw std::runtime_error(failure("Failed to open log", path));
+    }
+
+    std::string data;
+    struct stat st;
+    if (fstat(fd, &st) == 0) {
+        data.reserve(st.st_size);
+    }
+    char chunk[64 * 1024];
+    while (true) {
+        ssize_t got = read(fd, chunk, sizeof(chunk));
+        if (got < 0 && errno == EINTR) {
+            continue;
+        } else if (got < 0) {
+            close(fd);
+            throw std::runtime_error(failure("Failed to read log", path));
+        } else if (got == 0) {
+            break;
+        }
+        data.append(chunk, got);
+    }
+    close(fd);
+    return data;
+}
+
+void write_all(int fd, const char *data, std::size_t size, const std::string &path) {
+    while (size > 0) {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error(failure("Failed to write log", path));
+        }
+        data += written;
+        size -= written;
+    }
+}
+
+// Applies single record to storage
+void apply(Afina::Storage &storage, OperationLog::Op op, const std::string &key, const std::string &value,
+           const Afina::Storage::Meta &meta) {
+    uint64_t counter;
+    switch (op) {
+    case OperationLog::Op::kPut:
+        storage.Put(key, value, meta);
+        break;
+    case OperationLog::Op::kPutIfAbsent:
+        storage.PutIfAbsent(key, value, meta);
+        break;
+    case OperationLog::Op::kSet:
+        storage.Set(key, value, meta);
+        break;
+    case OperationLog::Op::kDelete:
+        storage.Delete(key);
+        break;
+    case OperationLog::Op::kAppend:
+        storage.Append(key, value);
+        break;
+    case OperationLog::Op::kPrepend:
+        storage.Prepend(key, value);
+        break;
+    case OperationLog::Op::kIncrement:
+        storage.Increment(key, std::stoull(value), counter);
+        break;
+    case OperationLog::Op::kDecrement:
+        storage.Decrement(key, std::stoull(value), counter);
+        break;
+    }
+}
+
+bool known(char op) {
+    switch (static_cast<OperationLog::Op>(op)) {
+    case OperationLog::Op::kPut:
+    case OperationLog::Op::kPutIfAbsent:
+    case OperationLog::Op::kSet:
+    case OperationLog::Op::kDelete:
+    case OperationLog::Op::kAppend:
+    case OperationLog::Op::kPrepend:
+    case OperationLog::Op::kIncrement:
+    case OperationLog::Op::kDecrement:
+        return true;
+    }
+    return false;
+}
+
+} // namespace
+
+OperationLog::OperationLog(const std::string &path, std::chrono::milliseconds sync_interval)
+    : _path(path), _sync_interval(sync_interval), _fd(-1), _written(0), _running(false) {}
+
+OperationLog::~OperationLog() {
+    try {
+        Stop();
+    } catch (std::exception &) {
+        // Nobody to report to
+    }
+}
+
+// See OperationLog.h
+std::size_t OperationLog::Recover(Afina::Storage &storage) {
+    std::string data = read_file(_path);
+    const char *p = data.data();
+    const char *end = p + data.size();
+
+    std::size_t replayed = 0;
+    while (static_cast<std::size_t>(end - p) > kChecksumSize) {
+        const char *record = p + kChecksumSize;
+        const char *q = record + 1;
+        uint64_t key_size, value_size, expire, flags;
+        if (!known(*record) || !GetVarint(q, end, key_size) || !GetVarint(q, end, value_size) ||
+            !GetVarint(q, end, expire) || !GetVarint(q, end, flags) || key_size > uint64_t(end - q) ||
+            value_size > uint64_t(end - q - key_size)) {
+            break;
+        }
+
+        uint32_t sum = 0;
+        for (std::size_t i = 0; i < kChecksumSize; i++) {
+            sum |= uint32_t(static_cast<unsigned char>(p[i])) << (8 * i);
+        }
+        const char *next = q + key_size + value_size;
+        if (sum != checksum(record, next - record)) {
+            break;
+        }
+
+        Afina::Storage::Meta meta;
+        meta.expire = expire;
+        meta.flags = flags;
+        apply(storage, static_cast<Op>(*record), std::string(q, key_size), std::string(q + key_size, value_size),
+              meta);
+        replayed++;
+        p = next;
+    }
+    data.clear();
+
+    // Compaction: the only record left per entry is its Put
+    std::string temporary = _path + ".tmp";
+    int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error(failure("Failed to create log", temporary));
+    }
+    try {
+        std::string buffer;
+        bool supported = storage.Export([&](Afina::Storage::Item &item) {
+            put_record(buffer, Op::kPut, item.key, StringRef(item.value.data(), item.value.size()), item.meta);
+            if (buffer.size() >= kFlushSize) {
+                write_all(fd, buffer.data(), buffer.size(), temporary);
+                buffer.clear();
+            }
+        });
+        write_all(fd, buffer.data(), buffer.size(), temporary);
+        if (fsync(fd) != 0) {
+            throw std::runtime_error(failure("Failed to sync log", temporary));
+        }
+        close(fd);
+        fd = -1;
+
+        // Log stays as is if there is no way to enumerate entries
+        if (supported && rename(temporary.c_str(), _path.c_str()) != 0) {
+            throw std::runtime_error(failure("Failed to replace log", _path));
+        }
+        unlink(temporary.c_str());
+    } catch (...) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        unlink(temporary.c_str());
+        throw;
+    }
+    return replayed;
+}
+
+// See OperationLog.h
+void OperationLog::Start() {
+    _fd = open(_path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (_fd < 0) {
+        throw std::runtime_error(failure("Failed to open log", _path));
+    }
+    struct stat st;
+    if (fstat(_fd, &st) == 0) {
+        _written.store(st.st_size, std::memory_order_relaxed);
+    }
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _running = true;
+    _writer = std::thread(&OperationLog::run, this);
+}
+
+// See OperationLog.h
+void OperationLog::Stop() {
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _running = false;
+    }
+    _enqueued.notify_all();
+    _drained.notify_all();
+    if (_writer.joinable()) {
+        _writer.join();
+    }
+    if (_fd >= 0) {
+        close(_fd);
+        _fd = -1;
+    }
+
+    std::string error;
+    error.swap(_error);
+    if (!error.empty()) {
+        throw std::runtime_error(error);
+    }
+}
+
+// See OperationLog.h
+void OperationLog::Write(Op op, StringRef key, StringRef value, const Afina::Storage::Meta &meta) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _drained.wait(lock, [this] { return _buffer.size() < kMaxBuffer || !_running; });
+    put_record(_buffer, op, key, value, meta);
+    if (_sync_interval.count() == 0 || _buffer.size() >= kFlushSize) {
+        _enqueued.notify_one();
+    }
+}
+
+void OperationLog::run() {
+    std::string batch;
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+        if (_sync_interval.count() == 0) {
+            _enqueued.wait(lock, [this] { return !_buffer.empty() || !_running; });
+        } else {
+            _enqueued.wait_for(lock, _sync_interval, [this] { return _buffer.size() >= kFlushSize || !_running; });
+        }
+        if (_buffer.empty()) {
+            if (!_running) {
+                break;
+            }
+            continue;
+        }
+
+        // Everything enqueued meanwhile gets the same write and sync
+        batch.swap(_buffer);
+        _drained.notify_all();
+        lock.unlock();
+        try {
+            if (_error.empty()) {
+                write(batch);
+            }
+        } catch (std::exception &e) {
+            // Records are dropped from now on, Stop reports the failure
+            lock.lock();
+            _error = e.what();
+            lock.unlock();
+        }
+        batch.clear();
+        lock.lock();
+    }
+}
+
+void OperationLog::write(const std::string &data) {
+    write_all(_fd, data.data(), data.size(), _path);
+    if (fdatasync(_fd) != 0) {
+        throw std::runtime_error(failure("Failed to sync log", _path));
+    }
+    _written.fetch_add(data.size(), std::memory_order_relaxed);
+}
+
+} // namespace Backend
+} // namespace Afina
@@ -0,0 +1,124 @@
+#ifndef AFINA_STORAGE_OPERATION_LOG_H
+#define AFINA_STORAGE_OPERATION_LOG_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <afina/Storage.h>
+#include <afina/StringRef.h>
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Append-only log of storage modifications
+ * Workers only enqueue records: each one is serialized into the shared buffer under a short lock. Single writer
+ * thread swaps the buffer out, writes it with one call and syncs the file, so all records enqueued since the
+ * last round share one write and one fsync (group commit). Modification is acknowledged once enqueued, so crash
+ * loses at most sync_interval worth of them.
+ *
+ * Each record is a checksum followed by the operation tag, varint key size, value size, expiration time and
+ * flags, then key and value bytes. Torn record at the end of the log, left by a crash in the middle of a write,
+ * fails the checksum and ends replay.
+ *
+ * On start the log is replayed into storage and then compacted: rewritten as a single Put per live entry of the
+ * storage, see Storage::Export, so the log grows only with modifications of the current run.
+ */
+class OperationLog {
+public:
+    enum class Op : char {
+        kPut = 'P',
+        kPutIfAbsent = 'A',
+        kSet = 'S',
+        kDelete = 'D',
+        kAppend = 'a',
+        kPrepend = 'p',
+        kIncrement = 'I',
+        kDecrement = 'd'
+    };
+
+    /**
+     * @param path of the log file
+     * @param sync_interval time between rounds of the writer, zero makes writer sync as soon as anything is
+     * enqueued
+     */
+    OperationLog(const std::string &path, std::chrono::milliseconds sync_interval);
+    ~OperationLog();
+
+    /**
+     * Applies all records of the log to storage and rewrites the log as the content of the storage. Must be
+     * called before Start. Throws std::runtime_error on I/O failure.
+     *
+     * @return number of records replayed
+     */
+    std::size_t Recover(Afina::Storage &storage);
+
+    /**
+     * Opens log for append and starts the writer
+     */
+    void Start();
+
+    /**
+     * Writes and syncs everything enqueued, then stops the writer
+     */
+    void Stop();
+
+    /**
+     * Enqueues record of the modification. Waits only if writer is far behind, see kMaxBuffer
+     *
+     * @param op operation applied
+     * @param key of the association
+     * @param value given to the operation: data for Append/Prepend, decimal delta for Increment/Decrement
+     * @param meta attributes given to the operation, if any
+     */
+    void Write(Op op, StringRef key, StringRef value, const Afina::Storage::Meta &meta);
+
+    // Number of bytes the log file had after the last write
+    std::size_t size() const { return _written.load(std::memory_order_relaxed); }
+
+private:
+    // Enqueued records are written once buffer reaches that size, without waiting for the next round
+    static const std::size_t kFlushSize = 1 << 20;
+
+    // Writers wait for the writer thread once buffer reaches that size
+    static const std::size_t kMaxBuffer = 64 << 20;
+
+    OperationLog(const OperationLog &);            // = delete;
+    OperationLog &operator=(const OperationLog &); // = delete;
+
+    // Writer thread body
+    void run();
+
+    // Writes all bytes of data to the log file
+    void write(const std::string &data);
+
+    const std::string _path;
+    const std::chrono::milliseconds _sync_interval;
+
+    int _fd;
+    std::atomic<std::size_t> _written;
+    std::thread _writer;
+
+    // Guards everything below
+    std::mutex _mutex;
+    std::condition_variable _enqueued;
+    std::condition_variable _drained;
+
+    // Records enqueued since the writer has taken the buffer last time
+    std::string _buffer;
+    bool _running;
+
+    // Failure of the writer, reported by Stop
+    std::string _error;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_OPERATION_LOG_H
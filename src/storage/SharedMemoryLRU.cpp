@@ -0,0 +1,572 @@
+#include "SharedMemoryLRU.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <limits>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Afina {
+namespace Backend {
+
+namespace {
+
+const char kMagic[8] = {'A', 'F', 'I', 'N', 'A', 'S', 'H', 'M'};
+
+// Bump on any change of the header or node structure
+const uint32_t kLayout = 2;
+
+// Hash table gets a bucket per that many bytes of the mapping
+const std::size_t kBytesPerBucket = 512;
+
+// Number of buckets Export takes out under the lock at once
+const std::size_t kExportBuckets = 1024;
+
+std::string failure(const std::string &what, const std::string &path) {
+    return what + " " + path + ": " + std::string(strerror(errno));
+}
+
+// Expiration time as stored in node, meta must not be expired yet
+uint32_t expire_of(const Afina::Storage::Meta &meta) {
+    if (meta.expire >= std::numeric_limits<uint32_t>::max()) {
+        return std::numeric_limits<uint32_t>::max();
+    }
+    return meta.expire;
+}
+
+} // namespace
+
+SharedMemoryLRU::SharedMemoryLRU(const std::string &path, std::size_t size)
+    : _base(nullptr), _size(size), _fd(-1), _attached(false) {
+    _fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (_fd < 0) {
+        throw std::runtime_error(failure("Failed to open storage", path));
+    }
+    if (flock(_fd, LOCK_EX | LOCK_NB) != 0) {
+        close(_fd);
+        throw std::runtime_error("Storage " + path + " is attached by another process");
+    }
+
+    struct stat st;
+    if (fstat(_fd, &st) != 0 || (static_cast<std::size_t>(st.st_size) != _size && ftruncate(_fd, _size) != 0)) {
+        close(_fd);
+        throw std::runtime_error(failure("Failed to resize storage", path));
+    }
+    void *base = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    if (base == MAP_FAILED) {
+        close(_fd);
+        throw std::runtime_error(failure("Failed to map storage", path));
+    }
+    _base = static_cast<char *>(base);
+
+    shm_header &h = header();
+    _attached = std::memcmp(h.magic, kMagic, sizeof(kMagic)) == 0 && h.layout == kLayout && h.size == _size &&
+                h.clean == 1;
+    if (!_attached) {
+        format();
+    }
+    h.clean = 0;
+}
+
+SharedMemoryLRU::~SharedMemoryLRU() {
+    // Entries reach the file before it is marked clean, so the mark never precedes them on disk
+    msync(_base, _size, MS_SYNC);
+    header().clean = 1;
+    msync(_base, sizeof(shm_header), MS_SYNC);
+    munmap(_base, _size);
+    close(_fd);
+}
+
+// See SharedMemoryLRU.h
+std::size_t SharedMemoryLRU::EntrySize(std::size_t key_size, std::size_t value_size) {
+    return kMinBlock << size_class(sizeof(shm_node) + key_size + value_size);
+}
+
+std::size_t SharedMemoryLRU::size_class(std::size_t size) {
+    std::size_t result = 0;
+    while ((kMinBlock << result) < size) {
+        result++;
+    }
+    return result;
+}
+
+void SharedMemoryLRU::format() {
+    std::size_t buckets = 16;
+    while (buckets * 2 <= _size / kBytesPerBucket) {
+        buckets *= 2;
+    }
+    std::size_t arena = (sizeof(shm_header) + buckets * sizeof(uint64_t) + kMinBlock - 1) / kMinBlock * kMinBlock;
+    if (arena + kMinBlock > _size) {
+        throw std::runtime_error("Storage size is too small: " + std::to_string(_size));
+    }
+
+    std::memset(_base, 0, arena);
+    shm_header &h = header();
+    std::memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.layout = kLayout;
+    h.size = _size;
+    h.buckets = buckets;
+    h.arena = arena;
+
+    // Arena is carved into blocks of decreasing classes, so each one is aligned to its size
+    uint64_t block = arena;
+    for (std::size_t c = kSizeClasses; c-- > 0;) {
+        if (block + (kMinBlock << c) <= _size) {
+            push_free(block, c);
+            block += kMinBlock << c;
+        }
+    }
+}
+
+std::size_t SharedMemoryLRU::top_class() {
+    shm_header &h = header();
+    std::size_t c = 0;
+    while (c + 1 < kSizeClasses && h.arena + (kMinBlock << (c + 1)) <= h.size) {
+        c++;
+    }
+    return c;
+}
+
+uint64_t SharedMemoryLRU::allocate(std::size_t size) {
+    std::size_t c = size_class(size);
+    if (c >= kSizeClasses) {
+        return 0;
+    }
+
+    shm_header &h = header();
+    std::size_t from = c;
+    while (from < kSizeClasses && h.free[from] == 0) {
+        from++;
+    }
+    if (from == kSizeClasses) {
+        return 0;
+    }
+
+    // Larger block is split in halves, upper ones stay free
+    uint64_t block = h.free[from];
+    pop_free(block);
+    while (from > c) {
+        from--;
+        push_free(block + (kMinBlock << from), from);
+    }
+    return block;
+}
+
+void SharedMemoryLRU::release(uint64_t block, uint8_t size_class) {
+    shm_header &h = header();
+    std::size_t c = size_class;
+    while (c + 1 < kSizeClasses) {
+        // Buddy starts some block, it is merged only if that is the whole free buddy
+        uint64_t buddy = h.arena + ((block - h.arena) ^ (kMinBlock << c));
+        if (buddy + (kMinBlock << c) > h.size || free_block(buddy).marker != kFreeMarker ||
+            free_block(buddy).size_class != c) {
+            break;
+        }
+        pop_free(buddy);
+        block = std::min(block, buddy);
+        c++;
+    }
+    push_free(block, c);
+}
+
+void SharedMemoryLRU::push_free(uint64_t block, uint8_t size_class) {
+    shm_header &h = header();
+    shm_free &f = free_block(block);
+    f.marker = kFreeMarker;
+    f.size_class = size_class;
+    f.prev = 0;
+    f.next = h.free[size_class];
+    if (f.next != 0) {
+        free_block(f.next).prev = block;
+    }
+    h.free[size_class] = block;
+}
+
+void SharedMemoryLRU::pop_free(uint64_t block) {
+    shm_header &h = header();
+    shm_free &f = free_block(block);
+    if (f.prev != 0) {
+        free_block(f.prev).next = f.next;
+    } else {
+        h.free[f.size_class] = f.next;
+    }
+    if (f.next != 0) {
+        free_block(f.next).prev = f.prev;
+    }
+    f.marker = 0;
+}
+
+void SharedMemoryLRU::unlink(shm_node &node) {
+    shm_header &h = header();
+    if (node.prev != 0) {
+        this->node(node.prev).next = node.next;
+    } else {
+        h.head = node.next;
+    }
+    if (node.next != 0) {
+        this->node(node.next).prev = node.prev;
+    } else {
+        h.tail = node.prev;
+    }
+    node.prev = node.next = 0;
+}
+
+void SharedMemoryLRU::link_tail(shm_node &node) {
+    shm_header &h = header();
+    node.prev = h.tail;
+    node.next = 0;
+    if (h.tail != 0) {
+        this->node(h.tail).next = offset(node);
+    } else {
+        h.head = offset(node);
+    }
+    h.tail = offset(node);
+}
+
+SharedMemoryLRU::shm_node *SharedMemoryLRU::find_node(const HashedKey &key) {
+    for (uint64_t off = bucket(key.hash); off != 0;) {
+        shm_node &n = node(off);
+        if (n.hash == key.hash && n.key_size == key.key.size() &&
+            std::memcmp(n.key(), key.key.data(), key.key.size()) == 0) {
+            if (n.expire != 0 && n.expire <= std::time(nullptr)) {
+                remove_node(n);
+                return nullptr;
+            }
+            return &n;
+        }
+        off = n.chain;
+    }
+    return nullptr;
+}
+
+void SharedMemoryLRU::remove_node(shm_node &node) {
+    uint64_t off = offset(node);
+    uint64_t *link = &bucket(node.hash);
+    while (*link != off) {
+        link = &this->node(*link).chain;
+    }
+    *link = node.chain;
+
+    unlink(node);
+    release(off, node.size_class);
+    header().count--;
+}
+
+SharedMemoryLRU::shm_node *SharedMemoryLRU::add_node(const HashedKey &key, StringRef value, uint32_t expire,
+                                                     uint32_t flags) {
+    shm_header &h = header();
+    std::size_t need = sizeof(shm_node) + key.key.size() + value.size();
+    if (EntrySize(key.key.size(), value.size()) > kMinBlock << top_class()) {
+        return nullptr;
+    }
+
+    // Once everything is evicted the whole arena is free and merged, so entry always fits in the end
+    uint64_t block;
+    while ((block = allocate(need)) == 0 && h.head != 0) {
+        shm_node &victim = node(h.head);
+        evicted(StringRef(victim.key(), victim.key_size));
+        remove_node(victim);
+    }
+    if (block == 0) {
+        return nullptr;
+    }
+
+    shm_node &n = node(block);
+    n.hash = key.hash;
+    n.version = ++h.versions;
+    n.key_size = key.key.size();
+    n.value_size = value.size();
+    n.expire = expire;
+    n.flags = flags;
+    n.size_class = size_class(need);
+    std::memcpy(n.key(), key.key.data(), key.key.size());
+    std::memcpy(n.value(), value.data(), value.size());
+
+    uint64_t &head = bucket(key.hash);
+    n.chain = head;
+    head = block;
+    link_tail(n);
+    h.count++;
+    return &n;
+}
+
+SharedMemoryLRU::shm_node *SharedMemoryLRU::set_node(shm_node &node, StringRef value, uint32_t expire,
+                                                     uint32_t flags) {
+    if (sizeof(shm_node) + node.key_size + value.size() <= kMinBlock << node.size_class) {
+        std::memcpy(node.value(), value.data(), value.size());
+        node.value_size = value.size();
+        node.expire = expire;
+        node.flags = flags;
+        node.version = ++header().versions;
+        unlink(node);
+        link_tail(node);
+        return &node;
+    }
+
+    // Node is freed first, so its block could be reused right away
+    std::string key(node.key(), node.key_size);
+    HashedKey hashed(key);
+    remove_node(node);
+    return add_node(hashed, value, expire, flags);
+}
+
+bool SharedMemoryLRU::store(const HashedKey &key, const std::string &value, const Meta &meta, bool if_absent,
+                            bool if_present) {
+    if (EntrySize(key.key.size(), value.size()) > header().size - header().arena) {
+        return false;
+    }
+
+    shm_node *node = find_node(key);
+    if ((if_absent && node != nullptr) || (if_present && node == nullptr)) {
+        return false;
+    }
+    if (meta.expired(std::time(nullptr))) {
+        if (node != nullptr) {
+            remove_node(*node);
+        }
+    } else if (node != nullptr) {
+        set_node(*node, value, expire_of(meta), meta.flags);
+    } else {
+        add_node(key, value, expire_of(meta), meta.flags);
+    }
+    return true;
+}
+
+// See MapBasedGlobalLockImpl.h
+bool SharedMemoryLRU::Put(const std::string &key, const std::string &value) { return Put(key, value, Meta()); }
+
+// See MapBasedGlobalLockImpl.h
+bool SharedMemoryLRU::Put(const std::string &key, const std::string &value, const Meta &meta) {
+    return Put(StringRef(key), value, meta);
+}
+
+// See MapBasedGlobalLockImpl.h
+bool SharedMemoryLRU::Put(StringRef key, const std::string &value, const Meta &meta) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    return store(HashedKey(key), value, meta, false, false);
+}
+
+// See MapBasedGlobalLockImpl.h
+bool SharedMemoryLRU::PutIfAbsent(const std::string &key, const std::string &value) {
+    return PutIfAbsent(key, value, Meta());
+}
+
+// See MapBasedGlobalLockImpl.h
+bool SharedMemoryLRU::PutIfAbsent(const std::string &key, const std::string &value, const Meta &meta) {
+    return PutIfAbsent(StringRef(key), value, meta);
+}
+
+// See MapBasedGlobalLockImpl.h
+bool SharedMemoryLRU::PutIfAbsent(StringRef key, const std::string &value, const Meta &meta) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    return store(HashedKey(key), value, meta, true, false);
+}
+
+// See MapBasedGlobalLockImpl.h
+bool SharedMemoryLRU::Set(const std::string &key, const std::string &value) { return Set(key, value, Meta()); }
+
+// See MapBasedGlobalLockImpl.h
+bool SharedMemoryLRU::Set(const std::string &key, const std::string &value, const Meta &meta) {
+    return Set(StringRef(key), value, meta);
+}
+
+// See MapBasedGlobalLockImpl.h
+bool SharedMemoryLRU::Set(StringRef key, const std::string &value, const Meta &meta) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    return store(HashedKey(key), value, meta, false, true);
+}
+
+// See MapBasedGlobalLockImpl.h
+SharedMemoryLRU::CasStatus SharedMemoryLRU::CompareAndSet(const std::string &key, const std::string &value,
+                                                          const Meta &meta, uint64_t version) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (EntrySize(key.size(), value.size()) > header().size - header().arena) {
+        return CasStatus::kNotStored;
+    }
+
+    shm_node *node = find_node(HashedKey(key));
+    if (node == nullptr) {
+        return CasStatus::kNotFound;
+    }
+    if (node->version != version) {
+        return CasStatus::kExists;
+    }
+    if (meta.expired(std::time(nullptr))) {
+        remove_node(*node);
+    } else {
+        set_node(*node, value, expire_of(meta), meta.flags);
+    }
+    return CasStatus::kStored;
+}
+
+bool SharedMemoryLRU::join(const std::string &key, const std::string &data, bool front) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    shm_node *node = find_node(HashedKey(key));
+    if (node == nullptr || EntrySize(key.size(), node->value_size + data.size()) > header().size - header().arena) {
+        return false;
+    }
+
+    std::string value;
+    value.reserve(node->value_size + data.size());
+    if (front) {
+        value.append(data).append(node->value(), node->value_size);
+    } else {
+        value.append(node->value(), node->value_size).append(data);
+    }
+    set_node(*node, value, node->expire, node->flags);
+    return true;
+}
+
+// See MapBasedGlobalLockImpl.h
+bool SharedMemoryLRU::Append(const std::string &key, const std::string &data) { return join(key, data, false); }
+
+// See MapBasedGlobalLockImpl.h
+bool SharedMemoryLRU::Prepend(const std::string &key, const std::string &data) { return join(key, data, true); }
+
+SharedMemoryLRU::CounterStatus SharedMemoryLRU::update_node(const std::string &key, uint64_t delta, bool decrement,
+                                                            uint64_t &value) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    shm_node *node = find_node(HashedKey(key));
+    if (node == nullptr) {
+        return CounterStatus::kNotFound;
+    }
+    if (!parse_counter(node->value(), node->value_size, value)) {
+        return CounterStatus::kNotNumber;
+    }
+    value = count(value, delta, decrement);
+    set_node(*node, std::to_string(value), node->expire, node->flags);
+    return CounterStatus::kUpdated;
+}
+
+// See MapBasedGlobalLockImpl.h
+SharedMemoryLRU::CounterStatus SharedMemoryLRU::Increment(const std::string &key, uint64_t delta, uint64_t &value) {
+    return update_node(key, delta, false, value);
+}
+
+// See MapBasedGlobalLockImpl.h
+SharedMemoryLRU::CounterStatus SharedMemoryLRU::Decrement(const std::string &key, uint64_t delta, uint64_t &value) {
+    return update_node(key, delta, true, value);
+}
+
+// See MapBasedGlobalLockImpl.h
+bool SharedMemoryLRU::Delete(const std::string &key) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    shm_node *node = find_node(HashedKey(key));
+    if (node == nullptr) {
+        return false;
+    }
+    remove_node(*node);
+    return true;
+}
+
+// See MapBasedGlobalLockImpl.h
+bool SharedMemoryLRU::Get(const std::string &key, std::string &value) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    shm_node *node = find_node(HashedKey(key));
+    if (node == nullptr) {
+        return false;
+    }
+    value.assign(node->value(), node->value_size);
+    unlink(*node);
+    link_tail(*node);
+    return true;
+}
+
+// See MapBasedGlobalLockImpl.h
+std::size_t SharedMemoryLRU::MultiGet(const std::vector<StringRef> &keys, std::vector<ValueRef> &values,
+                                      std::vector<Meta> *metas, bool versions) {
+    values.resize(keys.size());
+    if (metas != nullptr) {
+        metas->assign(keys.size(), Meta());
+    }
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    std::size_t found = 0;
+    for (std::size_t i = 0; i < keys.size(); i++) {
+        values[i].reset();
+        shm_node *node = find_node(HashedKey(keys[i]));
+        if (node != nullptr) {
+            // Mapping could be detached before the handle is released, so value is copied
+            values[i] = ValueRef::Copy(std::string(node->value(), node->value_size));
+            if (metas != nullptr) {
+                (*metas)[i].expire = node->expire;
+                (*metas)[i].version = node->version;
+                (*metas)[i].flags = node->flags;
+            }
+            unlink(*node);
+            link_tail(*node);
+            found++;
+        }
+    }
+    return found;
+}
+
+// See MapBasedGlobalLockImpl.h
+bool SharedMemoryLRU::Export(const std::function<void(Item &item)> &visit) {
+    std::vector<Item> items;
+    for (std::size_t first = 0;; first += kExportBuckets) {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            std::size_t buckets = header().buckets;
+            if (first >= buckets) {
+                break;
+            }
+
+            int64_t now = std::time(nullptr);
+            for (std::size_t b = first; b < first + kExportBuckets && b < buckets; b++) {
+                for (uint64_t off = bucket(b); off != 0; off = node(off).chain) {
+                    shm_node &n = node(off);
+                    if (n.expire != 0 && n.expire <= now) {
+                        continue;
+                    }
+
+                    Meta meta;
+                    meta.expire = n.expire;
+                    meta.version = n.version;
+                    meta.flags = n.flags;
+                    items.emplace_back(std::string(n.key(), n.key_size),
+                                       ValueRef::Copy(std::string(n.value(), n.value_size)), meta);
+                }
+            }
+        }
+        for (Item &item : items) {
+            visit(item);
+        }
+        items.clear();
+    }
+    return true;
+}
+
+// See MapBasedGlobalLockImpl.h
+uint64_t SharedMemoryLRU::Scan(uint64_t cursor, std::size_t count, std::vector<std::string> &keys) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    std::size_t buckets = header().buckets;
+    int64_t now = std::time(nullptr);
+    std::size_t batch = std::max<std::size_t>(count, 1);
+    std::size_t wanted = keys.size() + batch;
+    for (std::size_t visited = 0; cursor < buckets && visited < batch && keys.size() < wanted; visited++, cursor++) {
+        for (uint64_t off = bucket(cursor); off != 0; off = node(off).chain) {
+            shm_node &n = node(off);
+            if (n.expire == 0 || n.expire > now) {
+                keys.emplace_back(n.key(), n.key_size);
+            }
+        }
+    }
+    return cursor < buckets ? cursor : 0;
+}
+
+// See SharedMemoryLRU.h
+std::size_t SharedMemoryLRU::size() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    return header().count;
+}
+
+} // namespace Backend
+} // namespace Afina
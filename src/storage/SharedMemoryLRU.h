@@ -0,0 +1,255 @@
+#ifndef AFINA_STORAGE_SHARED_MEMORY_LRU_H
+#define AFINA_STORAGE_SHARED_MEMORY_LRU_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <afina/Storage.h>
+
+#include "KeyHash.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # LRU resident in a file mapping
+ * Thread safe implementation with global mutex. Everything storage has - header, hash table and entries -
+ * lives in a single shared mapping of the file at given path, typically on tmpfs like /dev/shm. Structures
+ * refer each other by offsets from the start of the mapping instead of pointers, so the mapping could be
+ * attached at any address. Once process detaches, the next one that opens the same file gets all entries back
+ * right away, without any load: that is how server is restarted warm after an upgrade.
+ *
+ * Entries are allocated from the arena by power of two size classes with the buddy system: free block of a
+ * larger class is split in halves, freed block merges with its buddy, the other half, once both are free. So
+ * memory moves between classes as the mix of entry sizes changes. Allocation that finds no free block large
+ * enough evicts the least recently used entries only until their blocks merge into one that fits.
+ *
+ * Single process could be attached at a time, guarded by file lock. Header records if process has detached
+ * cleanly: mapping left by a crashed process may be inconsistent, as well as one of an incompatible layout or
+ * size, so such mapping is cleared on attach.
+ *
+ * Unlike other storages, expired entries are not tracked by a TimerWheel: wheel links nodes and keeps its
+ * slots by pointers, which do not survive attach at another address. Expired entry is dropped once its key is
+ * looked up, otherwise it stays until eviction reaches it.
+ */
+class SharedMemoryLRU : public Afina::Storage {
+public:
+    /**
+     * Attaches storage in the file at path, creating it if needed. Throws std::runtime_error if the file
+     * couldn't be mapped or is attached by another process.
+     *
+     * @param path of the file to keep storage in
+     * @param size of the file, in bytes, the arena takes all of it but header and hash table
+     */
+    SharedMemoryLRU(const std::string &path, std::size_t size = 64 << 20);
+    ~SharedMemoryLRU();
+
+    // Implements Afina::Storage interface
+    bool Put(const std::string &key, const std::string &value) override;
+
+    // Implements Afina::Storage interface
+    bool Put(const std::string &key, const std::string &value, const Meta &meta) override;
+
+    // Implements Afina::Storage interface
+    bool Put(StringRef key, const std::string &value, const Meta &meta) override;
+
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(const std::string &key, const std::string &value) override;
+
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(const std::string &key, const std::string &value, const Meta &meta) override;
+
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(StringRef key, const std::string &value, const Meta &meta) override;
+
+    // Implements Afina::Storage interface
+    bool Set(const std::string &key, const std::string &value) override;
+
+    // Implements Afina::Storage interface
+    bool Set(const std::string &key, const std::string &value, const Meta &meta) override;
+
+    // Implements Afina::Storage interface
+    bool Set(StringRef key, const std::string &value, const Meta &meta) override;
+
+    // Implements Afina::Storage interface
+    CasStatus CompareAndSet(const std::string &key, const std::string &value, const Meta &meta,
+                            uint64_t version) override;
+
+    // Implements Afina::Storage interface
+    bool Append(const std::string &key, const std::string &data) override;
+
+    // Implements Afina::Storage interface
+    bool Prepend(const std::string &key, const std::string &data) override;
+
+    // Implements Afina::Storage interface
+    CounterStatus Increment(const std::string &key, uint64_t delta, uint64_t &value) override;
+
+    // Implements Afina::Storage interface
+    CounterStatus Decrement(const std::string &key, uint64_t delta, uint64_t &value) override;
+
+    // Implements Afina::Storage interface
+    bool Delete(const std::string &key) override;
+
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, std::string &value) override;
+
+    // MultiGet of std::string keys is the default one
+    using Afina::Storage::MultiGet;
+
+    // Implements Afina::Storage interface
+    std::size_t MultiGet(const std::vector<StringRef> &keys, std::vector<ValueRef> &values,
+                         std::vector<Meta> *metas, bool versions) override;
+
+    // Implements Afina::Storage interface. Parts are ranges of hash table buckets, so order within a part is
+    // arbitrary
+    bool Export(const std::function<void(Item &item)> &visit) override;
+
+    // Implements Afina::Storage interface. Cursor is the number of the hash table bucket, table never grows
+    uint64_t Scan(uint64_t cursor, std::size_t count, std::vector<std::string> &keys) override;
+
+    /**
+     * Number of bytes of the arena single entry with given key and value sizes occupies
+     */
+    static std::size_t EntrySize(std::size_t key_size, std::size_t value_size);
+
+    // Has storage got entries left by the previous process
+    bool attached() const { return _attached; }
+
+    // Number of entries stored
+    std::size_t size();
+
+private:
+    // Allocation size classes: class c holds blocks of kMinBlock << c bytes
+    static constexpr std::size_t kSizeClasses = 40;
+    static constexpr std::size_t kMinBlock = 64;
+
+    // Header at the very beginning of the mapping, offset 0 is never a valid entry so it means none
+    struct shm_header {
+        char magic[8];
+
+        // Layout of the structures, mapping of the other layout is cleared
+        uint32_t layout;
+
+        // Set once process has detached with all structures consistent
+        uint32_t clean;
+
+        uint64_t size;
+        uint64_t buckets;
+
+        // Start of the arena, each block is aligned to its size relative to it
+        uint64_t arena;
+
+        // Heads of the free lists of size classes, see shm_free
+        uint64_t free[kSizeClasses];
+
+        // Eviction list, head is the least recently used entry
+        uint64_t head;
+        uint64_t tail;
+
+        uint64_t count;
+
+        // Last version assigned to an entry, see Meta::version
+        uint64_t versions;
+    };
+
+    // Entry header followed by key bytes and then by value bytes
+    struct shm_node {
+        uint64_t prev;
+        uint64_t next;
+
+        // Next entry of the same hash table bucket
+        uint64_t chain;
+
+        uint64_t hash;
+        uint64_t version;
+        uint32_t key_size;
+        uint32_t value_size;
+
+        // Unix time entry expires at, 0 if never
+        uint32_t expire;
+        uint32_t flags;
+
+        uint8_t size_class;
+
+        char *key() { return reinterpret_cast<char *>(this + 1); }
+        char *value() { return key() + key_size; }
+    };
+
+    // Header of the free block. Entry starts with an offset, so it never has the marker there
+    struct shm_free {
+        uint64_t marker;
+        uint64_t next;
+        uint64_t prev;
+        uint8_t size_class;
+    };
+
+    static constexpr uint64_t kFreeMarker = ~uint64_t(0);
+
+    SharedMemoryLRU(const SharedMemoryLRU &);            // = delete;
+    SharedMemoryLRU &operator=(const SharedMemoryLRU &); // = delete;
+
+    static std::size_t size_class(std::size_t size);
+
+    shm_header &header() { return *reinterpret_cast<shm_header *>(_base); }
+    shm_node &node(uint64_t offset) { return *reinterpret_cast<shm_node *>(_base + offset); }
+    shm_free &free_block(uint64_t offset) { return *reinterpret_cast<shm_free *>(_base + offset); }
+    uint64_t offset(const shm_node &node) const { return reinterpret_cast<const char *>(&node) - _base; }
+    uint64_t &bucket(std::size_t hash) {
+        return reinterpret_cast<uint64_t *>(_base + sizeof(shm_header))[hash & (header().buckets - 1)];
+    }
+
+    // Clears the mapping and lays empty storage out in it
+    void format();
+
+    // Largest size class a block of the arena could have
+    std::size_t top_class();
+
+    // Block of at least size bytes or 0 if there is no free one large enough
+    uint64_t allocate(std::size_t size);
+
+    // Frees the block, merging it with free buddies
+    void release(uint64_t block, uint8_t size_class);
+
+    // Adds block to the free list of its class and takes it from there
+    void push_free(uint64_t block, uint8_t size_class);
+    void pop_free(uint64_t block);
+
+    void unlink(shm_node &node);
+    void link_tail(shm_node &node);
+
+    // Live node with the given key, expired one is removed and treated as absent
+    shm_node *find_node(const HashedKey &key);
+
+    // Removes node from the table and the list and frees it
+    void remove_node(shm_node &node);
+
+    // Stores new entry, key must be absent. Returns nullptr if entry doesn't fit the arena
+    shm_node *add_node(const HashedKey &key, StringRef value, uint32_t expire, uint32_t flags);
+
+    // Replaces value of the node, node is moved if it doesn't fit its block
+    shm_node *set_node(shm_node &node, StringRef value, uint32_t expire, uint32_t flags);
+
+    // Put, PutIfAbsent and Set, lock must be held
+    bool store(const HashedKey &key, const std::string &value, const Meta &meta, bool if_absent, bool if_present);
+
+    // Append and Prepend
+    bool join(const std::string &key, const std::string &data, bool front);
+
+    // Increment and Decrement
+    CounterStatus update_node(const std::string &key, uint64_t delta, bool decrement, uint64_t &value);
+
+    // Mapping and the file behind it
+    char *_base;
+    std::size_t _size;
+    int _fd;
+
+    bool _attached;
+    std::mutex _mutex;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_SHARED_MEMORY_LRU_H
@@ -1,150 +1,945 @@
 #include "SimpleLRU.h"
 
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <stdexcept>
+
+#include "Lz.h"
+#include "NodePool.h"
+
 namespace Afina {
 namespace Backend {
 
+namespace {
+
+// Expiration time as stored in node, meta must not be expired yet
+uint32_t expire_of(const Afina::Storage::Meta &meta) {
+    if (meta.expire >= std::numeric_limits<uint32_t>::max()) {
+        return std::numeric_limits<uint32_t>::max();
+    }
+    return meta.expire;
+}
+
+// Writes decimal digits of the value into the buffer of 20 bytes at least, returns number of digits
+std::size_t format_counter(uint64_t value, char *buffer) {
+    char digits[20];
+    std::size_t size = 0;
+    do {
+        digits[size++] = '0' + value % 10;
+        value /= 10;
+    } while (value != 0);
+    std::reverse_copy(digits, digits + size, buffer);
+    return size;
+}
+
+// Number of modifications storage is considered short of space for after it has failed to borrow from the budget
+const uint64_t kPressureWindow = 64;
+
+// Maximum number of nodes single modification evicts to repay the budget
+const int kRepayNodes = 8;
+
+} // namespace
+
+SimpleLRU::~SimpleLRU() {
+    _lru_index.clear();
+    std::size_t held = _space_left;
+    while (_lru_head != nullptr) {
+        lru_node *next = _lru_head->next;
+        held += node_size(*_lru_head);
+        delete_node(_lru_head);
+        _lru_head = next;
+    }
+    if (_budget != nullptr) {
+        _budget->give(held);
+    }
+}
+
+// See SimpleLRU.h
+std::size_t SimpleLRU::EntrySize(std::size_t key_size, std::size_t value_size) {
+    static_assert(sizeof(lru_node) <= kNodeHeader, "Node header grows per entry overhead of every small entry");
+
+    // Index keeps load factor between 7/16 and 7/8, so account two slots per entry
+    return sizeof(lru_node) + key_size + value_size + 2 * HashIndex<lru_node>::slot_size();
+}
+
+SimpleLRU::lru_node *SimpleLRU::new_node(const char *key, std::size_t key_size, const char *value,
+                                         std::size_t value_size, std::size_t hash, std::size_t capacity) {
+    capacity = std::max(capacity, value_size);
+    void *memory = NodePool::Allocate(sizeof(lru_node) + key_size + capacity);
+    lru_node *node = new (memory) lru_node;
+    node->prev = nullptr;
+    node->next = nullptr;
+    node->hash = hash;
+    node->key_size = key_size;
+    node->value_size = value_size;
+    node->capacity = capacity;
+    node->expire = 0;
+    node->flags = 0;
+    node->raw_size = 0;
+    node->version = 0;
+    node->timer_prev = nullptr;
+    node->timer_next = nullptr;
+    node->timer_slot = 0;
+    node->refs.store(1, std::memory_order_relaxed);
+    node->referenced.store(false, std::memory_order_relaxed);
+    std::memcpy(node->key(), key, key_size);
+    std::memcpy(node->value(), value, value_size);
+    return node;
+}
+
+void SimpleLRU::delete_node(lru_node *node) {
+    if (node->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        std::size_t size = sizeof(lru_node) + node->key_size + node->capacity;
+        node->~lru_node();
+        NodePool::Free(node, size);
+    }
+}
+
+void SimpleLRU::release_node(void *node) { delete_node(static_cast<lru_node *>(node)); }
+
+std::size_t SimpleLRU::node_size(const lru_node &node) { return EntrySize(node.key_size, node.capacity); }
+
+StringRef SimpleLRU::pack(const std::string &value, uint32_t &raw_size) {
+    raw_size = 0;
+    if (_compress_from == 0 || value.size() < _compress_from) {
+        return value;
+    }
+
+    // Value that shrinks less isn't worth decompression on every Get
+    std::size_t capacity = value.size() - value.size() / 8;
+    if (_packed.size() < capacity) {
+        _packed.resize(capacity);
+    }
+    std::size_t size = LzCompress(value.data(), value.size(), &_packed[0], capacity);
+    if (size == 0) {
+        return value;
+    }
+    raw_size = value.size();
+    return StringRef(_packed.data(), size);
+}
+
+void SimpleLRU::unpack(const lru_node &node, std::string &value) {
+    if (node.raw_size == 0) {
+        value.assign(node.value(), node.value_size);
+        return;
+    }
+    value.resize(node.raw_size);
+    if (!LzDecompress(node.value(), node.value_size, &value[0], value.size())) {
+        throw std::runtime_error("Compressed value is corrupted");
+    }
+}
+
+ValueRef SimpleLRU::value_of(lru_node &node) {
+    if (node.raw_size != 0) {
+        std::string value;
+        unpack(node, value);
+        return ValueRef::Copy(std::move(value));
+    }
+    node.refs.fetch_add(1, std::memory_order_relaxed);
+    return ValueRef(node.value(), node.value_size, &node, &release_node);
+}
+
+void SimpleLRU::unlink(lru_node &node) {
+    if (node.prev != nullptr) {
+        node.prev->next = node.next;
+    } else {
+        _lru_head = node.next;
+    }
+
+    if (node.next != nullptr) {
+        node.next->prev = node.prev;
+    } else {
+        _lru_tail = node.prev;
+    }
+    node.prev = nullptr;
+    node.next = nullptr;
+}
+
+void SimpleLRU::link_tail(lru_node &node) {
+    node.prev = _lru_tail;
+    node.next = nullptr;
+    if (_lru_tail != nullptr) {
+        _lru_tail->next = &node;
+    } else {
+        _lru_head = &node;
+    }
+    _lru_tail = &node;
+}
+
+void SimpleLRU::remove_node(lru_node &node) {
+    if (node.expire != 0) {
+        _timers.remove(node);
+    }
+    _space_left += node_size(node);
+    _lru_index.erase(&node);
+    if (_filter != nullptr) {
+        _filter->erase(node.hash);
+    }
+    unlink(node);
+    delete_node(&node);
+}
+
+void SimpleLRU::rebuild_filter() {
+    std::vector<std::size_t> hashes;
+    hashes.reserve(_lru_index.size());
+    for (lru_node *node = _lru_head; node != nullptr; node = node->next) {
+        hashes.push_back(node->hash);
+    }
+    _filter->rebuild(hashes);
+}
+
 void SimpleLRU::free_head() {
-    _space_left += (_lru_head->key.length() + _lru_head->value.length());
-    lru_node* next_head = _lru_head->next.get();
-    _lru_head->next.release();
-    _lru_index.erase(_lru_head->key);
-    _lru_head.reset(next_head);
-}
-
-void SimpleLRU::to_tail(lru_node& node) {
-    if (node.key != _lru_tail->key) {
-        lru_node* next_node = node.next.get();
-        next_node->prev = node.prev;
-        if(_lru_head->key == node.key) {
-            _lru_tail->next.release();
-            _lru_tail->next.reset(_lru_head.get());
-            _lru_head.release();
-            _lru_head.reset(next_node);
+    if (_eviction == Eviction::kClock) {
+        // Second chance: referenced entries go to the tail with bit cleared. Bounded as each node is passed once
+        while (_lru_head->referenced.load(std::memory_order_relaxed)) {
+            _lru_head->referenced.store(false, std::memory_order_relaxed);
+            to_tail(*_lru_head);
         }
-        else {
-            _lru_tail->next.release();
-            _lru_tail->next.reset(node.prev->next.get());
-            node.prev->next.release();
-            node.prev->next.reset(next_node);
+    }
+
+    // Entry demoted to the cold tier is still there, so it isn't reported as evicted
+    lru_node &head = *_lru_head;
+    if (_cold != nullptr && (head.expire == 0 || head.expire > now())) {
+        std::string unpacked;
+        if (head.raw_size != 0) {
+            unpack(head, unpacked);
         }
-        _lru_tail->next->prev = _lru_tail;
-        _lru_tail = _lru_tail->next.get();
-        node.next.release();
+        StringRef value = head.raw_size != 0 ? StringRef(unpacked) : StringRef(head.value(), head.value_size);
+        _cold->Demote(StringRef(head.key(), head.key_size), head.hash, value, head.expire, head.flags);
+    } else {
+        evicted(StringRef(head.key(), head.key_size));
     }
+    remove_node(head);
 }
 
-void SimpleLRU::set_node(lru_node& node, const std::string &value) {
-    to_tail(node);
-    while((value.length() > _space_left + node.value.length())) {
+void SimpleLRU::reserve(std::size_t size, const lru_node *keep) {
+    while (size > _space_left) {
+        if (_budget != nullptr) {
+            // Borrow a step ahead, so budget isn't touched by every modification
+            std::size_t need = size - _space_left;
+            if (_budget->borrow(need + _budget->slack())) {
+                _space_left += need + _budget->slack();
+                return;
+            }
+            if (_budget->borrow(need)) {
+                _space_left += need;
+                return;
+            }
+            if (_lru_head == nullptr || (_lru_head == keep && _lru_tail == keep)) {
+                // Nothing to evict, others repay
+                _budget->overdraw(need);
+                _space_left += need;
+                return;
+            }
+            if (_short_at != _operations + 1) {
+                _budget->want(need);
+                _short_at = _operations + 1;
+            }
+        }
         free_head();
     }
-    _space_left += node.value.length();
-    _space_left -= value.length();
-    node.value = value;
 }
 
-void SimpleLRU::add_node(const std::string &key, const std::string &value) {
-    while(value.length() + key.length() > _space_left) {
-         free_head();
+void SimpleLRU::balance() {
+    if (_budget == nullptr) {
+        return;
+    }
+    _operations++;
+
+    // Debt is repaid by anyone, demand only by storage that hasn't been short of space recently
+    std::size_t owed = _budget->debt();
+    if (_short_at == 0 || _operations - _short_at >= kPressureWindow) {
+        owed = std::max(owed, _budget->owed());
     }
-    if (_lru_head) {
-        _lru_tail->next.reset(new lru_node(key,value));
-        _lru_tail->next->prev = _lru_tail;
-        _lru_tail = _lru_tail->next.get();
-        _lru_index.emplace(_lru_tail->key, *_lru_tail);
-     }
-     else {
-        _lru_head.reset(new lru_node(key,value));
-        _lru_tail = _lru_head.get();
-        _lru_index.emplace(_lru_tail->key, *_lru_tail);
+    for (int i = 0; i < kRepayNodes && _space_left < owed && _lru_head != nullptr; i++) {
+        free_head();
+    }
+
+    std::size_t keep = owed > 0 ? 0 : _budget->slack();
+    if (_space_left > keep) {
+        _budget->give(_space_left - keep);
+        _space_left = keep;
     }
-    _space_left -= (key.length() + value.length());
 }
 
-// See MapBasedGlobalLockImpl.h
-bool SimpleLRU::Put(const std::string& key, const std::string &value) {
-    if(key.length() + value.length() > _max_size) {
-       return false;
+void SimpleLRU::to_tail(lru_node &node) {
+    if (&node != _lru_tail) {
+        unlink(node);
+        link_tail(node);
+    }
+}
+
+void SimpleLRU::touch(lru_node &node) {
+    if (_eviction == Eviction::kLRU) {
+        to_tail(node);
+    } else if (!node.referenced.load(std::memory_order_relaxed)) {
+        // Avoid cache line invalidation if bit is already set
+        node.referenced.store(true, std::memory_order_relaxed);
+    }
+}
+
+void SimpleLRU::set_expire(lru_node &node, uint32_t expire) {
+    if (node.expire == expire) {
+        return;
+    }
+    if (node.expire != 0) {
+        _timers.remove(node);
+    }
+    node.expire = expire;
+    if (expire != 0) {
+        _timers.add(node);
+    }
+}
+
+void SimpleLRU::set_node(lru_node &node, const std::string &value, uint32_t expire, uint32_t flags) {
+    // Updated node must be the last candidate for eviction, also in kClock mode: it goes to the tail referenced
+    to_tail(node);
+    node.referenced.store(true, std::memory_order_relaxed);
+
+    uint32_t raw_size;
+    StringRef stored = pack(value, raw_size);
+
+    // Reuse node memory unless it would waste more than a half of the block or somebody has pinned the value.
+    // New pins are taken under the same lock as this update, so reference count can't grow meanwhile
+    if (stored.size() <= node.capacity && node.capacity <= 2 * stored.size() &&
+        node.refs.load(std::memory_order_acquire) == 1) {
+        std::memcpy(node.value(), stored.data(), stored.size());
+        node.value_size = stored.size();
+        node.raw_size = raw_size;
+        node.flags = flags;
+        node.version = ++_versions;
+        set_expire(node, expire);
+        return;
+    }
+
+    // Node is the freshest one, so it is the last to be evicted here
+    std::size_t old_size = node_size(node);
+    std::size_t new_size = EntrySize(node.key_size, stored.size());
+    if (new_size > old_size) {
+        reserve(new_size - old_size, &node);
+    }
+
+    lru_node *fresh = new_node(node.key(), node.key_size, stored.data(), stored.size(), node.hash);
+    fresh->raw_size = raw_size;
+    fresh->flags = flags;
+    fresh->version = ++_versions;
+    replace_node(node, *fresh, new_size);
+    set_expire(*fresh, expire);
+}
+
+void SimpleLRU::replace_node(lru_node &node, lru_node &fresh, std::size_t new_size) {
+    // Hash of the fresh node is added before the old one's is removed, so filter never misses the key
+    bool room = _filter == nullptr || _filter->insert(fresh.hash);
+    fresh.referenced.store(_eviction == Eviction::kClock, std::memory_order_relaxed);
+    remove_node(node);
+    link_tail(fresh);
+    _lru_index.insert(&fresh);
+    _space_left -= new_size;
+    if (!room) {
+        rebuild_filter();
+    }
+}
+
+bool SimpleLRU::join(const HashedKey &key, const std::string &data, bool front) {
+    int64_t moment = now();
+    expire_nodes(moment);
+
+    lru_node *node = find_or_fetch(key.key, key.hash, moment);
+    std::size_t size = node == nullptr ? 0 : (node->raw_size != 0 ? node->raw_size : node->value_size) + data.size();
+    if (node == nullptr || EntrySize(node->key_size, size) > _max_size) {
+        balance();
+        return false;
     }
-    auto it = _lru_index.find(key);
-    if (it != _lru_index.end()) {
-        lru_node& our_node = it->second.get();
-        set_node(our_node, value);
+
+    if (node->raw_size != 0) {
+        // Compressed value can't grow in place, so it is compressed anew as a whole
+        std::string value;
+        unpack(*node, value);
+        if (front) {
+            value.insert(0, data);
+        } else {
+            value.append(data);
+        }
+        set_node(*node, value, node->expire, node->flags);
+        balance();
+        return true;
     }
-    else {
-        add_node(key, value);
+
+    to_tail(*node);
+    node->referenced.store(true, std::memory_order_relaxed);
+    if (size <= node->capacity && node->refs.load(std::memory_order_acquire) == 1) {
+        if (front) {
+            std::memmove(node->value() + data.size(), node->value(), node->value_size);
+            std::memcpy(node->value(), data.data(), data.size());
+        } else {
+            std::memcpy(node->value() + node->value_size, data.data(), data.size());
+        }
+        node->value_size = size;
+        node->version = ++_versions;
+        balance();
+        return true;
     }
+
+    // Block grows by half, so series of appends moves the value logarithmic number of times only
+    std::size_t capacity = std::min(size + size / 2, _max_size - EntrySize(node->key_size, 0));
+    std::size_t old_size = node_size(*node);
+    std::size_t new_size = EntrySize(node->key_size, capacity);
+    if (new_size > old_size) {
+        reserve(new_size - old_size, node);
+    }
+
+    lru_node *fresh;
+    if (front) {
+        fresh = new_node(node->key(), node->key_size, data.data(), data.size(), node->hash, capacity);
+        std::memcpy(fresh->value() + data.size(), node->value(), node->value_size);
+    } else {
+        fresh = new_node(node->key(), node->key_size, node->value(), node->value_size, node->hash, capacity);
+        std::memcpy(fresh->value() + node->value_size, data.data(), data.size());
+    }
+    fresh->value_size = size;
+    fresh->flags = node->flags;
+    fresh->version = ++_versions;
+
+    uint32_t expire = node->expire;
+    replace_node(*node, *fresh, new_size);
+    set_expire(*fresh, expire);
+    balance();
+    return true;
+}
+
+void SimpleLRU::add_node(StringRef key, const std::string &value, std::size_t hash, uint32_t expire,
+                         uint32_t flags) {
+    if (_cold != nullptr) {
+        // Cold copy is outdated now
+        _cold->Forget(hash);
+    }
+    uint32_t raw_size;
+    StringRef stored = pack(value, raw_size);
+    std::size_t size = EntrySize(key.size(), stored.size());
+    reserve(size, nullptr);
+
+    lru_node *node = new_node(key.data(), key.size(), stored.data(), stored.size(), hash);
+    node->raw_size = raw_size;
+    node->flags = flags;
+    node->version = ++_versions;
+    link_tail(*node);
+    _lru_index.insert(node);
+    set_expire(*node, expire);
+    _space_left -= size;
+    if (_filter != nullptr && !_filter->insert(hash)) {
+        rebuild_filter();
+    }
+}
+
+SimpleLRU::lru_node *SimpleLRU::find_node(StringRef key, std::size_t hash) const {
+    return _lru_index.find(hash, [&](const lru_node &node) {
+        return node.hash == hash && node.key_size == key.size() && std::memcmp(node.key(), key.data(), key.size()) == 0;
+    });
+}
+
+void SimpleLRU::expire_nodes(int64_t now) {
+    if (now <= 0) {
+        return;
+    }
+    _timers.advance(now, [this](lru_node &node) {
+        // Node is out of the wheel already
+        node.expire = 0;
+        remove_node(node);
+    });
+    promote(now);
+}
+
+void SimpleLRU::promote(int64_t now) {
+    if (_cold == nullptr) {
+        return;
+    }
+
+    std::vector<ColdTier::Promotion> promoted;
+    _cold->Take(promoted);
+    for (ColdTier::Promotion &promotion : promoted) {
+        HashedKey key(promotion.key);
+        if ((promotion.expire == 0 || promotion.expire > now) && find_node(key.key, key.hash) == nullptr &&
+            EntrySize(promotion.key.size(), promotion.value.size()) <= _max_size) {
+            add_node(key.key, promotion.value, key.hash, promotion.expire, promotion.flags);
+        }
+    }
+}
+
+SimpleLRU::lru_node *SimpleLRU::find_live_node(StringRef key, std::size_t hash, int64_t now) {
+    lru_node *node = find_node(key, hash);
+    if (node != nullptr && node->expire != 0 && node->expire <= now) {
+        remove_node(*node);
+        return nullptr;
+    }
+    return node;
+}
+
+SimpleLRU::lru_node *SimpleLRU::find_or_fetch(StringRef key, std::size_t hash, int64_t now) {
+    // Values read back already have been promoted by expire_nodes
+    lru_node *node = find_live_node(key, hash, now);
+    if (node == nullptr && _cold != nullptr) {
+        _cold->Fetch(hash, now);
+    }
+    return node;
+}
+
+SimpleLRU::lru_node *SimpleLRU::get_node(StringRef key, std::size_t hash) {
+    lru_node *node = find_node(key, hash);
+    if (node == nullptr && _cold != nullptr) {
+        int64_t moment = now();
+        if (_eviction == Eviction::kLRU) {
+            promote(moment);
+            node = find_node(key, hash);
+        }
+        if (node == nullptr) {
+            // Miss for now, value gets promoted once read
+            _cold->Fetch(hash, moment);
+            return nullptr;
+        }
+    }
+    if (node == nullptr) {
+        return nullptr;
+    }
+
+    if (node->expire != 0 && node->expire <= now()) {
+        // In kClock mode Get must not modify storage, expired node stays until the next modification
+        if (_eviction == Eviction::kLRU) {
+            remove_node(*node);
+        }
+        return nullptr;
+    }
+    touch(*node);
+    return node;
+}
+
+// See MapBasedGlobalLockImpl.h
+bool SimpleLRU::Put(const std::string &key, const std::string &value) { return Put(HashedKey(key), value, Meta()); }
+
+// See MapBasedGlobalLockImpl.h
+bool SimpleLRU::Put(const std::string &key, const std::string &value, const Meta &meta) {
+    return Put(HashedKey(key), value, meta);
+}
+
+// See MapBasedGlobalLockImpl.h
+bool SimpleLRU::Put(StringRef key, const std::string &value, const Meta &meta) {
+    return Put(HashedKey(key), value, meta);
+}
+
+// See SimpleLRU.h
+bool SimpleLRU::Put(const HashedKey &key, const std::string &value, const Meta &meta) {
+    if (EntrySize(key.key.size(), value.size()) > _max_size) {
+        return false;
+    }
+
+    int64_t moment = now();
+    expire_nodes(moment);
+
+    lru_node *node = find_node(key.key, key.hash);
+    if (meta.expired(moment)) {
+        // Association is stored and expires right away, cold copy is outdated as well
+        if (node != nullptr) {
+            remove_node(*node);
+        } else if (_cold != nullptr) {
+            _cold->Forget(key.hash);
+        }
+    } else if (node != nullptr) {
+        set_node(*node, value, expire_of(meta), meta.flags);
+    } else {
+        add_node(key.key, value, key.hash, expire_of(meta), meta.flags);
+    }
+    balance();
     return true;
 }
 
 // See MapBasedGlobalLockImpl.h
 bool SimpleLRU::PutIfAbsent(const std::string &key, const std::string &value) {
-    if(key.length() + value.length() > _max_size) {
-       return false;
+    return PutIfAbsent(HashedKey(key), value, Meta());
+}
+
+// See MapBasedGlobalLockImpl.h
+bool SimpleLRU::PutIfAbsent(const std::string &key, const std::string &value, const Meta &meta) {
+    return PutIfAbsent(HashedKey(key), value, meta);
+}
+
+// See MapBasedGlobalLockImpl.h
+bool SimpleLRU::PutIfAbsent(StringRef key, const std::string &value, const Meta &meta) {
+    return PutIfAbsent(HashedKey(key), value, meta);
+}
+
+// See SimpleLRU.h
+bool SimpleLRU::PutIfAbsent(const HashedKey &key, const std::string &value, const Meta &meta) {
+    if (EntrySize(key.key.size(), value.size()) > _max_size) {
+        return false;
     }
-    auto it = _lru_index.find(key);
-    if (it != _lru_index.end()) {
+
+    int64_t moment = now();
+    expire_nodes(moment);
+
+    // Cold value is there as well, it is requested to be served next time
+    if (find_live_node(key.key, key.hash, moment) != nullptr || (_cold != nullptr && _cold->Fetch(key.hash, moment))) {
+        balance();
         return false;
     }
-    if (it == _lru_index.end()) {
-        add_node(key, value);
+    if (!meta.expired(moment)) {
+        add_node(key.key, value, key.hash, expire_of(meta), meta.flags);
     }
+    balance();
     return true;
 }
 
 // See MapBasedGlobalLockImpl.h
-bool SimpleLRU::Set(const std::string &key, const std::string &value) {
-    if(key.length() + value.length() > _max_size) {
-       return false;
+bool SimpleLRU::Set(const std::string &key, const std::string &value) { return Set(HashedKey(key), value, Meta()); }
+
+// See MapBasedGlobalLockImpl.h
+bool SimpleLRU::Set(const std::string &key, const std::string &value, const Meta &meta) {
+    return Set(HashedKey(key), value, meta);
+}
+
+// See MapBasedGlobalLockImpl.h
+bool SimpleLRU::Set(StringRef key, const std::string &value, const Meta &meta) {
+    return Set(HashedKey(key), value, meta);
+}
+
+// See SimpleLRU.h
+bool SimpleLRU::Set(const HashedKey &key, const std::string &value, const Meta &meta) {
+    if (EntrySize(key.key.size(), value.size()) > _max_size) {
+        return false;
+    }
+
+    int64_t moment = now();
+    expire_nodes(moment);
+
+    lru_node *node = find_live_node(key.key, key.hash, moment);
+    if (node == nullptr) {
+        // Value is replaced as a whole, so cold one isn't read back but just dropped
+        bool cold = _cold != nullptr && _cold->Forget(key.hash);
+        if (cold && !meta.expired(moment)) {
+            add_node(key.key, value, key.hash, expire_of(meta), meta.flags);
+        }
+        balance();
+        return cold;
     }
-    auto it = _lru_index.find(key);
-    if (it == _lru_index.end()) {
+    if (meta.expired(moment)) {
+        remove_node(*node);
+    } else {
+        set_node(*node, value, expire_of(meta), meta.flags);
+    }
+    balance();
+    return true;
+}
+
+SimpleLRU::CounterStatus SimpleLRU::update_node(const HashedKey &key, uint64_t delta, bool decrement,
+                                                uint64_t &value) {
+    int64_t moment = now();
+    expire_nodes(moment);
+
+    lru_node *node = find_or_fetch(key.key, key.hash, moment);
+    if (node == nullptr) {
+        balance();
+        return CounterStatus::kNotFound;
+    }
+    bool number;
+    if (node->raw_size != 0) {
+        std::string current;
+        unpack(*node, current);
+        number = parse_counter(current.data(), current.size(), value);
+    } else {
+        number = parse_counter(node->value(), node->value_size, value);
+    }
+    if (!number) {
+        balance();
+        return CounterStatus::kNotNumber;
+    }
+    value = count(value, delta, decrement);
+
+    char digits[20];
+    std::size_t size = format_counter(value, digits);
+    if (size <= node->capacity && node->refs.load(std::memory_order_acquire) == 1) {
+        to_tail(*node);
+        node->referenced.store(true, std::memory_order_relaxed);
+        std::memcpy(node->value(), digits, size);
+        node->value_size = size;
+        node->raw_size = 0;
+        node->version = ++_versions;
+    } else {
+        set_node(*node, std::string(digits, size), node->expire, node->flags);
+    }
+    balance();
+    return CounterStatus::kUpdated;
+}
+
+// See MapBasedGlobalLockImpl.h
+SimpleLRU::CounterStatus SimpleLRU::Increment(const std::string &key, uint64_t delta, uint64_t &value) {
+    return Increment(HashedKey(key), delta, value);
+}
+
+// See SimpleLRU.h
+SimpleLRU::CounterStatus SimpleLRU::Increment(const HashedKey &key, uint64_t delta, uint64_t &value) {
+    return update_node(key, delta, false, value);
+}
+
+// See MapBasedGlobalLockImpl.h
+SimpleLRU::CounterStatus SimpleLRU::Decrement(const std::string &key, uint64_t delta, uint64_t &value) {
+    return Decrement(HashedKey(key), delta, value);
+}
+
+// See SimpleLRU.h
+SimpleLRU::CounterStatus SimpleLRU::Decrement(const HashedKey &key, uint64_t delta, uint64_t &value) {
+    return update_node(key, delta, true, value);
+}
+
+// See MapBasedGlobalLockImpl.h
+SimpleLRU::CasStatus SimpleLRU::CompareAndSet(const std::string &key, const std::string &value, const Meta &meta,
+                                              uint64_t version) {
+    return CompareAndSet(HashedKey(key), value, meta, version);
+}
+
+// See SimpleLRU.h
+SimpleLRU::CasStatus SimpleLRU::CompareAndSet(const HashedKey &key, const std::string &value, const Meta &meta,
+                                              uint64_t version) {
+    if (EntrySize(key.key.size(), value.size()) > _max_size) {
+        return CasStatus::kNotStored;
+    }
+
+    int64_t moment = now();
+    expire_nodes(moment);
+
+    CasStatus result = CasStatus::kStored;
+    lru_node *node = find_or_fetch(key.key, key.hash, moment);
+    if (node == nullptr) {
+        result = CasStatus::kNotFound;
+    } else if (node->version != version) {
+        result = CasStatus::kExists;
+    } else if (meta.expired(moment)) {
+        remove_node(*node);
+    } else {
+        set_node(*node, value, expire_of(meta), meta.flags);
+    }
+    balance();
+    return result;
+}
+
+// See MapBasedGlobalLockImpl.h
+bool SimpleLRU::Append(const std::string &key, const std::string &data) { return Append(HashedKey(key), data); }
+
+// See SimpleLRU.h
+bool SimpleLRU::Append(const HashedKey &key, const std::string &data) { return join(key, data, false); }
+
+// See MapBasedGlobalLockImpl.h
+bool SimpleLRU::Prepend(const std::string &key, const std::string &data) { return Prepend(HashedKey(key), data); }
+
+// See SimpleLRU.h
+bool SimpleLRU::Prepend(const HashedKey &key, const std::string &data) { return join(key, data, true); }
+
+// See MapBasedGlobalLockImpl.h
+bool SimpleLRU::Delete(const std::string &key) { return Delete(HashedKey(key)); }
+
+// See MapBasedGlobalLockImpl.h
+bool SimpleLRU::Delete(StringRef key) { return Delete(HashedKey(key)); }
+
+// See SimpleLRU.h
+bool SimpleLRU::Delete(const HashedKey &key) {
+    int64_t moment = now();
+    expire_nodes(moment);
+
+    lru_node *node = find_live_node(key.key, key.hash, moment);
+    if (node == nullptr) {
+        bool cold = _cold != nullptr && _cold->Forget(key.hash);
+        balance();
+        return cold;
+    }
+    remove_node(*node);
+    balance();
+    return true;
+}
+
+// See MapBasedGlobalLockImpl.h
+bool SimpleLRU::Get(const std::string &key, std::string &value) { return Get(HashedKey(key), value); }
+
+// See MapBasedGlobalLockImpl.h
+bool SimpleLRU::Get(StringRef key, std::string &value) { return Get(HashedKey(key), value); }
+
+// See SimpleLRU.h
+bool SimpleLRU::Get(const HashedKey &key, std::string &value) {
+    lru_node *node = get_node(key.key, key.hash);
+    if (node == nullptr) {
         return false;
     }
-    if (it != _lru_index.end()) {
-        lru_node& our_node = it->second.get();
-        set_node(our_node, value);
+    unpack(*node, value);
+    return true;
+}
+
+// See MapBasedGlobalLockImpl.h
+bool SimpleLRU::Get(const std::string &key, ValueRef &value) { return Get(HashedKey(key), value); }
+
+// See MapBasedGlobalLockImpl.h
+bool SimpleLRU::Get(StringRef key, ValueRef &value) { return Get(HashedKey(key), value); }
+
+// See SimpleLRU.h
+bool SimpleLRU::Get(const HashedKey &key, ValueRef &value) {
+    lru_node *node = get_node(key.key, key.hash);
+    if (node == nullptr) {
+        return false;
     }
+    value = value_of(*node);
     return true;
 }
 
 // See MapBasedGlobalLockImpl.h
-bool SimpleLRU::Delete(const std::string &key) {
-    auto it = _lru_index.find(key);
-    if(it == _lru_index.end()) {
-            return false;
+std::size_t SimpleLRU::MultiGet(const std::vector<StringRef> &keys, std::vector<ValueRef> &values,
+                                std::vector<Meta> *metas, bool versions) {
+    std::vector<HashedKey> hashed;
+    std::vector<std::size_t> positions(keys.size());
+    hashed.reserve(keys.size());
+    for (std::size_t i = 0; i < keys.size(); i++) {
+        hashed.emplace_back(keys[i]);
+        positions[i] = i;
+    }
+    values.resize(keys.size());
+    if (metas != nullptr) {
+        metas->resize(keys.size());
+    }
+    return MultiGet(hashed, positions, values, metas);
+}
+
+// See SimpleLRU.h
+std::size_t SimpleLRU::MultiGet(const std::vector<HashedKey> &keys, const std::vector<std::size_t> &positions,
+                                std::vector<ValueRef> &values, std::vector<Meta> *metas) {
+    // Index memory of all keys is requested before the first lookup, so cache misses overlap
+    for (std::size_t position : positions) {
+        _lru_index.prefetch(keys[position].hash);
+    }
+
+    std::size_t found = 0;
+    for (std::size_t position : positions) {
+        ValueRef &value = values[position];
+        value.reset();
+
+        lru_node *node = get_node(keys[position].key, keys[position].hash);
+        if (node != nullptr) {
+            value = value_of(*node);
+            if (metas != nullptr) {
+                (*metas)[position].expire = node->expire;
+                (*metas)[position].version = node->version;
+                (*metas)[position].flags = node->flags;
+            }
+            found++;
+        }
     }
-    lru_node& our_node = it->second.get();
-    _space_left += key.length() + our_node.value.length();
-    lru_node* next_node = our_node.next.get();
-    _lru_index.erase(it);
-    if(next_node) {
-        next_node->prev = our_node.prev;
+    return found;
+}
+
+// See MapBasedGlobalLockImpl.h
+std::size_t SimpleLRU::MultiPut(const std::vector<std::string> &keys, const std::vector<std::string> &values) {
+    std::vector<HashedKey> hashed;
+    std::vector<std::size_t> positions(std::min(keys.size(), values.size()));
+    hashed.reserve(positions.size());
+    for (std::size_t i = 0; i < positions.size(); i++) {
+        hashed.emplace_back(keys[i]);
+        positions[i] = i;
     }
-    else {
-        _lru_tail = our_node.prev;
+    return MultiPut(hashed, values, positions);
+}
+
+// See SimpleLRU.h
+std::size_t SimpleLRU::MultiPut(const std::vector<HashedKey> &keys, const std::vector<std::string> &values,
+                                const std::vector<std::size_t> &positions) {
+    for (std::size_t position : positions) {
+        _lru_index.prefetch(keys[position].hash);
     }
-    if(_lru_head->key == key) {
-        _lru_head->next.release();
-        _lru_head.reset(next_node);
+
+    std::size_t stored = 0;
+    for (std::size_t position : positions) {
+        if (SimpleLRU::Put(keys[position], values[position], Meta())) {
+            stored++;
+        }
     }
-    else {
-        our_node.prev->next.reset(next_node);
+    return stored;
+}
+
+// See MapBasedGlobalLockImpl.h
+bool SimpleLRU::Export(const std::function<void(Item &item)> &visit) {
+    std::vector<Item> items;
+    Collect(items);
+    for (Item &item : items) {
+        visit(item);
     }
     return true;
 }
 
 // See MapBasedGlobalLockImpl.h
-bool SimpleLRU::Get(const std::string &key, std::string &value) {
-    auto it = _lru_index.find(key);
-    if(it == _lru_index.end()) {
-            return false;
-     }
-     lru_node& our_node = it->second.get();
-     value = our_node.value;
-     to_tail(our_node);
-     return true;
-  }
+uint64_t SimpleLRU::Scan(uint64_t cursor, std::size_t count, std::vector<std::string> &keys) {
+    int64_t moment = now();
+    std::size_t batch = std::max<std::size_t>(count, 1);
+    std::size_t wanted = keys.size() + batch;
+    for (std::size_t groups = 0; groups < batch && keys.size() < wanted; groups++) {
+        cursor = _lru_index.scan(cursor, [&](const lru_node &node) {
+            if (node.expire == 0 || node.expire > moment) {
+                keys.emplace_back(node.key(), node.key_size);
+            }
+        });
+        if (cursor == 0) {
+            break;
+        }
+    }
+    return cursor;
+}
+
+// See SimpleLRU.h
+bool SimpleLRU::MoveTo(const HashedKey &key, SimpleLRU &target) {
+    int64_t moment = now();
+    expire_nodes(moment);
+
+    lru_node *node = find_live_node(key.key, key.hash, moment);
+    if (node == nullptr) {
+        balance();
+        return false;
+    }
+
+    std::string value;
+    unpack(*node, value);
+    Meta meta;
+    meta.expire = node->expire;
+    meta.version = node->version;
+    meta.flags = node->flags;
+    target.Adopt(key, value, meta);
+
+    remove_node(*node);
+    balance();
+    return true;
+}
+
+// See SimpleLRU.h
+bool SimpleLRU::Adopt(const HashedKey &key, const std::string &value, const Meta &meta) {
+    _versions = std::max(_versions, meta.version);
+    if (!SimpleLRU::Put(key, value, meta)) {
+        return false;
+    }
+
+    lru_node *node = find_node(key.key, key.hash);
+    if (node != nullptr) {
+        node->version = meta.version;
+    }
+    return true;
+}
+
+// See SimpleLRU.h
+void SimpleLRU::Collect(std::vector<Item> &items) {
+    int64_t moment = now();
+    for (lru_node *node = _lru_head; node != nullptr; node = node->next) {
+        if (node->expire != 0 && node->expire <= moment) {
+            continue;
+        }
+
+        Meta meta;
+        meta.expire = node->expire;
+        meta.version = node->version;
+        meta.flags = node->flags;
+        items.emplace_back(std::string(node->key(), node->key_size), value_of(*node), meta);
+    }
+}
 
 } // namespace Backend
 } // namespace Afina
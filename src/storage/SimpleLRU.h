@@ -1,86 +1,439 @@
 #ifndef AFINA_STORAGE_SIMPLE_LRU_H
 #define AFINA_STORAGE_SIMPLE_LRU_H
 
-#include <map>
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <vector>
 
 #include <afina/Storage.h>
 
+#include "ColdTier.h"
+#include "CuckooFilter.h"
+#include "HashIndex.h"
+#include "KeyHash.h"
+#include "MemoryBudget.h"
+#include "TimerWheel.h"
+
 namespace Afina {
 namespace Backend {
 
 /**
- * # Map based implementation
+ * # Hash index based implementation
  * That is NOT thread safe implementaiton!!
+ *
+ * Supports two eviction modes:
+ * - kLRU: every access moves entry to the list tail, the least recently used entry is evicted first
+ * - kClock: CLOCK/second chance approximation of LRU. Get only sets a reference bit of the entry, eviction
+ *   gives referenced entries one more round instead of dropping them. In this mode Get never modifies the list
+ *   or index, so concurrent Get calls are safe as long as nobody modifies storage
+ *
+ * Entries with expiration time are tracked by the timer wheel which is advanced by every modification, so
+ * expired entries get dropped in O(1) amortized time without scans. Also expired entry is never returned: it
+ * is treated as absent once found by any operation.
+ *
+ * Every operation has StringRef key overload, which never copies the key: lookup compares bytes in place and
+ * new node copies them right into its memory block. Both std::string and StringRef overloads just hash the key and
+ * forward to HashedKey ones.
+ *
+ * Append and Prepend grow value right in the node block if it has room and nobody has pinned the value, blocks
+ * allocated by them get extra room for the next ones. Increment and Decrement rewrite digits in place as well.
+ *
+ * Nodes are reference counted: storage holds one reference and every ValueRef returned by Get another one. Node
+ * removed while pinned is freed by the last handle, and pinned node value is never updated in place. Blocks of
+ * small nodes come from the NodePool, so tiny entries don't pay general allocator overhead. What they still pay is
+ * the node header, kNodeHeader bytes of links, hash, sizes and version, and two index slots, about a hundred bytes
+ * per entry in total.
+ *
+ * Storage could take its space from MemoryBudget shared with other storages instead of the fixed max_size:
+ * it borrows bytes from the budget before evicting anything, returns bytes it doesn't need and, unless it has
+ * been short of space recently itself, evicts its entries in favour of storages that are.
+ *
+ * Entries evicted could be demoted to the ColdTier instead of being dropped. Get of the key found only there
+ * misses, but requests the value back: once read it is promoted by the next modification or, in kLRU mode, the
+ * next Get. Modifications that need the current value, like Append or CompareAndSet, miss and request it the
+ * same way, PutIfAbsent fails on it, while Set and Put just replace the cold copy. Export doesn't see cold values.
+ *
+ * Values of compress_from bytes or more are stored compressed by the LZ codec, see Lz.h, if that saves at least
+ * an eighth of them. Budget accounts the compressed size, so compressible values take less space. Get of such
+ * value decompresses it into a copy instead of pinning the node, modifications other than Put and Set decompress
+ * it and store the result anew.
+ *
+ * Storage could also keep CuckooFilter of the key hashes, which tells keys certainly absent without any lock, see
+ * MayContain. Filter is not kept along with the cold tier, as miss there must request the value.
  */
 class SimpleLRU : public Afina::Storage {
 public:
-    SimpleLRU(size_t max_size = 1024) : _max_size(max_size) {
-        _space_left = _max_size;
+    enum class Eviction { kLRU, kClock };
+
+    /**
+     * @param max_size maximum number of bytes entries could occupy, see EntrySize
+     * @param eviction eviction mode
+     * @param budget budget to take space from, if any. Must outlive the storage, which never holds more than
+     * max_size bytes of it
+     * @param cold tier to demote evicted entries to, if any. Must outlive the storage and serve no other one
+     * @param compress_from minimal size of the value to compress, 0 means values are never compressed
+     * @param filter keep the filter of key hashes, see MayContain
+     */
+    SimpleLRU(size_t max_size = 1024, Eviction eviction = Eviction::kLRU, MemoryBudget *budget = nullptr,
+              ColdTier *cold = nullptr, size_t compress_from = 0, bool filter = false)
+        : _max_size(max_size), _eviction(eviction), _lru_head(nullptr), _lru_tail(nullptr),
+          _timers(std::time(nullptr)), _budget(budget), _cold(cold),
+          _filter(filter && cold == nullptr ? new CuckooFilter() : nullptr), _compress_from(compress_from),
+          _versions(0), _operations(0), _short_at(0) {
+        _space_left = _budget == nullptr ? _max_size : 0;
     }
 
-    ~SimpleLRU() {
-        _lru_index.clear();
-        if (_lru_head) {
-            lru_node* node_to_delete = _lru_tail;
-            while(node_to_delete != _lru_head.get())
-            {
-                lru_node* t = node_to_delete->prev;
-                t->next.reset();
-                node_to_delete = t;
-            }
-            _lru_head.reset();
-        }
-    }  
+    ~SimpleLRU();
 
     // Implements Afina::Storage interface
     bool Put(const std::string &key, const std::string &value) override;
 
+    // Implements Afina::Storage interface
+    bool Put(const std::string &key, const std::string &value, const Meta &meta) override;
+
+    // Implements Afina::Storage interface
+    bool Put(StringRef key, const std::string &value, const Meta &meta) override;
+
     // Implements Afina::Storage interface
     bool PutIfAbsent(const std::string &key, const std::string &value) override;
 
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(const std::string &key, const std::string &value, const Meta &meta) override;
+
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(StringRef key, const std::string &value, const Meta &meta) override;
+
     // Implements Afina::Storage interface
     bool Set(const std::string &key, const std::string &value) override;
 
+    // Implements Afina::Storage interface
+    bool Set(const std::string &key, const std::string &value, const Meta &meta) override;
+
+    // Implements Afina::Storage interface
+    bool Set(StringRef key, const std::string &value, const Meta &meta) override;
+
+    // Implements Afina::Storage interface
+    bool Append(const std::string &key, const std::string &data) override;
+
+    // Implements Afina::Storage interface
+    bool Prepend(const std::string &key, const std::string &data) override;
+
+    // Implements Afina::Storage interface
+    CounterStatus Increment(const std::string &key, uint64_t delta, uint64_t &value) override;
+
+    // Implements Afina::Storage interface
+    CounterStatus Decrement(const std::string &key, uint64_t delta, uint64_t &value) override;
+
     // Implements Afina::Storage interface
     bool Delete(const std::string &key) override;
 
+    // Implements Afina::Storage interface
+    bool Delete(StringRef key) override;
+
     // Implements Afina::Storage interface
     bool Get(const std::string &key, std::string &value) override;
 
-private:
-    void free_head();  
+    // Implements Afina::Storage interface
+    bool Get(StringRef key, std::string &value) override;
+
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, ValueRef &value) override;
+
+    // Implements Afina::Storage interface
+    bool Get(StringRef key, ValueRef &value) override;
+
+    // MultiGet of std::string keys is the default one
+    using Afina::Storage::MultiGet;
+
+    // Implements Afina::Storage interface
+    std::size_t MultiGet(const std::vector<StringRef> &keys, std::vector<ValueRef> &values,
+                         std::vector<Meta> *metas, bool versions) override;
+
+    // Implements Afina::Storage interface
+    std::size_t MultiPut(const std::vector<std::string> &keys, const std::vector<std::string> &values) override;
+
+    // Implements Afina::Storage interface
+    CasStatus CompareAndSet(const std::string &key, const std::string &value, const Meta &meta,
+                            uint64_t version) override;
+
+    // Implements Afina::Storage interface, the whole storage is a single part
+    bool Export(const std::function<void(Item &item)> &visit) override;
+
+    // Implements Afina::Storage interface. Keys come in the order of index groups, see HashIndex::scan, and each
+    // call visits count groups at most
+    uint64_t Scan(uint64_t cursor, std::size_t count, std::vector<std::string> &keys) override;
+
+    /**
+     * Same as Put, but key hash is already known. All other overloads end up here, so subclasses could wrap
+     * the operation overriding these methods only
+     */
+    virtual bool Put(const HashedKey &key, const std::string &value, const Meta &meta);
+
+    /**
+     * Same as PutIfAbsent, but key hash is already known, see Put
+     */
+    virtual bool PutIfAbsent(const HashedKey &key, const std::string &value, const Meta &meta);
+
+    /**
+     * Same as Set, but key hash is already known, see Put
+     */
+    virtual bool Set(const HashedKey &key, const std::string &value, const Meta &meta);
+
+    /**
+     * Same as CompareAndSet, but key hash is already known, see Put
+     */
+    virtual CasStatus CompareAndSet(const HashedKey &key, const std::string &value, const Meta &meta,
+                                    uint64_t version);
+
+    /**
+     * Same as Append, but key hash is already known, see Put
+     */
+    virtual bool Append(const HashedKey &key, const std::string &data);
+
+    /**
+     * Same as Prepend, but key hash is already known, see Put
+     */
+    virtual bool Prepend(const HashedKey &key, const std::string &data);
+
+    /**
+     * Same as Increment, but key hash is already known, see Put
+     */
+    virtual CounterStatus Increment(const HashedKey &key, uint64_t delta, uint64_t &value);
+
+    /**
+     * Same as Decrement, but key hash is already known, see Put
+     */
+    virtual CounterStatus Decrement(const HashedKey &key, uint64_t delta, uint64_t &value);
+
+    /**
+     * Same as Delete, but key hash is already known, see Put
+     */
+    virtual bool Delete(const HashedKey &key);
+
+    /**
+     * Same as Get, but key hash is already known, see Put
+     */
+    virtual bool Get(const HashedKey &key, std::string &value);
+
+    /**
+     * Same as Get, but key hash is already known, see Put
+     */
+    virtual bool Get(const HashedKey &key, ValueRef &value);
 
-    // LRU cache node
+    /**
+     * Same as MultiGet, but for keys at given positions only, other values are left untouched. Lets sharded
+     * storage hand each shard its part of the batch along with hashes it has computed already. Attributes are
+     * returned only if metas isn't null
+     */
+    virtual std::size_t MultiGet(const std::vector<HashedKey> &keys, const std::vector<std::size_t> &positions,
+                                 std::vector<ValueRef> &values, std::vector<Meta> *metas);
+
+    /**
+     * Same as MultiPut, but for keys at given positions only
+     */
+    virtual std::size_t MultiPut(const std::vector<HashedKey> &keys, const std::vector<std::string> &values,
+                                 const std::vector<std::size_t> &positions);
+
+    /**
+     * Appends all live entries to items, the least recently used first, see Export. Values are pinned, so only
+     * keys are copied. Doesn't modify storage, so it is as cheap for the readers as MultiGet
+     */
+    virtual void Collect(std::vector<Item> &items);
+
+    /**
+     * Moves live entry of the key into target storage along with its attributes, see Adopt. Returns false if
+     * there is no such entry. Lets sharded storage move entries from shard to shard
+     */
+    virtual bool MoveTo(const HashedKey &key, SimpleLRU &target);
+
+    /**
+     * Same as Put, but entry keeps the version it has got in the storage it is moved from, see MoveTo. Versions
+     * assigned to entries afterwards are greater, so version of the key never repeats
+     */
+    virtual bool Adopt(const HashedKey &key, const std::string &value, const Meta &meta);
+
+    /**
+     * Number of bytes of the storage budget single entry with given key and value sizes occupies:
+     * node header, key, value and the share of the hash index
+     */
+    static std::size_t EntrySize(std::size_t key_size, std::size_t value_size);
+
+    // Upper bound of the node header size, entries of tiny keys and values are dominated by it
+    static constexpr std::size_t kNodeHeader = 80;
+
+    /**
+     * Could there be an entry of the key, false means there is certainly none. Reads only the filter, so could be
+     * called without any lock concurrently with modifications. Always true if storage keeps no filter
+     */
+    bool MayContain(const HashedKey &key) const { return _filter == nullptr || _filter->contains(key.hash); }
+
+    // Eviction mode storage was created with
+    Eviction eviction() const { return _eviction; }
+
+    // Does storage keep the filter of key hashes
+    bool filtered() const { return _filter != nullptr; }
+
+    // Number of bytes the filter takes, if any
+    std::size_t filter_bytes() const { return _filter == nullptr ? 0 : _filter->bytes(); }
+
+protected:
+    // Current unix time, source of time for expiration
+    virtual int64_t now() const { return std::time(nullptr); }
+
+private:
+    // LRU cache node. Each node is a single memory block: header is followed by key bytes and then
+    // by value bytes
     using lru_node = struct lru_node {
-        lru_node(const std::string& key, const std::string& value) : key(key), value(value) {}
+        lru_node *prev;
+        lru_node *next;
+        std::size_t hash;
 
-        const std::string key;
-        std::string value;
-        lru_node* prev;
-        std::unique_ptr<lru_node> next;
+        // Links of the expiration timer wheel, used only if node expires
+        lru_node *timer_prev;
+        lru_node *timer_next;
+
+        uint32_t key_size;
+        uint32_t value_size;
+
+        // Number of bytes reserved for the value right after the key
+        uint32_t capacity;
+
+        // Unix time node expires at, 0 if never
+        uint32_t expire;
+
+        // Opaque client flags, see Meta::flags
+        uint32_t flags;
+
+        // Size of the value once decompressed, 0 if value is stored as is
+        uint32_t raw_size;
+
+        // Changes along with the value, see Meta::version
+        uint64_t version;
+
+        // Number of references: one of the storage, while node is in it, and one per ValueRef
+        std::atomic<uint32_t> refs;
+
+        // Was there any access to the node since eviction has passed over it last time, used in kClock mode only
+        std::atomic<bool> referenced;
+
+        uint8_t timer_slot;
+
+        char *key() { return reinterpret_cast<char *>(this + 1); }
+        const char *key() const { return reinterpret_cast<const char *>(this + 1); }
+
+        char *value() { return key() + key_size; }
+        const char *value() const { return key() + key_size; }
     };
-    
-    void to_tail(lru_node& node);
-    void set_node(lru_node& node, const std::string &value);
-    void add_node(const std::string& key, const std::string &value);
+
+    // New node with room for capacity bytes of the value, at least value_size
+    static lru_node *new_node(const char *key, std::size_t key_size, const char *value, std::size_t value_size,
+                              std::size_t hash, std::size_t capacity = 0);
+
+    // Drops one reference to the node, frees it once there are no references left
+    static void delete_node(lru_node *node);
+    static void release_node(void *node);
+
+    // Number of bytes of the budget node occupies
+    static std::size_t node_size(const lru_node &node);
+
+    // Bytes to store for the value: compressed ones, with raw_size set to the value size, or the value itself
+    StringRef pack(const std::string &value, uint32_t &raw_size);
+
+    // Value of the node, decompressed if needed
+    static void unpack(const lru_node &node, std::string &value);
+
+    // Handle of the node value: pinned node or, if value is compressed, decompressed copy
+    static ValueRef value_of(lru_node &node);
+
+    void free_head();
+
+    // Makes sure there are at least size bytes left evicting nodes other than keep if needed
+    void reserve(std::size_t size, const lru_node *keep);
+
+    // Gives bytes not needed anymore back to the budget, done after every modification
+    void balance();
+    void unlink(lru_node &node);
+    void link_tail(lru_node &node);
+    void to_tail(lru_node &node);
+    void touch(lru_node &node);
+    void set_node(lru_node &node, const std::string &value, uint32_t expire, uint32_t flags);
+
+    // Puts fresh node, new_size bytes of the budget, in place of the node with the same key
+    void replace_node(lru_node &node, lru_node &fresh, std::size_t new_size);
+
+    // Adds data to the value of the existing key, at the beginning if front is set or at the end otherwise
+    bool join(const HashedKey &key, const std::string &data, bool front);
+
+    // Updates counter of the existing key, see Increment
+    CounterStatus update_node(const HashedKey &key, uint64_t delta, bool decrement, uint64_t &value);
+    void set_expire(lru_node &node, uint32_t expire);
+    void add_node(StringRef key, const std::string &value, std::size_t hash, uint32_t expire, uint32_t flags);
+    void remove_node(lru_node &node);
+
+    // Fills filter with hashes of all nodes anew, once it has got too full
+    void rebuild_filter();
+    lru_node *find_node(StringRef key, std::size_t hash) const;
+
+    // Lookup for Get: node is touched, expired one is treated as absent
+    lru_node *get_node(StringRef key, std::size_t hash);
+
+    // Drops entries expired by the given moment
+    void expire_nodes(int64_t now);
+
+    // Adds values read back from the cold tier, unless storage has got the keys meanwhile
+    void promote(int64_t now);
+
+    // Same as find_node, but expired node is dropped and treated as absent
+    lru_node *find_live_node(StringRef key, std::size_t hash, int64_t now);
+
+    // Lookup for modifications of the current value: key found only in the cold tier is requested from there,
+    // so it is promoted and modified by the next attempt, the same way Get misses it, see get_node
+    lru_node *find_or_fetch(StringRef key, std::size_t hash, int64_t now);
 
     // Maximum number of bytes could be stored in this cache.
-    // i.e all (keys+values) must be less the _max_size
+    // i.e all entries, see EntrySize, must be less the _max_size
     std::size_t _max_size;
     std::size_t _space_left;
 
+    const Eviction _eviction;
+
     // Main storage of lru_nodes, elements in this list ordered descending by "freshness": in the head
     // element that wasn't used for longest time.
     //
     // List owns all nodes
-    std::unique_ptr<lru_node> _lru_head;
-    lru_node* _lru_tail;
+    lru_node *_lru_head;
+    lru_node *_lru_tail;
 
     // Index of nodes from list above, allows fast random access to elements by lru_node#key
-    std::map<std::reference_wrapper<const std::string>, std::reference_wrapper<lru_node>, std::less<std::string>> _lru_index;
+    HashIndex<lru_node> _lru_index;
+
+    // Nodes that have expiration time
+    TimerWheel<lru_node> _timers;
+
+    // Shared budget space is borrowed from, if any. Then _space_left is the part borrowed but not used yet
+    MemoryBudget *_budget;
+
+    // Tier evicted entries go to, if any
+    ColdTier *_cold;
+
+    // Hashes of all nodes in the index, if storage keeps them
+    std::unique_ptr<CuckooFilter> _filter;
+
+    // Minimal size of the value to compress, 0 if none is, and the buffer values are compressed to
+    std::size_t _compress_from;
+    std::string _packed;
+
+    // Last version assigned to a node
+    uint64_t _versions;
+
+    // Number of modifications so far and the one that last failed to borrow from the budget
+    uint64_t _operations;
+    uint64_t _short_at;
 };
 
 } // namespace Backend
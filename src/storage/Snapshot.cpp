@@ -0,0 +1,226 @@
+#include "Snapshot.h"
+
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Varint.h"
+
+namespace Afina {
+namespace Backend {
+
+namespace {
+
+const char kMagic[8] = {'A', 'F', 'I', 'N', 'A', 'S', 'N', '1'};
+
+// Tags of the records
+const char kItem = 'I';
+const char kEnd = 'E';
+
+// Records are collected into buffer of that size before write, larger values are written right away
+const std::size_t kBufferSize = 1 << 20;
+
+std::string failure(const std::string &what, const std::string &path) {
+    return what + " " + path + ": " + std::string(strerror(errno));
+}
+
+// Buffered writer of a file descriptor
+class Writer {
+public:
+    Writer(int fd, const std::string &path) : _fd(fd), _path(path) { _buffer.reserve(kBufferSize); }
+
+    void append(const char *data, std::size_t size) {
+        if (_buffer.size() + size > kBufferSize) {
+            flush();
+        }
+        if (size > kBufferSize) {
+            write(data, size);
+        } else {
+            _buffer.append(data, size);
+        }
+    }
+
+    // Buffer for small writes, flushed once it gets large
+    std::string &buffer() {
+        if (_buffer.size() > kBufferSize) {
+            flush();
+        }
+        return _buffer;
+    }
+
+    void flush() {
+        write(_buffer.data(), _buffer.size());
+        _buffer.clear();
+    }
+
+private:
+    void write(const char *data, std::size_t size) {
+        while (size > 0) {
+            ssize_t written = ::write(_fd, data, size);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error(failure("Failed to write snapshot", _path));
+            }
+            data += written;
+            size -= written;
+        }
+    }
+
+    int _fd;
+    const std::string &_path;
+    std::string _buffer;
+};
+
+// Read-only mapping of the whole file
+class Mapping {
+public:
+    Mapping() : _data(nullptr), _size(0) {}
+    ~Mapping() {
+        if (_data != nullptr) {
+            munmap(_data, _size);
+        }
+    }
+
+    // Maps file at path, returns false if there is no such file
+    bool map(const std::string &path) {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            if (errno == ENOENT) {
+                return false;
+            }
+            throw std::runtime_error(failure("Failed to open snapshot", path));
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            throw std::runtime_error(failure("Failed to stat snapshot", path));
+        }
+        _size = st.st_size;
+        if (_size > 0) {
+            void *data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED) {
+                close(fd);
+                throw std::runtime_error(failure("Failed to map snapshot", path));
+            }
+            _data = static_cast<char *>(data);
+            madvise(_data, _size, MADV_SEQUENTIAL);
+        }
+        close(fd);
+        return true;
+    }
+
+    const char *data() const { return _data; }
+    std::size_t size() const { return _size; }
+
+private:
+    Mapping(const Mapping &);            // = delete;
+    Mapping &operator=(const Mapping &); // = delete;
+
+    char *_data;
+    std::size_t _size;
+};
+
+} // namespace
+
+// See Snapshot.h
+std::size_t SaveSnapshot(Afina::Storage &storage, const std::string &path) {
+    std::string temporary = path + ".tmp";
+    int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error(failure("Failed to create snapshot", temporary));
+    }
+
+    uint64_t count = 0;
+    try {
+        Writer writer(fd, temporary);
+        writer.append(kMagic, sizeof(kMagic));
+        bool supported = storage.Export([&](Afina::Storage::Item &item) {
+            std::string &out = writer.buffer();
+            out.push_back(kItem);
+            PutVarint(out, item.key.size());
+            PutVarint(out, item.value.size());
+            PutVarint(out, item.meta.expire);
+            PutVarint(out, item.meta.flags);
+            writer.append(item.key.data(), item.key.size());
+            writer.append(item.value.data(), item.value.size());
+            count++;
+        });
+        if (!supported) {
+            throw std::runtime_error("Storage doesn't support snapshots");
+        }
+
+        std::string &out = writer.buffer();
+        out.push_back(kEnd);
+        PutVarint(out, count);
+        writer.flush();
+        if (fsync(fd) != 0) {
+            throw std::runtime_error(failure("Failed to sync snapshot", temporary));
+        }
+    } catch (...) {
+        close(fd);
+        unlink(temporary.c_str());
+        throw;
+    }
+
+    close(fd);
+    if (rename(temporary.c_str(), path.c_str()) != 0) {
+        unlink(temporary.c_str());
+        throw std::runtime_error(failure("Failed to replace snapshot", path));
+    }
+    return count;
+}
+
+// See Snapshot.h
+std::size_t LoadSnapshot(Afina::Storage &storage, const std::string &path) {
+    Mapping file;
+    if (!file.map(path)) {
+        return 0;
+    }
+
+    const char *p = file.data();
+    const char *end = p + file.size();
+    if (file.size() < sizeof(kMagic) || std::memcmp(p, kMagic, sizeof(kMagic)) != 0) {
+        throw std::runtime_error("Not a snapshot: " + path);
+    }
+    p += sizeof(kMagic);
+
+    int64_t now = std::time(nullptr);
+    uint64_t count = 0;
+    std::size_t stored = 0;
+    while (p < end && *p == kItem) {
+        p++;
+        uint64_t key_size, value_size, expire, flags;
+        if (!GetVarint(p, end, key_size) || !GetVarint(p, end, value_size) || !GetVarint(p, end, expire) ||
+            !GetVarint(p, end, flags) || key_size > uint64_t(end - p) || value_size > uint64_t(end - p - key_size)) {
+            throw std::runtime_error("Snapshot is truncated: " + path);
+        }
+
+        Afina::Storage::Meta meta;
+        meta.expire = expire;
+        meta.flags = flags;
+        if (!meta.expired(now) &&
+            storage.Put(StringRef(p, key_size), std::string(p + key_size, value_size), meta)) {
+            stored++;
+        }
+        p += key_size + value_size;
+        count++;
+    }
+
+    uint64_t expected;
+    if (p == end || *p++ != kEnd || !GetVarint(p, end, expected) || expected != count) {
+        throw std::runtime_error("Snapshot is truncated: " + path);
+    }
+    return stored;
+}
+
+} // namespace Backend
+} // namespace Afina
@@ -0,0 +1,43 @@
+#ifndef AFINA_STORAGE_SNAPSHOT_H
+#define AFINA_STORAGE_SNAPSHOT_H
+
+#include <cstddef>
+#include <string>
+
+#include <afina/Storage.h>
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Point-in-time dump of the storage
+ * Snapshot file is a magic header followed by records of all associations, the least recently used first,
+ * and a trailer with the number of records. Each record is a tag byte and varint key size, value size,
+ * expiration time and flags followed by key and value bytes, see Storage::Item.
+ *
+ * Dump is taken by Storage::Export, so storage keeps serving while it is written: lock of each part is held
+ * only while its entries are pinned, file is written after that. File is written next to the target and
+ * renamed over it once complete, so reader never sees partial snapshot.
+ */
+
+/**
+ * Writes all live associations of the storage to the file at path, replacing it atomically. Throws
+ * std::runtime_error if storage doesn't support export or on any I/O failure, old file is kept then.
+ *
+ * @return number of associations written
+ */
+std::size_t SaveSnapshot(Afina::Storage &storage, const std::string &path);
+
+/**
+ * Puts all associations from the snapshot file at path into storage, except ones expired meanwhile. File is
+ * mapped and parsed in place, so load takes a single pass over memory plus the insertion itself. Missing file
+ * is an empty snapshot, broken one makes it throw std::runtime_error, associations loaded till then are kept.
+ *
+ * @return number of associations stored
+ */
+std::size_t LoadSnapshot(Afina::Storage &storage, const std::string &path);
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_SNAPSHOT_H
@@ -0,0 +1,269 @@
+#include "StripedLockLRU.h"
+
+namespace Afina {
+namespace Backend {
+
+constexpr size_t StripedLockLRU::kMaxShards;
+
+// See StripedLockLRU.h
+StripedLockLRU::StripedLockLRU(size_t max_size, size_t num_shards, SimpleLRU::Eviction eviction, size_t compress_from)
+    : _budget(max_size), _max_size(max_size), _eviction(eviction), _compress_from(compress_from),
+      _migrated_shard(0), _migrated_cursor(0) {
+    _layout.store(new layout{new_shards(shards_for(num_shards), 1), nullptr});
+}
+
+StripedLockLRU::~StripedLockLRU() {
+    // Nobody could use storage being destroyed, so shards are freed directly
+    layout *shards = _layout.load();
+    delete shards->current;
+    delete shards->previous;
+    delete shards;
+}
+
+// See StripedLockLRU.h
+std::size_t StripedLockLRU::MultiPut(const std::vector<std::string> &keys, const std::vector<std::string> &values) {
+    std::vector<HashedKey> hashed = hash(keys, std::min(keys.size(), values.size()));
+    std::vector<std::size_t> positions(hashed.size());
+    for (std::size_t i = 0; i < positions.size(); i++) {
+        positions[i] = i;
+    }
+
+    Concurrency::Epoch::Guard guard;
+    const layout &shards = enter();
+    if (shards.previous != nullptr) {
+        for (const HashedKey &key : hashed) {
+            replaced(shards, key);
+        }
+    }
+
+    // Order of the same key puts is kept as both go to the same shard
+    std::vector<std::vector<std::size_t>> batches = split(*shards.current, hashed, positions);
+    std::size_t stored = 0;
+    for (size_t i = 0; i < batches.size(); i++) {
+        if (!batches[i].empty()) {
+            stored += shards.current->shards[i]->MultiPut(hashed, values, batches[i]);
+        }
+    }
+    return stored;
+}
+
+// See StripedLockLRU.h
+bool StripedLockLRU::Export(const std::function<void(Item &item)> &visit) {
+    Concurrency::Epoch::Guard guard;
+    const layout &shards = enter();
+
+    // Entry moved meanwhile goes from previous shards to the current ones, so it is never missed
+    std::vector<Item> items;
+    for (const shard_set *set : {shards.previous, shards.current}) {
+        if (set == nullptr) {
+            continue;
+        }
+        for (const std::unique_ptr<ThreadSafeSimplLRU> &shard : set->shards) {
+            shard->Collect(items);
+            for (Item &item : items) {
+                visit(item);
+            }
+            items.clear();
+        }
+    }
+    return true;
+}
+
+// See StripedLockLRU.h
+uint64_t StripedLockLRU::Scan(uint64_t cursor, std::size_t count, std::vector<std::string> &keys) {
+    Concurrency::Epoch::Guard guard;
+    const layout &shards = enter();
+
+    // Sets of shards to go through one after another
+    const shard_set *sets[] = {shards.previous, shards.current};
+    size_t set = shards.previous == nullptr ? 1 : 0;
+    size_t shard = 0;
+    uint64_t position = 0;
+    if (cursor != 0) {
+        unsigned generation = cursor >> kGenerationShift;
+        size_t number = (cursor >> kShardShift) & (kMaxShards - 1);
+        for (size_t i = set; i < 2; i++) {
+            if (sets[i]->generation == generation && number < sets[i]->shards.size()) {
+                set = i;
+                shard = number;
+                position = cursor & ((uint64_t(1) << kShardShift) - 1);
+                break;
+            }
+        }
+    }
+
+    std::size_t wanted = keys.size() + std::max<std::size_t>(count, 1);
+    while (set < 2 && keys.size() < wanted) {
+        position = sets[set]->shards[shard]->Scan(position, wanted - keys.size(), keys);
+        if (position == 0 && ++shard == sets[set]->shards.size()) {
+            set++;
+            shard = 0;
+        }
+    }
+    if (set == 2) {
+        return 0;
+    }
+    return (uint64_t(sets[set]->generation) << kGenerationShift) | (uint64_t(shard) << kShardShift) | position;
+}
+
+// See StripedLockLRU.h
+void StripedLockLRU::Stats(std::vector<std::pair<std::string, std::string>> &stats) {
+    Concurrency::Epoch::Guard guard;
+    const layout &shards = *_layout.load(std::memory_order_acquire);
+
+    uint64_t negatives = 0, false_positives = 0;
+    std::size_t bytes = 0;
+    for (const shard_set *set : {shards.previous, shards.current}) {
+        if (set == nullptr) {
+            continue;
+        }
+        for (const std::unique_ptr<ThreadSafeSimplLRU> &shard : set->shards) {
+            negatives += shard->filter_negatives();
+            false_positives += shard->filter_false_positives();
+            bytes += shard->filter_bytes();
+        }
+    }
+    ThreadSafeSimplLRU::FilterStats(negatives, false_positives, bytes, stats);
+}
+
+// See StripedLockLRU.h
+bool StripedLockLRU::Reshard(size_t num_shards) {
+    std::unique_lock<std::mutex> lock(_migration);
+
+    // Operations that have seen shards older than the current ones could still add entries to them
+    Concurrency::Epoch::Synchronize();
+    _retired.clear();
+
+    // Previous resharding completes batch by batch, so others don't wait on shard locks meanwhile
+    layout *shards = _layout.load();
+    if (shards->previous != nullptr) {
+        while (_layout.load() == shards) {
+            Concurrency::Epoch::Guard guard;
+            lock.unlock();
+            migrate(*shards);
+            lock.lock();
+        }
+        Concurrency::Epoch::Synchronize();
+        _retired.clear();
+        shards = _layout.load();
+    }
+
+    size_t number = shards_for(num_shards);
+    if (number == shards->current->shards.size()) {
+        return false;
+    }
+
+    // Generations of the previous and the current shards always differ, and zero one never appears in the cursor
+    unsigned generation = shards->current->generation % ((1 << (64 - kGenerationShift)) - 1) + 1;
+    layout *next = new layout{new_shards(number, generation), shards->current};
+    _migrated_shard = 0;
+    _migrated_cursor = 0;
+    _layout.store(next, std::memory_order_release);
+    Concurrency::Epoch::Retire(shards, &delete_layout);
+
+    // Moving of entries begins once nobody could add them to the previous shards anymore
+    Concurrency::Epoch::Synchronize();
+    return true;
+}
+
+// See StripedLockLRU.h
+size_t StripedLockLRU::shards() const {
+    Concurrency::Epoch::Guard guard;
+    return _layout.load(std::memory_order_acquire)->current->shards.size();
+}
+
+// See StripedLockLRU.h
+bool StripedLockLRU::resharding() const {
+    Concurrency::Epoch::Guard guard;
+    return _layout.load(std::memory_order_acquire)->previous != nullptr;
+}
+
+void StripedLockLRU::delete_layout(void *shards) { delete static_cast<layout *>(shards); }
+
+StripedLockLRU::shard_set *StripedLockLRU::new_shards(size_t number, unsigned generation) {
+    shard_set *set = new shard_set();
+    for (size_t i = 0; i < number; i++) {
+        set->shards.emplace_back(
+            new ThreadSafeSimplLRU(_max_size, _eviction, &_budget, nullptr, _compress_from, true));
+        set->shards.back()->SetEvictionListener([this](StringRef key) { evicted(key); });
+    }
+    set->mask = number - 1;
+    set->generation = generation;
+    return set;
+}
+
+const StripedLockLRU::layout &StripedLockLRU::enter() {
+    const layout &shards = *_layout.load(std::memory_order_acquire);
+    if (shards.previous != nullptr) {
+        migrate(shards);
+    }
+    return shards;
+}
+
+void StripedLockLRU::migrate(const layout &shards) {
+    std::unique_lock<std::mutex> lock(_migration, std::try_to_lock);
+    if (!lock.owns_lock() || _layout.load(std::memory_order_relaxed) != &shards) {
+        return;
+    }
+
+    // Shard scan returns every key that stays in shard all the time, and nothing is added to previous shards
+    std::vector<std::string> keys;
+    ThreadSafeSimplLRU &from = *shards.previous->shards[_migrated_shard];
+    _migrated_cursor = from.Scan(_migrated_cursor, kMigrateBatch, keys);
+    for (const std::string &key : keys) {
+        HashedKey hashed(key);
+        from.MoveTo(hashed, shard_of(*shards.current, hashed));
+    }
+
+    if (_migrated_cursor == 0 && ++_migrated_shard == shards.previous->shards.size()) {
+        finish(shards);
+    }
+}
+
+void StripedLockLRU::finish(const layout &shards) {
+    _layout.store(new layout{shards.current, nullptr}, std::memory_order_release);
+    _retired.emplace_back(shards.previous);
+    Concurrency::Epoch::Retire(const_cast<layout *>(&shards), &delete_layout);
+}
+
+// See StripedLockLRU.h
+std::size_t StripedLockLRU::MultiGet(const std::vector<StringRef> &keys, std::vector<ValueRef> &values,
+                                     std::vector<Meta> *metas, bool versions) {
+    values.resize(keys.size());
+    if (metas != nullptr) {
+        metas->resize(keys.size());
+    }
+    std::vector<HashedKey> hashed = hash(keys, keys.size());
+    std::vector<std::size_t> positions(keys.size());
+    for (std::size_t i = 0; i < positions.size(); i++) {
+        positions[i] = i;
+    }
+
+    Concurrency::Epoch::Guard guard;
+    const layout &shards = enter();
+    std::size_t found = 0;
+    if (shards.previous != nullptr) {
+        // Keys found in previous shards are not in the current ones
+        found = multi_get(*shards.previous, hashed, positions, values, metas);
+        positions.erase(std::remove_if(positions.begin(), positions.end(),
+                                       [&values](std::size_t position) { return bool(values[position]); }),
+                        positions.end());
+    }
+    return found + multi_get(*shards.current, hashed, positions, values, metas);
+}
+
+std::size_t StripedLockLRU::multi_get(const shard_set &set, const std::vector<HashedKey> &keys,
+                                      const std::vector<std::size_t> &positions, std::vector<ValueRef> &values,
+                                      std::vector<Meta> *metas) {
+    std::vector<std::vector<std::size_t>> batches = split(set, keys, positions);
+    std::size_t found = 0;
+    for (size_t i = 0; i < batches.size(); i++) {
+        if (!batches[i].empty()) {
+            found += set.shards[i]->MultiGet(keys, batches[i], values, metas);
+        }
+    }
+    return found;
+}
+
+} // namespace Backend
+} // namespace Afina
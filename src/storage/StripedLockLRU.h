@@ -1,12 +1,16 @@
 #ifndef AFINA_STORAGE_STRIPED_LOCK_LRU_H
 #define AFINA_STORAGE_STRIPED_LOCK_LRU_H
 
+#include <algorithm>
+#include <atomic>
 #include <map>
 #include <mutex>
 #include <string>
-#include <functional>
+#include <thread>
 #include <vector>
 
+#include <afina/concurrency/Epoch.h>
+
 #include "ThreadSafeSimpleLRU.h"
 
 namespace Afina {
@@ -14,49 +18,330 @@ namespace Backend {
 
 /**
  * # LRU thread safe version with striped locks
+ * Keys are spread over shards by hash, each shard is ThreadSafeSimplLRU with its own lock. All shards share
+ * single MemoryBudget, so shard under skewed load borrows space idle shards have given back, rather than
+ * evicting while they sit half empty.
+ *
+ * Number of shards is a power of two, so shard is picked by a mask of the hash high bits, while shard index uses
+ * the low ones. Hash is computed once per key and passed down to the shard along with the key.
  *
+ * Number of shards could be changed at runtime, see Reshard. New set of shards takes over at once, and entries
+ * are moved to it from the previous one bit by bit: every operation moves a small batch along the way, unless
+ * some other thread is moving one already. Meanwhile key is looked up in its previous shard first and then in
+ * the new one, and modification moves the key entry over before it goes to the new shard. So key is never in
+ * both shards and no operation waits for more than a batch. Operations reach shards via Concurrency::Epoch, so
+ * switching them is not a lock for anybody either.
  *
+ * Every shard keeps the filter of its key hashes, see SimpleLRU::MayContain, so lookup of the absent key usually
+ * reads a couple of filter words instead of taking the shard lock.
  */
 class StripedLockLRU: public Afina::Storage {
 public:
-    StripedLockLRU(size_t shard_size = 1<<20, size_t num_shards = 4): _shard_size(shard_size), _num_shards(num_shards) {
-         for(size_t i = 0; i < _num_shards; i++) {
-             _shards.emplace_back(new ThreadSafeSimplLRU(_shard_size));
-         }
-    }
+    /**
+     * @param max_size budget of all shards together, see SimpleLRU
+     * @param num_shards number of shards, rounded up to a power of two. Zero means kShardsPerCore per hardware
+     * thread
+     * @param eviction eviction mode of all shards
+     * @param compress_from minimal size of the value to compress, see SimpleLRU
+     */
+    StripedLockLRU(size_t max_size = 4 << 20, size_t num_shards = 0,
+                   SimpleLRU::Eviction eviction = SimpleLRU::Eviction::kLRU, size_t compress_from = 0);
+
+    ~StripedLockLRU();
+
+    // Number of shards per hardware thread used by default, keeps lock collisions rare
+    static constexpr size_t kShardsPerCore = 4;
+
+    // Upper bound of the number of shards, so that shard number fits the scan cursor
+    static constexpr size_t kMaxShards = 4096;
 
-    ~StripedLockLRU() {}
+    // Number of keys single operation moves to the new shards while resharding
+    static constexpr size_t kMigrateBatch = 32;
+
+    // Position of the shard number and of the shards generation in the scan cursor
+    static constexpr int kShardShift = 48;
+    static constexpr int kGenerationShift = 60;
 
     // see SimpleLRU.h
     bool Put(const std::string &key, const std::string &value) override {
-        return _shards[_hash(key)%_num_shards]->Put(key, value);
+        return Put(StringRef(key), value, Meta());
+    }
+
+    // see SimpleLRU.h
+    bool Put(const std::string &key, const std::string &value, const Meta &meta) override {
+        return Put(StringRef(key), value, meta);
+    }
+
+    // see SimpleLRU.h
+    bool Put(StringRef key, const std::string &value, const Meta &meta) override {
+        HashedKey hashed(key);
+        Concurrency::Epoch::Guard guard;
+        return replaced(enter(), hashed).Put(hashed, value, meta);
     }
 
     // see SimpleLRU.h
     bool PutIfAbsent(const std::string &key, const std::string &value) override {
-        return _shards[_hash(key)%_num_shards]->PutIfAbsent(key, value);
+        return PutIfAbsent(StringRef(key), value, Meta());
+    }
+
+    // see SimpleLRU.h
+    bool PutIfAbsent(const std::string &key, const std::string &value, const Meta &meta) override {
+        return PutIfAbsent(StringRef(key), value, meta);
+    }
+
+    // see SimpleLRU.h
+    bool PutIfAbsent(StringRef key, const std::string &value, const Meta &meta) override {
+        HashedKey hashed(key);
+        Concurrency::Epoch::Guard guard;
+        return updated(enter(), hashed).PutIfAbsent(hashed, value, meta);
     }
 
     // see SimpleLRU.h
     bool Set(const std::string &key, const std::string &value) override {
-        return _shards[_hash(key)%_num_shards]->Set(key, value);
+        return Set(StringRef(key), value, Meta());
+    }
+
+    // see SimpleLRU.h
+    bool Set(const std::string &key, const std::string &value, const Meta &meta) override {
+        return Set(StringRef(key), value, meta);
+    }
+
+    // see SimpleLRU.h
+    bool Set(StringRef key, const std::string &value, const Meta &meta) override {
+        HashedKey hashed(key);
+        Concurrency::Epoch::Guard guard;
+        return updated(enter(), hashed).Set(hashed, value, meta);
+    }
+
+    // see SimpleLRU.h
+    CasStatus CompareAndSet(const std::string &key, const std::string &value, const Meta &meta,
+                            uint64_t version) override {
+        HashedKey hashed(key);
+        Concurrency::Epoch::Guard guard;
+        return updated(enter(), hashed).CompareAndSet(hashed, value, meta, version);
+    }
+
+    // see SimpleLRU.h
+    bool Append(const std::string &key, const std::string &data) override {
+        HashedKey hashed(key);
+        Concurrency::Epoch::Guard guard;
+        return updated(enter(), hashed).Append(hashed, data);
+    }
+
+    // see SimpleLRU.h
+    bool Prepend(const std::string &key, const std::string &data) override {
+        HashedKey hashed(key);
+        Concurrency::Epoch::Guard guard;
+        return updated(enter(), hashed).Prepend(hashed, data);
+    }
+
+    // see SimpleLRU.h
+    CounterStatus Increment(const std::string &key, uint64_t delta, uint64_t &value) override {
+        HashedKey hashed(key);
+        Concurrency::Epoch::Guard guard;
+        return updated(enter(), hashed).Increment(hashed, delta, value);
+    }
+
+    // see SimpleLRU.h
+    CounterStatus Decrement(const std::string &key, uint64_t delta, uint64_t &value) override {
+        HashedKey hashed(key);
+        Concurrency::Epoch::Guard guard;
+        return updated(enter(), hashed).Decrement(hashed, delta, value);
+    }
+
+    // see SimpleLRU.h
+    bool Delete(const std::string &key) override {
+        return Delete(StringRef(key));
+    }
+
+    // see SimpleLRU.h
+    bool Delete(StringRef key) override {
+        HashedKey hashed(key);
+        Concurrency::Epoch::Guard guard;
+        const layout &shards = enter();
+        bool moved = shards.previous != nullptr && shard_of(*shards.previous, hashed).Delete(hashed);
+        return shard_of(*shards.current, hashed).Delete(hashed) || moved;
+    }
+
+    // see SimpleLRU.h
+    bool Get(const std::string &key, std::string &value) override {
+        return Get(StringRef(key), value);
     }
 
     // see SimpleLRU.h
-    bool Delete(const std::string &key) override  {
-        return _shards[_hash(key)%_num_shards]->Delete(key);
+    bool Get(const std::string &key, ValueRef &value) override {
+        return Get(StringRef(key), value);
     }
 
     // see SimpleLRU.h
-    bool Get(const std::string &key, std::string &value) override  {
-        return _shards[_hash(key)%_num_shards]->Get(key, value);
+    bool Get(StringRef key, std::string &value) override {
+        HashedKey hashed(key);
+        Concurrency::Epoch::Guard guard;
+        const layout &shards = enter();
+        if (shards.previous != nullptr && shard_of(*shards.previous, hashed).Get(hashed, value)) {
+            return true;
+        }
+        return shard_of(*shards.current, hashed).Get(hashed, value);
     }
 
+    // see SimpleLRU.h
+    bool Get(StringRef key, ValueRef &value) override {
+        HashedKey hashed(key);
+        Concurrency::Epoch::Guard guard;
+        const layout &shards = enter();
+        if (shards.previous != nullptr && shard_of(*shards.previous, hashed).Get(hashed, value)) {
+            return true;
+        }
+        return shard_of(*shards.current, hashed).Get(hashed, value);
+    }
+
+    // MultiGet of std::string keys is the default one
+    using Afina::Storage::MultiGet;
+
+    // see SimpleLRU.h
+    std::size_t MultiGet(const std::vector<StringRef> &keys, std::vector<ValueRef> &values,
+                         std::vector<Meta> *metas, bool versions) override;
+
+    // see SimpleLRU.h
+    std::size_t MultiPut(const std::vector<std::string> &keys, const std::vector<std::string> &values) override;
+
+    // see SimpleLRU.h, shards are visited one by one and each is locked only while its entries are taken out.
+    // While resharding entry moved meanwhile could be visited twice
+    bool Export(const std::function<void(Item &item)> &visit) override;
+
+    // see SimpleLRU.h, shards are scanned one after another. Cursor keeps generation of the shards in its highest
+    // bits, shard number in the next ones and the cursor within the shard in the low ones. While resharding both
+    // previous and new shards are scanned, so key moved meanwhile could be returned twice. Cursor of the shards
+    // that are gone already starts iteration over
+    uint64_t Scan(uint64_t cursor, std::size_t count, std::vector<std::string> &keys) override;
+
+    // see Storage.h, filter statistics of all shards together
+    void Stats(std::vector<std::pair<std::string, std::string>> &stats) override;
+
+    /**
+     * Switches storage to the given number of shards, rounded the same way as in constructor. New shards take
+     * over right away, entries are moved over by the operations that follow, see class description. Waits for
+     * the operations that use shards older than the current ones and, if previous resharding is not over yet,
+     * completes it first. Returns false if storage is using that number of shards already
+     */
+    bool Reshard(size_t num_shards);
+
+    // Number of shards storage is using now
+    size_t shards() const;
+
+    // Are entries still being moved to the new shards
+    bool resharding() const;
+
 private:
-    std::hash<std::string> _hash;
-    size_t _shard_size;
-    size_t _num_shards;
-    std::vector<std::unique_ptr<ThreadSafeSimplLRU>> _shards;
+    // Shards along with the number of their layout, see Scan
+    struct shard_set {
+        std::vector<std::unique_ptr<ThreadSafeSimplLRU>> shards;
+        size_t mask;
+        unsigned generation;
+    };
+
+    // Shards operations go to: the current ones and, while resharding, the previous ones entries are moved out of.
+    // Layout never changes, new one replaces it as a whole and the old one is retired via Concurrency::Epoch
+    struct layout {
+        shard_set *current;
+        shard_set *previous;
+    };
+
+    // Actual number of shards for the requested one
+    static size_t shards_for(size_t requested) {
+        if (requested == 0) {
+            requested = kShardsPerCore * std::max<size_t>(1, std::thread::hardware_concurrency());
+        }
+        size_t result = 1;
+        while (result < std::min(requested, kMaxShards)) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    static void delete_layout(void *shards);
+
+    shard_set *new_shards(size_t number, unsigned generation);
+
+    // Shard the key belongs to. Shards use hash high bits, as lower ones are taken by the shard index
+    static size_t shard_index(const shard_set &set, const HashedKey &key) { return (key.hash >> 32) & set.mask; }
+    static ThreadSafeSimplLRU &shard_of(const shard_set &set, const HashedKey &key) {
+        return *set.shards[shard_index(set, key)];
+    }
+
+    // Layout to work with, must be called inside Concurrency::Epoch::Guard. Moves next batch of entries to the new
+    // shards while resharding
+    const layout &enter();
+
+    // Moves next batch of entries unless another thread does it already, see Reshard
+    void migrate(const layout &shards);
+
+    // Replaces layout that has previous shards with the one having current shards only, must be called with
+    // _migration held
+    void finish(const layout &shards);
+
+    // Shard the key is to be modified in. While resharding entry is moved there from the previous shard first
+    ThreadSafeSimplLRU &updated(const layout &shards, const HashedKey &key) {
+        ThreadSafeSimplLRU &shard = shard_of(*shards.current, key);
+        if (shards.previous != nullptr) {
+            shard_of(*shards.previous, key).MoveTo(key, shard);
+        }
+        return shard;
+    }
+
+    // Same as updated, for modifications that overwrite the entry as a whole: previous entry is just dropped
+    ThreadSafeSimplLRU &replaced(const layout &shards, const HashedKey &key) {
+        ThreadSafeSimplLRU &shard = shard_of(*shards.current, key);
+        if (shards.previous != nullptr) {
+            shard_of(*shards.previous, key).Delete(key);
+        }
+        return shard;
+    }
+
+    // Looks keys at given positions up in the given shards, each shard is locked once for its whole part
+    static std::size_t multi_get(const shard_set &set, const std::vector<HashedKey> &keys,
+                                 const std::vector<std::size_t> &positions, std::vector<ValueRef> &values,
+                                 std::vector<Meta> *metas);
+
+    // First count keys along with their hashes
+    template <typename K> static std::vector<HashedKey> hash(const std::vector<K> &keys, std::size_t count) {
+        std::vector<HashedKey> hashed;
+        hashed.reserve(count);
+        for (std::size_t i = 0; i < count; i++) {
+            hashed.emplace_back(keys[i]);
+        }
+        return hashed;
+    }
+
+    // Given positions of keys grouped by shard
+    static std::vector<std::vector<std::size_t>> split(const shard_set &set, const std::vector<HashedKey> &keys,
+                                                       const std::vector<std::size_t> &positions) {
+        std::vector<std::vector<std::size_t>> batches(set.shards.size());
+        for (std::size_t position : positions) {
+            batches[shard_index(set, keys[position])].push_back(position);
+        }
+        return batches;
+    }
+
+    // Shared by all shards, so must outlive them
+    MemoryBudget _budget;
+
+    const size_t _max_size;
+    const SimpleLRU::Eviction _eviction;
+    const size_t _compress_from;
+
+    std::atomic<layout *> _layout;
+
+    // Serializes moving entries and resharding. Guards everything below
+    std::mutex _migration;
+
+    // Previous shard entries are being moved from and the scan cursor within it
+    size_t _migrated_shard;
+    uint64_t _migrated_cursor;
+
+    // Shards all entries have been moved from. Operations could still use them until Concurrency::Epoch says
+    // otherwise, so they are freed by the next Reshard, see there
+    std::vector<std::unique_ptr<shard_set>> _retired;
 };
 
 } // namespace Backend
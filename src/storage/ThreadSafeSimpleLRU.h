@@ -1,9 +1,14 @@
 #ifndef AFINA_STORAGE_THREAD_SAFE_SIMPLE_LRU_H
 #define AFINA_STORAGE_THREAD_SAFE_SIMPLE_LRU_H
 
-#include <map>
+#include <atomic>
 #include <mutex>
+#include <sstream>
 #include <string>
+#include <utility>
+#include <vector>
+
+#include <afina/concurrency/SharedMutex.h>
 
 #include "SimpleLRU.h"
 
@@ -12,46 +17,234 @@ namespace Backend {
 
 /**
  * # SimpleLRU thread safe version with global mutex
- *
- *
+ * In kClock eviction mode Get doesn't modify storage, so readers share the lock. If storage keeps the filter,
+ * lookups consult it before taking the lock, so most of misses don't take it at all
  */
 class ThreadSafeSimplLRU : public SimpleLRU {
 public:
-    ThreadSafeSimplLRU(size_t max_size = 1024) : SimpleLRU(max_size) {}
+    ThreadSafeSimplLRU(size_t max_size = 1024, Eviction eviction = Eviction::kLRU, MemoryBudget *budget = nullptr,
+                       ColdTier *cold = nullptr, size_t compress_from = 0, bool filter = false)
+        : SimpleLRU(max_size, eviction, budget, cold, compress_from, filter), _filter_negatives(0),
+          _filter_positives(0) {}
     ~ThreadSafeSimplLRU() {}
 
+    // Other overloads of SimpleLRU hash the key and end up in the methods below
+    using SimpleLRU::Put;
+    using SimpleLRU::PutIfAbsent;
+    using SimpleLRU::Set;
+    using SimpleLRU::CompareAndSet;
+    using SimpleLRU::Append;
+    using SimpleLRU::Prepend;
+    using SimpleLRU::Increment;
+    using SimpleLRU::Decrement;
+    using SimpleLRU::Delete;
+    using SimpleLRU::Get;
+    using SimpleLRU::MultiGet;
+    using SimpleLRU::MultiPut;
+    using SimpleLRU::Export;
+
     // see SimpleLRU.h
-    bool Put(const std::string &key, const std::string &value) override {
-        std::unique_lock<std::mutex> lock(_mutex);
-        return SimpleLRU::Put(key, value);
+    bool Put(const HashedKey &key, const std::string &value, const Meta &meta) override {
+        std::unique_lock<Concurrency::SharedMutex> lock(_mutex);
+        return SimpleLRU::Put(key, value, meta);
     }
 
     // see SimpleLRU.h
-    bool PutIfAbsent(const std::string &key, const std::string &value) override {
-        std::unique_lock<std::mutex> lock(_mutex);
-        return SimpleLRU::PutIfAbsent(key, value);
+    bool PutIfAbsent(const HashedKey &key, const std::string &value, const Meta &meta) override {
+        std::unique_lock<Concurrency::SharedMutex> lock(_mutex);
+        return SimpleLRU::PutIfAbsent(key, value, meta);
     }
 
     // see SimpleLRU.h
-    bool Set(const std::string &key, const std::string &value) override {
-        std::unique_lock<std::mutex> lock(_mutex);
-        return SimpleLRU::Set(key, value);
+    bool Set(const HashedKey &key, const std::string &value, const Meta &meta) override {
+        std::unique_lock<Concurrency::SharedMutex> lock(_mutex);
+        return SimpleLRU::Set(key, value, meta);
     }
 
     // see SimpleLRU.h
-    bool Delete(const std::string &key) override {
-        std::unique_lock<std::mutex> lock(_mutex);
+    CasStatus CompareAndSet(const HashedKey &key, const std::string &value, const Meta &meta,
+                            uint64_t version) override {
+        std::unique_lock<Concurrency::SharedMutex> lock(_mutex);
+        return SimpleLRU::CompareAndSet(key, value, meta, version);
+    }
+
+    // see SimpleLRU.h
+    bool Append(const HashedKey &key, const std::string &data) override {
+        std::unique_lock<Concurrency::SharedMutex> lock(_mutex);
+        return SimpleLRU::Append(key, data);
+    }
+
+    // see SimpleLRU.h
+    bool Prepend(const HashedKey &key, const std::string &data) override {
+        std::unique_lock<Concurrency::SharedMutex> lock(_mutex);
+        return SimpleLRU::Prepend(key, data);
+    }
+
+    // see SimpleLRU.h
+    CounterStatus Increment(const HashedKey &key, uint64_t delta, uint64_t &value) override {
+        std::unique_lock<Concurrency::SharedMutex> lock(_mutex);
+        return SimpleLRU::Increment(key, delta, value);
+    }
+
+    // see SimpleLRU.h
+    CounterStatus Decrement(const HashedKey &key, uint64_t delta, uint64_t &value) override {
+        std::unique_lock<Concurrency::SharedMutex> lock(_mutex);
+        return SimpleLRU::Decrement(key, delta, value);
+    }
+
+    // see SimpleLRU.h
+    bool Delete(const HashedKey &key) override {
+        std::unique_lock<Concurrency::SharedMutex> lock(_mutex);
         return SimpleLRU::Delete(key);
     }
 
     // see SimpleLRU.h
-    bool Get(const std::string &key, std::string &value) override {
-        std::unique_lock<std::mutex> lock(_mutex);
-        return SimpleLRU::Get(key, value);
+    bool Get(const HashedKey &key, std::string &value) override {
+        if (!admitted(key)) {
+            return false;
+        }
+        if (eviction() == Eviction::kClock) {
+            Concurrency::SharedLock lock(_mutex);
+            return checked(SimpleLRU::Get(key, value));
+        }
+        std::unique_lock<Concurrency::SharedMutex> lock(_mutex);
+        return checked(SimpleLRU::Get(key, value));
+    }
+
+    // see SimpleLRU.h
+    bool Get(const HashedKey &key, ValueRef &value) override {
+        if (!admitted(key)) {
+            return false;
+        }
+        if (eviction() == Eviction::kClock) {
+            Concurrency::SharedLock lock(_mutex);
+            return checked(SimpleLRU::Get(key, value));
+        }
+        std::unique_lock<Concurrency::SharedMutex> lock(_mutex);
+        return checked(SimpleLRU::Get(key, value));
+    }
+
+    // see SimpleLRU.h, keys the filter rejects are not looked up under the lock
+    std::size_t MultiGet(const std::vector<HashedKey> &keys, const std::vector<std::size_t> &positions,
+                         std::vector<ValueRef> &values, std::vector<Meta> *metas) override {
+        if (!filtered()) {
+            return locked_multi_get(keys, positions, values, metas);
+        }
+
+        std::vector<std::size_t> admitted_positions;
+        admitted_positions.reserve(positions.size());
+        for (std::size_t position : positions) {
+            values[position].reset();
+            if (admitted(keys[position])) {
+                admitted_positions.push_back(position);
+            }
+        }
+        if (admitted_positions.empty()) {
+            return 0;
+        }
+        std::size_t found = locked_multi_get(keys, admitted_positions, values, metas);
+        _filter_positives.fetch_add(admitted_positions.size() - found, std::memory_order_relaxed);
+        return found;
+    }
+
+    // see SimpleLRU.h
+    std::size_t MultiPut(const std::vector<HashedKey> &keys, const std::vector<std::string> &values,
+                         const std::vector<std::size_t> &positions) override {
+        std::unique_lock<Concurrency::SharedMutex> lock(_mutex);
+        return SimpleLRU::MultiPut(keys, values, positions);
+    }
+
+    // see SimpleLRU.h
+    void Collect(std::vector<Item> &items) override {
+        Concurrency::SharedLock lock(_mutex);
+        SimpleLRU::Collect(items);
+    }
+
+    // see SimpleLRU.h, target is locked after this storage
+    bool MoveTo(const HashedKey &key, SimpleLRU &target) override {
+        if (!MayContain(key)) {
+            return false;
+        }
+        std::unique_lock<Concurrency::SharedMutex> lock(_mutex);
+        return SimpleLRU::MoveTo(key, target);
+    }
+
+    // see SimpleLRU.h
+    bool Adopt(const HashedKey &key, const std::string &value, const Meta &meta) override {
+        std::unique_lock<Concurrency::SharedMutex> lock(_mutex);
+        return SimpleLRU::Adopt(key, value, meta);
+    }
+
+    // see SimpleLRU.h, readers share the lock with the scan
+    uint64_t Scan(uint64_t cursor, std::size_t count, std::vector<std::string> &keys) override {
+        Concurrency::SharedLock lock(_mutex);
+        return SimpleLRU::Scan(cursor, count, keys);
+    }
+
+    // see Storage.h, filter statistics if storage keeps the filter
+    void Stats(std::vector<std::pair<std::string, std::string>> &stats) override {
+        if (filtered()) {
+            Concurrency::SharedLock lock(_mutex);
+            FilterStats(filter_negatives(), filter_false_positives(), filter_bytes(), stats);
+        }
+    }
+
+    // Number of lookups the filter has answered alone
+    uint64_t filter_negatives() const { return _filter_negatives.load(std::memory_order_relaxed); }
+
+    // Number of lookups the filter has let through that have missed anyway
+    uint64_t filter_false_positives() const { return _filter_positives.load(std::memory_order_relaxed); }
+
+    /**
+     * Appends filter statistics: misses answered by the filter alone, misses it has let through, share of
+     * the later among all misses and the memory filter takes
+     */
+    static void FilterStats(uint64_t negatives, uint64_t false_positives, std::size_t bytes,
+                            std::vector<std::pair<std::string, std::string>> &stats) {
+        uint64_t misses = negatives + false_positives;
+        std::ostringstream rate;
+        rate.precision(6);
+        rate << std::fixed << (misses == 0 ? 0.0 : double(false_positives) / misses);
+
+        stats.emplace_back("filter_negatives", std::to_string(negatives));
+        stats.emplace_back("filter_false_positives", std::to_string(false_positives));
+        stats.emplace_back("filter_false_positive_rate", rate.str());
+        stats.emplace_back("filter_bytes", std::to_string(bytes));
     }
 
 private:
-    std::mutex _mutex;
+    // Does the filter let the lookup of key through, counts the ones it doesn't
+    bool admitted(const HashedKey &key) {
+        if (MayContain(key)) {
+            return true;
+        }
+        _filter_negatives.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Result of the lookup filter has let through, counts misses
+    bool checked(bool found) {
+        if (!found && filtered()) {
+            _filter_positives.fetch_add(1, std::memory_order_relaxed);
+        }
+        return found;
+    }
+
+    std::size_t locked_multi_get(const std::vector<HashedKey> &keys, const std::vector<std::size_t> &positions,
+                                 std::vector<ValueRef> &values, std::vector<Meta> *metas) {
+        if (eviction() == Eviction::kClock) {
+            Concurrency::SharedLock lock(_mutex);
+            return SimpleLRU::MultiGet(keys, positions, values, metas);
+        }
+        std::unique_lock<Concurrency::SharedMutex> lock(_mutex);
+        return SimpleLRU::MultiGet(keys, positions, values, metas);
+    }
+
+    Concurrency::SharedMutex _mutex;
+
+    // Filter statistics, see Stats
+    std::atomic<uint64_t> _filter_negatives;
+    std::atomic<uint64_t> _filter_positives;
 };
 
 } // namespace Backend
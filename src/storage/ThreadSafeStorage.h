@@ -0,0 +1,164 @@
+#ifndef AFINA_STORAGE_THREAD_SAFE_STORAGE_H
+#define AFINA_STORAGE_THREAD_SAFE_STORAGE_H
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "ARC.h"
+#include "TinyLFU.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Thread safe version of a storage with global mutex
+ * For storages every Get of which reorders them, like ARC moving entry to T2 or TinyLFU updating frequency
+ * sketch and segments, so all operations are exclusive. T must be constructible from the max_size alone
+ */
+template <typename T> class ThreadSafe : public T {
+public:
+    using Meta = Afina::Storage::Meta;
+    using CasStatus = Afina::Storage::CasStatus;
+    using CounterStatus = Afina::Storage::CounterStatus;
+    using Item = Afina::Storage::Item;
+
+    ThreadSafe(size_t max_size = 1024) : T(max_size) {}
+    ~ThreadSafe() {}
+
+    // see Storage.h
+    bool Put(const std::string &key, const std::string &value) override {
+        std::unique_lock<std::mutex> lock(_mutex);
+        return T::Put(key, value);
+    }
+
+    // see Storage.h
+    bool Put(const std::string &key, const std::string &value, const Meta &meta) override {
+        std::unique_lock<std::mutex> lock(_mutex);
+        return T::Put(key, value, meta);
+    }
+
+    // see Storage.h
+    bool Put(StringRef key, const std::string &value, const Meta &meta) override {
+        std::unique_lock<std::mutex> lock(_mutex);
+        return T::Put(key, value, meta);
+    }
+
+    // see Storage.h
+    bool PutIfAbsent(const std::string &key, const std::string &value) override {
+        std::unique_lock<std::mutex> lock(_mutex);
+        return T::PutIfAbsent(key, value);
+    }
+
+    // see Storage.h
+    bool PutIfAbsent(const std::string &key, const std::string &value, const Meta &meta) override {
+        std::unique_lock<std::mutex> lock(_mutex);
+        return T::PutIfAbsent(key, value, meta);
+    }
+
+    // see Storage.h
+    bool PutIfAbsent(StringRef key, const std::string &value, const Meta &meta) override {
+        std::unique_lock<std::mutex> lock(_mutex);
+        return T::PutIfAbsent(key, value, meta);
+    }
+
+    // see Storage.h
+    bool Set(const std::string &key, const std::string &value) override {
+        std::unique_lock<std::mutex> lock(_mutex);
+        return T::Set(key, value);
+    }
+
+    // see Storage.h
+    bool Set(const std::string &key, const std::string &value, const Meta &meta) override {
+        std::unique_lock<std::mutex> lock(_mutex);
+        return T::Set(key, value, meta);
+    }
+
+    // see Storage.h
+    bool Set(StringRef key, const std::string &value, const Meta &meta) override {
+        std::unique_lock<std::mutex> lock(_mutex);
+        return T::Set(key, value, meta);
+    }
+
+    // see Storage.h
+    CasStatus CompareAndSet(const std::string &key, const std::string &value, const Meta &meta,
+                            uint64_t version) override {
+        std::unique_lock<std::mutex> lock(_mutex);
+        return T::CompareAndSet(key, value, meta, version);
+    }
+
+    // see Storage.h
+    bool Append(const std::string &key, const std::string &data) override {
+        std::unique_lock<std::mutex> lock(_mutex);
+        return T::Append(key, data);
+    }
+
+    // see Storage.h
+    bool Prepend(const std::string &key, const std::string &data) override {
+        std::unique_lock<std::mutex> lock(_mutex);
+        return T::Prepend(key, data);
+    }
+
+    // see Storage.h
+    CounterStatus Increment(const std::string &key, uint64_t delta, uint64_t &value) override {
+        std::unique_lock<std::mutex> lock(_mutex);
+        return T::Increment(key, delta, value);
+    }
+
+    // see Storage.h
+    CounterStatus Decrement(const std::string &key, uint64_t delta, uint64_t &value) override {
+        std::unique_lock<std::mutex> lock(_mutex);
+        return T::Decrement(key, delta, value);
+    }
+
+    // see Storage.h
+    bool Delete(const std::string &key) override {
+        std::unique_lock<std::mutex> lock(_mutex);
+        return T::Delete(key);
+    }
+
+    // see Storage.h
+    bool Get(const std::string &key, std::string &value) override {
+        std::unique_lock<std::mutex> lock(_mutex);
+        return T::Get(key, value);
+    }
+
+    // see Storage.h
+    bool Get(StringRef key, std::string &value) override {
+        std::unique_lock<std::mutex> lock(_mutex);
+        return T::Get(key, value);
+    }
+
+    // MultiGet of std::string keys is the default one
+    using T::MultiGet;
+
+    // see Storage.h
+    std::size_t MultiGet(const std::vector<StringRef> &keys, std::vector<ValueRef> &values,
+                         std::vector<Meta> *metas, bool versions) override {
+        std::unique_lock<std::mutex> lock(_mutex);
+        return T::MultiGet(keys, values, metas, versions);
+    }
+
+    // see Storage.h
+    uint64_t Scan(uint64_t cursor, std::size_t count, std::vector<std::string> &keys) override {
+        std::unique_lock<std::mutex> lock(_mutex);
+        return T::Scan(cursor, count, keys);
+    }
+
+    // see Storage.h
+    void Collect(std::vector<Item> &items) override {
+        std::unique_lock<std::mutex> lock(_mutex);
+        T::Collect(items);
+    }
+
+private:
+    std::mutex _mutex;
+};
+
+using ThreadSafeARC = ThreadSafe<ARC>;
+using ThreadSafeTinyLFU = ThreadSafe<TinyLFU>;
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_THREAD_SAFE_STORAGE_H
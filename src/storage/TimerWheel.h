@@ -0,0 +1,165 @@
+#ifndef AFINA_STORAGE_TIMER_WHEEL_H
+#define AFINA_STORAGE_TIMER_WHEEL_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Hierarchical timer wheel
+ * Tracks expiration time of externally owned elements with one second resolution. Element must expose public
+ * fields `T *timer_prev, *timer_next` and `uint8_t timer_slot` used to link it into wheel slot, and
+ * `uint32_t expire` - unix time in seconds when element expires.
+ *
+ * There are 4 levels of 64 slots each, slot of level L spans 64^L seconds, so levels cover ~1 minute, ~1 hour,
+ * ~3 days and ~6 months ahead respectively. Element is placed on the lowest level that covers its expiration
+ * time and cascades one level down each time wheel passes over its slot. Add and remove are O(1), advance is
+ * O(1) amortized per element and elapsed second.
+ */
+template <typename T> class TimerWheel {
+public:
+    TimerWheel(uint32_t now) : _now(now), _size(0) {
+        for (std::size_t i = 0; i < kLevels * kSlots; i++) {
+            _slots[i] = nullptr;
+        }
+    }
+
+    // Number of elements in the wheel
+    std::size_t size() const { return _size; }
+
+    /**
+     * Adds element into the wheel, its expire field must be set
+     */
+    void add(T &node) {
+        place(node, _now + 1);
+        _size++;
+    }
+
+    /**
+     * Removes element from the wheel
+     */
+    void remove(T &node) {
+        if (node.timer_prev != nullptr) {
+            node.timer_prev->timer_next = node.timer_next;
+        } else {
+            _slots[node.timer_slot] = node.timer_next;
+        }
+        if (node.timer_next != nullptr) {
+            node.timer_next->timer_prev = node.timer_prev;
+        }
+        node.timer_prev = nullptr;
+        node.timer_next = nullptr;
+        _size--;
+    }
+
+    /**
+     * Moves wheel up to the given moment, calling on_expire for every element expired by then. Element is
+     * removed from the wheel before on_expire is called, so callback could destroy it
+     */
+    template <typename F> void advance(uint32_t now, F on_expire) {
+        if (_size == 0) {
+            // Nothing to cascade, jump directly
+            if (now > _now) {
+                _now = now;
+            }
+            return;
+        }
+
+        while (_now < now) {
+            _now++;
+
+            // Once lower level makes full circle next slot of the upper level gets spread over lower levels
+            for (std::size_t level = 1; level < kLevels; level++) {
+                if ((_now & ((uint32_t(1) << (kBits * level)) - 1)) != 0) {
+                    break;
+                }
+                cascade(level, (_now >> (kBits * level)) & kMask);
+            }
+
+            T *node = detach(0, _now & kMask);
+            while (node != nullptr) {
+                T *next = node->timer_next;
+                node->timer_prev = nullptr;
+                node->timer_next = nullptr;
+                if (node->expire <= _now) {
+                    _size--;
+                    on_expire(*node);
+                } else {
+                    place(*node, _now + 1);
+                }
+                node = next;
+            }
+
+            if (_size == 0) {
+                _now = now;
+            }
+        }
+    }
+
+private:
+    static constexpr std::size_t kBits = 6;
+    static constexpr std::size_t kSlots = 1 << kBits;
+    static constexpr std::size_t kMask = kSlots - 1;
+    static constexpr std::size_t kLevels = 4;
+
+    // Element is placed on the lowest level where expiration time and current moment fall into the same slot of
+    // the next level, so the wheel gets to its slot before it expires. Expiration time below the given minimum
+    // is rounded up to it
+    void place(T &node, uint32_t min_expire) {
+        uint32_t expire = node.expire > min_expire ? node.expire : min_expire;
+        uint32_t diff = expire ^ _now;
+
+        std::size_t level = 0;
+        while (level < kLevels && (uint64_t(diff) >> (kBits * (level + 1))) != 0) {
+            level++;
+        }
+
+        std::size_t slot;
+        if (level < kLevels) {
+            slot = level * kSlots + ((expire >> (kBits * level)) & kMask);
+        } else {
+            // Beyond the top level element is parked in the first top level slot, which is cascaded once the
+            // whole wheel makes a circle, and placed again then
+            slot = (kLevels - 1) * kSlots;
+        }
+
+        node.timer_slot = slot;
+        node.timer_prev = nullptr;
+        node.timer_next = _slots[slot];
+        if (_slots[slot] != nullptr) {
+            _slots[slot]->timer_prev = &node;
+        }
+        _slots[slot] = &node;
+    }
+
+    T *detach(std::size_t level, std::size_t index) {
+        T *head = _slots[level * kSlots + index];
+        _slots[level * kSlots + index] = nullptr;
+        return head;
+    }
+
+    void cascade(std::size_t level, std::size_t index) {
+        T *node = detach(level, index);
+        while (node != nullptr) {
+            T *next = node->timer_next;
+            place(*node, _now);
+            node = next;
+        }
+    }
+
+    // Moment wheel has been advanced to
+    uint32_t _now;
+
+    // Number of elements in the wheel
+    std::size_t _size;
+
+    // Heads of element lists, level by level
+    T *_slots[kLevels * kSlots];
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_TIMER_WHEEL_H
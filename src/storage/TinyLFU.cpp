@@ -0,0 +1,496 @@
+#include "TinyLFU.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+namespace Afina {
+namespace Backend {
+
+TinyLFU::TinyLFU(size_t max_size)
+    : _max_size(max_size), _versions(0), _sketch(max_size / EntrySize(16, 32)), _timers(std::time(nullptr)) {
+    _window_max = _max_size / 100;
+    _main_max = _max_size - _window_max;
+    _protected_max = _main_max / 5 * 4;
+}
+
+TinyLFU::~TinyLFU() {
+    _index.clear();
+    for (lfu_list *list : {&_window, &_probation, &_protected}) {
+        while (list->head != nullptr) {
+            lfu_node *next = list->head->next;
+            delete_node(list->head);
+            list->head = next;
+        }
+    }
+}
+
+// See TinyLFU.h
+std::size_t TinyLFU::EntrySize(std::size_t key_size, std::size_t value_size) {
+    // Index keeps load factor between 7/16 and 7/8, so account two slots per entry
+    return sizeof(lfu_node) + key_size + value_size + 2 * HashIndex<lfu_node>::slot_size();
+}
+
+void TinyLFU::lfu_list::push_tail(lfu_node &node) {
+    node.prev = tail;
+    node.next = nullptr;
+    if (tail != nullptr) {
+        tail->next = &node;
+    } else {
+        head = &node;
+    }
+    tail = &node;
+    size += node_size(node);
+}
+
+void TinyLFU::lfu_list::unlink(lfu_node &node) {
+    if (node.prev != nullptr) {
+        node.prev->next = node.next;
+    } else {
+        head = node.next;
+    }
+
+    if (node.next != nullptr) {
+        node.next->prev = node.prev;
+    } else {
+        tail = node.prev;
+    }
+    node.prev = nullptr;
+    node.next = nullptr;
+    size -= node_size(node);
+}
+
+TinyLFU::lfu_node *TinyLFU::new_node(StringRef key, const std::string &value, std::size_t hash) {
+    void *memory = ::operator new(sizeof(lfu_node) + key.size() + value.size());
+    lfu_node *node = new (memory) lfu_node;
+    node->prev = nullptr;
+    node->next = nullptr;
+    node->hash = hash;
+    node->expire = 0;
+    node->timer_prev = nullptr;
+    node->timer_next = nullptr;
+    node->timer_slot = 0;
+    node->version = 0;
+    node->flags = 0;
+    node->key_size = key.size();
+    node->value_size = value.size();
+    node->segment = Segment::kWindow;
+    std::memcpy(node->key(), key.data(), key.size());
+    std::memcpy(node->value(), value.data(), value.size());
+    return node;
+}
+
+void TinyLFU::delete_node(lfu_node *node) {
+    node->~lfu_node();
+    ::operator delete(node);
+}
+
+std::size_t TinyLFU::node_size(const lfu_node &node) { return EntrySize(node.key_size, node.value_size); }
+
+TinyLFU::Meta TinyLFU::meta_of(const lfu_node &node) {
+    Meta meta;
+    meta.expire = node.expire;
+    meta.version = node.version;
+    meta.flags = node.flags;
+    return meta;
+}
+
+TinyLFU::lfu_list &TinyLFU::list_of(Segment segment) {
+    switch (segment) {
+    case Segment::kWindow:
+        return _window;
+    case Segment::kProbation:
+        return _probation;
+    default:
+        return _protected;
+    }
+}
+
+TinyLFU::lfu_node *TinyLFU::find_node(StringRef key, std::size_t hash) const {
+    return _index.find(hash, [&](const lfu_node &node) {
+        return node.hash == hash && node.key_size == key.size() && std::memcmp(node.key(), key.data(), key.size()) == 0;
+    });
+}
+
+TinyLFU::lfu_node *TinyLFU::find_live_node(StringRef key, std::size_t hash) {
+    int64_t moment = now();
+    expire_nodes(moment);
+
+    lfu_node *node = find_node(key, hash);
+    if (node != nullptr && node->expire != 0 && node->expire <= moment) {
+        remove(*node);
+        return nullptr;
+    }
+    return node;
+}
+
+void TinyLFU::expire_nodes(int64_t now) {
+    if (now <= 0) {
+        return;
+    }
+    _timers.advance(now, [this](lfu_node &node) {
+        // Node is out of the wheel already
+        node.expire = 0;
+        remove(node);
+    });
+}
+
+void TinyLFU::move(lfu_node &node, Segment segment) {
+    list_of(node.segment).unlink(node);
+    node.segment = segment;
+    list_of(segment).push_tail(node);
+}
+
+void TinyLFU::remove(lfu_node &node) {
+    if (node.expire != 0) {
+        _timers.remove(node);
+    }
+    _index.erase(&node);
+    list_of(node.segment).unlink(node);
+    delete_node(&node);
+}
+
+void TinyLFU::insert(StringRef key, const std::string &value, std::size_t hash, Segment segment, const Meta &meta) {
+    lfu_node *node = new_node(key, value, hash);
+    node->expire = meta.expire;
+    node->flags = meta.flags;
+    node->version = ++_versions;
+    node->segment = segment;
+    list_of(segment).push_tail(*node);
+    _index.insert(node);
+    if (node->expire != 0) {
+        _timers.add(*node);
+    }
+}
+
+void TinyLFU::on_hit(lfu_node &node) {
+    switch (node.segment) {
+    case Segment::kWindow:
+        move(node, Segment::kWindow);
+        break;
+    case Segment::kProbation:
+        move(node, Segment::kProtected);
+        break;
+    case Segment::kProtected:
+        move(node, Segment::kProtected);
+        break;
+    }
+    rebalance();
+}
+
+void TinyLFU::rebalance() {
+    // Protected overflow goes back to probation, where it competes with admission candidates
+    while (_protected.size > _protected_max && _protected.head != nullptr) {
+        move(*_protected.head, Segment::kProbation);
+    }
+
+    // Window overflow: candidates compete for the main region. The most recent entry always stays in window
+    while (_window.size > _window_max && _window.head != _window.tail) {
+        lfu_node *candidate = _window.head;
+        std::size_t candidate_size = node_size(*candidate);
+        uint32_t candidate_frequency = _sketch.frequency(candidate->hash);
+
+        // Find victims to be evicted from main so that candidate fits, candidate must beat each one of them
+        bool admit = true;
+        std::size_t released = 0;
+        lfu_node *victim = _probation.head != nullptr ? _probation.head : _protected.head;
+        while (_probation.size + _protected.size + candidate_size > _main_max + released) {
+            if (victim == nullptr || candidate_frequency <= _sketch.frequency(victim->hash)) {
+                admit = false;
+                break;
+            }
+            released += node_size(*victim);
+            victim = (victim->next == nullptr && victim->segment == Segment::kProbation) ? _protected.head
+                                                                                          : victim->next;
+        }
+
+        if (!admit) {
+            evicted(StringRef(candidate->key(), candidate->key_size));
+            remove(*candidate);
+            continue;
+        }
+
+        while (released > 0) {
+            lfu_node *oldest = _probation.head != nullptr ? _probation.head : _protected.head;
+            released -= node_size(*oldest);
+            evicted(StringRef(oldest->key(), oldest->key_size));
+            remove(*oldest);
+        }
+        move(*candidate, Segment::kProbation);
+    }
+
+    // Oversized window entry could break the total budget, main gives way then
+    while (_window.size + _probation.size + _protected.size > _max_size) {
+        lfu_node *victim = _probation.head != nullptr ? _probation.head : _protected.head;
+        if (victim == nullptr) {
+            break;
+        }
+        evicted(StringRef(victim->key(), victim->key_size));
+        remove(*victim);
+    }
+}
+
+void TinyLFU::set_node(lfu_node &node, const std::string &value, const Meta &meta) {
+    std::string key(node.key(), node.key_size);
+    std::size_t hash = node.hash;
+    remove(node);
+    insert(key, value, hash, Segment::kWindow, meta);
+    rebalance();
+}
+
+// See MapBasedGlobalLockImpl.h
+bool TinyLFU::Put(const std::string &key, const std::string &value) { return TinyLFU::Put(key, value, Meta()); }
+
+// See MapBasedGlobalLockImpl.h
+bool TinyLFU::Put(const std::string &key, const std::string &value, const Meta &meta) {
+    return TinyLFU::Put(StringRef(key), value, meta);
+}
+
+// See MapBasedGlobalLockImpl.h
+bool TinyLFU::Put(StringRef key, const std::string &value, const Meta &meta) {
+    if (EntrySize(key.size(), value.size()) > _main_max) {
+        return false;
+    }
+
+    std::size_t hash = HashKey(key);
+    _sketch.increment(hash);
+    lfu_node *node = find_live_node(key, hash);
+    if (meta.expired(now())) {
+        if (node != nullptr) {
+            remove(*node);
+        }
+    } else if (node != nullptr) {
+        set_node(*node, value, meta);
+    } else {
+        insert(key, value, hash, Segment::kWindow, meta);
+        rebalance();
+    }
+    return true;
+}
+
+// See MapBasedGlobalLockImpl.h
+bool TinyLFU::PutIfAbsent(const std::string &key, const std::string &value) {
+    return TinyLFU::PutIfAbsent(key, value, Meta());
+}
+
+// See MapBasedGlobalLockImpl.h
+bool TinyLFU::PutIfAbsent(const std::string &key, const std::string &value, const Meta &meta) {
+    return TinyLFU::PutIfAbsent(StringRef(key), value, meta);
+}
+
+// See MapBasedGlobalLockImpl.h
+bool TinyLFU::PutIfAbsent(StringRef key, const std::string &value, const Meta &meta) {
+    if (EntrySize(key.size(), value.size()) > _main_max) {
+        return false;
+    }
+
+    std::size_t hash = HashKey(key);
+    _sketch.increment(hash);
+    if (find_live_node(key, hash) != nullptr) {
+        return false;
+    }
+    if (!meta.expired(now())) {
+        insert(key, value, hash, Segment::kWindow, meta);
+        rebalance();
+    }
+    return true;
+}
+
+// See MapBasedGlobalLockImpl.h
+bool TinyLFU::Set(const std::string &key, const std::string &value) { return TinyLFU::Set(key, value, Meta()); }
+
+// See MapBasedGlobalLockImpl.h
+bool TinyLFU::Set(const std::string &key, const std::string &value, const Meta &meta) {
+    return TinyLFU::Set(StringRef(key), value, meta);
+}
+
+// See MapBasedGlobalLockImpl.h
+bool TinyLFU::Set(StringRef key, const std::string &value, const Meta &meta) {
+    if (EntrySize(key.size(), value.size()) > _main_max) {
+        return false;
+    }
+
+    std::size_t hash = HashKey(key);
+    lfu_node *node = find_live_node(key, hash);
+    if (node == nullptr) {
+        return false;
+    }
+    _sketch.increment(hash);
+    if (meta.expired(now())) {
+        remove(*node);
+    } else {
+        set_node(*node, value, meta);
+    }
+    return true;
+}
+
+// See MapBasedGlobalLockImpl.h
+TinyLFU::CasStatus TinyLFU::CompareAndSet(const std::string &key, const std::string &value, const Meta &meta,
+                                          uint64_t version) {
+    std::size_t hash = HashKey(key);
+    lfu_node *node = find_live_node(key, hash);
+    if (node == nullptr) {
+        return CasStatus::kNotFound;
+    } else if (node->version != version) {
+        return CasStatus::kExists;
+    } else if (EntrySize(key.size(), value.size()) > _main_max) {
+        return CasStatus::kNotStored;
+    }
+
+    _sketch.increment(hash);
+    if (meta.expired(now())) {
+        remove(*node);
+    } else {
+        set_node(*node, value, meta);
+    }
+    return CasStatus::kStored;
+}
+
+bool TinyLFU::join(const std::string &key, const std::string &data, bool front) {
+    std::size_t hash = HashKey(key);
+    lfu_node *node = find_live_node(key, hash);
+    if (node == nullptr || EntrySize(key.size(), node->value_size + data.size()) > _main_max) {
+        return false;
+    }
+    _sketch.increment(hash);
+
+    std::string value;
+    value.reserve(node->value_size + data.size());
+    if (front) {
+        value.append(data).append(node->value(), node->value_size);
+    } else {
+        value.append(node->value(), node->value_size).append(data);
+    }
+    set_node(*node, value, meta_of(*node));
+    return true;
+}
+
+// See MapBasedGlobalLockImpl.h
+bool TinyLFU::Append(const std::string &key, const std::string &data) { return join(key, data, false); }
+
+// See MapBasedGlobalLockImpl.h
+bool TinyLFU::Prepend(const std::string &key, const std::string &data) { return join(key, data, true); }
+
+TinyLFU::CounterStatus TinyLFU::update_node(const std::string &key, uint64_t delta, bool decrement,
+                                            uint64_t &value) {
+    std::size_t hash = HashKey(key);
+    lfu_node *node = find_live_node(key, hash);
+    if (node == nullptr) {
+        return CounterStatus::kNotFound;
+    }
+    if (!parse_counter(node->value(), node->value_size, value)) {
+        return CounterStatus::kNotNumber;
+    }
+    _sketch.increment(hash);
+    value = count(value, delta, decrement);
+    set_node(*node, std::to_string(value), meta_of(*node));
+    return CounterStatus::kUpdated;
+}
+
+// See MapBasedGlobalLockImpl.h
+TinyLFU::CounterStatus TinyLFU::Increment(const std::string &key, uint64_t delta, uint64_t &value) {
+    return update_node(key, delta, false, value);
+}
+
+// See MapBasedGlobalLockImpl.h
+TinyLFU::CounterStatus TinyLFU::Decrement(const std::string &key, uint64_t delta, uint64_t &value) {
+    return update_node(key, delta, true, value);
+}
+
+// See MapBasedGlobalLockImpl.h
+bool TinyLFU::Delete(const std::string &key) {
+    lfu_node *node = find_live_node(key, HashKey(key));
+    if (node == nullptr) {
+        return false;
+    }
+    remove(*node);
+    return true;
+}
+
+// See MapBasedGlobalLockImpl.h
+bool TinyLFU::Get(const std::string &key, std::string &value) { return TinyLFU::Get(StringRef(key), value); }
+
+// See MapBasedGlobalLockImpl.h
+bool TinyLFU::Get(StringRef key, std::string &value) {
+    std::size_t hash = HashKey(key);
+    _sketch.increment(hash);
+    lfu_node *node = find_live_node(key, hash);
+    if (node == nullptr) {
+        return false;
+    }
+    value.assign(node->value(), node->value_size);
+    on_hit(*node);
+    return true;
+}
+
+// See MapBasedGlobalLockImpl.h
+std::size_t TinyLFU::MultiGet(const std::vector<StringRef> &keys, std::vector<ValueRef> &values,
+                              std::vector<Meta> *metas, bool versions) {
+    std::size_t found = 0;
+    values.resize(keys.size());
+    if (metas != nullptr) {
+        metas->assign(keys.size(), Meta());
+    }
+    for (std::size_t i = 0; i < keys.size(); i++) {
+        values[i].reset();
+        std::size_t hash = HashKey(keys[i]);
+        _sketch.increment(hash);
+        lfu_node *node = find_live_node(keys[i], hash);
+        if (node == nullptr) {
+            continue;
+        }
+        values[i] = ValueRef::Copy(std::string(node->value(), node->value_size));
+        if (metas != nullptr) {
+            (*metas)[i] = meta_of(*node);
+        }
+        on_hit(*node);
+        found++;
+    }
+    return found;
+}
+
+// See MapBasedGlobalLockImpl.h
+bool TinyLFU::Export(const std::function<void(Item &item)> &visit) {
+    std::vector<Item> items;
+    Collect(items);
+    for (Item &item : items) {
+        visit(item);
+    }
+    return true;
+}
+
+// See TinyLFU.h
+void TinyLFU::Collect(std::vector<Item> &items) {
+    // Main region first, so window entries, the most recent ones, come last
+    int64_t moment = now();
+    for (lfu_list *list : {&_probation, &_protected, &_window}) {
+        for (lfu_node *node = list->head; node != nullptr; node = node->next) {
+            Meta meta = meta_of(*node);
+            if (!meta.expired(moment)) {
+                items.emplace_back(std::string(node->key(), node->key_size),
+                                   ValueRef::Copy(std::string(node->value(), node->value_size)), meta);
+            }
+        }
+    }
+}
+
+// See TinyLFU.h
+uint64_t TinyLFU::Scan(uint64_t cursor, std::size_t count, std::vector<std::string> &keys) {
+    int64_t moment = now();
+    std::size_t batch = std::max<std::size_t>(count, 1);
+    std::size_t wanted = keys.size() + batch;
+    for (std::size_t groups = 0; groups < batch && keys.size() < wanted; groups++) {
+        cursor = _index.scan(cursor, [&](const lfu_node &node) {
+            if ((node.expire == 0 || node.expire > moment)) {
+                keys.emplace_back(node.key(), node.key_size);
+            }
+        });
+        if (cursor == 0) {
+            break;
+        }
+    }
+    return cursor;
+}
+
+} // namespace Backend
+} // namespace Afina
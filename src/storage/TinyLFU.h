@@ -0,0 +1,225 @@
+#ifndef AFINA_STORAGE_TINY_LFU_H
+#define AFINA_STORAGE_TINY_LFU_H
+
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <afina/Storage.h>
+
+#include "FrequencySketch.h"
+#include "HashIndex.h"
+#include "KeyHash.h"
+#include "TimerWheel.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # W-TinyLFU implementation
+ * That is NOT thread safe implementaiton!!
+ *
+ * Storage budget is split in two regions:
+ * - window: small LRU (1% of budget) every new entry gets into first
+ * - main: segmented LRU of probation (20% of main) and protected (80% of main) lists. Entry hit in probation
+ *   gets promoted to protected, protected overflow gets demoted back to probation
+ *
+ * Entries pushed out of the window are candidates for the main region. Once main is full candidate competes
+ * with the eviction victim, the probation head, and only gets admitted if it is accessed more often according
+ * to the frequency sketch. So scans and one-hit-wonders can't flush frequently used entries out.
+ *
+ * Entries that expire are tracked by a TimerWheel, which every lookup advances: expired entry is dropped and
+ * its bytes are released once its time comes, not once the key is touched again.
+ */
+class TinyLFU : public Afina::Storage {
+public:
+    TinyLFU(size_t max_size = 1024);
+    ~TinyLFU();
+
+    // Implements Afina::Storage interface
+    bool Put(const std::string &key, const std::string &value) override;
+
+    // Implements Afina::Storage interface
+    bool Put(const std::string &key, const std::string &value, const Meta &meta) override;
+
+    // Implements Afina::Storage interface
+    bool Put(StringRef key, const std::string &value, const Meta &meta) override;
+
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(const std::string &key, const std::string &value) override;
+
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(const std::string &key, const std::string &value, const Meta &meta) override;
+
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(StringRef key, const std::string &value, const Meta &meta) override;
+
+    // Implements Afina::Storage interface
+    bool Set(const std::string &key, const std::string &value) override;
+
+    // Implements Afina::Storage interface
+    bool Set(const std::string &key, const std::string &value, const Meta &meta) override;
+
+    // Implements Afina::Storage interface
+    bool Set(StringRef key, const std::string &value, const Meta &meta) override;
+
+    // Implements Afina::Storage interface
+    CasStatus CompareAndSet(const std::string &key, const std::string &value, const Meta &meta,
+                            uint64_t version) override;
+
+    // Implements Afina::Storage interface
+    bool Append(const std::string &key, const std::string &data) override;
+
+    // Implements Afina::Storage interface
+    bool Prepend(const std::string &key, const std::string &data) override;
+
+    // Implements Afina::Storage interface
+    CounterStatus Increment(const std::string &key, uint64_t delta, uint64_t &value) override;
+
+    // Implements Afina::Storage interface
+    CounterStatus Decrement(const std::string &key, uint64_t delta, uint64_t &value) override;
+
+    // Implements Afina::Storage interface
+    bool Delete(const std::string &key) override;
+
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, std::string &value) override;
+
+    // Implements Afina::Storage interface
+    bool Get(StringRef key, std::string &value) override;
+
+    // MultiGet of std::string keys is the default one
+    using Afina::Storage::MultiGet;
+
+    // Implements Afina::Storage interface
+    std::size_t MultiGet(const std::vector<StringRef> &keys, std::vector<ValueRef> &values,
+                         std::vector<Meta> *metas, bool versions) override;
+
+    // Implements Afina::Storage interface, the whole storage is a single part
+    bool Export(const std::function<void(Item &item)> &visit) override;
+
+    // Implements Afina::Storage interface. Keys come in the order of index groups, see HashIndex::scan, and each
+    // call visits count groups at most
+    uint64_t Scan(uint64_t cursor, std::size_t count, std::vector<std::string> &keys) override;
+
+    /**
+     * Appends copies of all resident entries to items, see Export. Doesn't change frequencies or lists
+     */
+    virtual void Collect(std::vector<Item> &items);
+
+    /**
+     * Number of bytes of the storage budget single entry with given key and value sizes occupies
+     */
+    static std::size_t EntrySize(std::size_t key_size, std::size_t value_size);
+
+protected:
+    // Current unix time, see Meta::expire
+    virtual int64_t now() const { return std::time(nullptr); }
+
+private:
+    enum class Segment : uint8_t { kWindow, kProbation, kProtected };
+
+    // Cache node, header followed by key bytes and then by value bytes in the same memory block
+    struct lfu_node {
+        lfu_node *prev;
+        lfu_node *next;
+        std::size_t hash;
+
+        // See Meta::expire
+        int64_t expire;
+
+        // Links of the expiration timer wheel, used only if entry expires
+        lfu_node *timer_prev;
+        lfu_node *timer_next;
+        uint8_t timer_slot;
+
+        // Changes along with the value, see Meta::version
+        uint64_t version;
+
+        uint32_t key_size;
+        uint32_t value_size;
+
+        // See Meta::flags
+        uint32_t flags;
+        Segment segment;
+
+        char *key() { return reinterpret_cast<char *>(this + 1); }
+        const char *key() const { return reinterpret_cast<const char *>(this + 1); }
+
+        char *value() { return key() + key_size; }
+        const char *value() const { return key() + key_size; }
+    };
+
+    // Intrusive LRU list, head is the least recently used entry
+    struct lfu_list {
+        lfu_list() : head(nullptr), tail(nullptr), size(0) {}
+
+        void push_tail(lfu_node &node);
+        void unlink(lfu_node &node);
+
+        lfu_node *head;
+        lfu_node *tail;
+
+        // Total size of entries in the list
+        std::size_t size;
+    };
+
+    static lfu_node *new_node(StringRef key, const std::string &value, std::size_t hash);
+    static void delete_node(lfu_node *node);
+    static std::size_t node_size(const lfu_node &node);
+
+    // Attributes of the entry
+    static Meta meta_of(const lfu_node &node);
+
+    lfu_list &list_of(Segment segment);
+    lfu_node *find_node(StringRef key, std::size_t hash) const;
+
+    // Same as find_node, but entry that has expired is removed and not returned
+    lfu_node *find_live_node(StringRef key, std::size_t hash);
+
+    // Drops entries expired by the given moment
+    void expire_nodes(int64_t now);
+
+    void on_hit(lfu_node &node);
+    void insert(StringRef key, const std::string &value, std::size_t hash, Segment segment, const Meta &meta);
+    void remove(lfu_node &node);
+    void move(lfu_node &node, Segment segment);
+
+    // Restore segments size limits after insert or update
+    void rebalance();
+
+    // Replaces value of the existing entry, which starts over in the window
+    void set_node(lfu_node &node, const std::string &value, const Meta &meta);
+
+    // Adds data to the value of the existing key, at the beginning if front is set or at the end otherwise
+    bool join(const std::string &key, const std::string &data, bool front);
+
+    // Updates counter of the existing key, see Increment
+    CounterStatus update_node(const std::string &key, uint64_t delta, bool decrement, uint64_t &value);
+
+    // Maximum number of bytes could be stored in this cache, see EntrySize
+    std::size_t _max_size;
+    std::size_t _window_max;
+    std::size_t _protected_max;
+    std::size_t _main_max;
+
+    lfu_list _window;
+    lfu_list _probation;
+    lfu_list _protected;
+
+    // Last version assigned to a node
+    uint64_t _versions;
+
+    FrequencySketch _sketch;
+    HashIndex<lfu_node> _index;
+
+    // Expiration times of entries that expire
+    TimerWheel<lfu_node> _timers;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_TINY_LFU_H
@@ -0,0 +1,40 @@
+#ifndef AFINA_STORAGE_VARINT_H
+#define AFINA_STORAGE_VARINT_H
+
+#include <cstdint>
+#include <string>
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * Appends value as LEB128 varint: 7 bits per byte, least significant first, high bit set on all bytes but the
+ * last one. Sizes and times used by storage files mostly fit one or two bytes
+ */
+inline void PutVarint(std::string &out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+/**
+ * Reads varint written by PutVarint and advances p past it. Returns false if input ends before the varint does
+ */
+inline bool GetVarint(const char *&p, const char *end, uint64_t &value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        uint8_t byte = static_cast<uint8_t>(*p++);
+        value |= uint64_t(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_VARINT_H
@@ -4,7 +4,12 @@
 #include <string>
 
 #include <afina/execute/Add.h>
+#include <afina/execute/Cas.h>
+#include <afina/execute/Decr.h>
 #include <afina/execute/Get.h>
+#include <afina/execute/Incr.h>
+#include <afina/execute/Prepend.h>
+#include <afina/execute/Scan.h>
 #include <afina/execute/Set.h>
 #include <afina/execute/Stats.h>
 
@@ -58,6 +63,131 @@ TEST(MemcachedParserTest, SimpleAdd) {
     ASSERT_EQ(-1, tmp->expire());
 }
 
+// Verify prepend command passed in a single string
+TEST(MemcachedParserTest, SimplePrepend) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0;
+    bool cmd_avail = parser.Parse("prepend foo 0 0 3\r\npre\r\n", consumed);
+    ASSERT_TRUE(cmd_avail);
+    ASSERT_EQ(19, consumed);
+    ASSERT_EQ("prepend", parser.Name());
+
+    size_t value_size;
+    std::unique_ptr<Execute::Command> cmd = parser.Build(value_size);
+    ASSERT_FALSE(cmd == nullptr);
+    ASSERT_EQ(3, value_size);
+
+    Execute::Prepend *tmp = dynamic_cast<Execute::Prepend *>(cmd.get());
+    ASSERT_FALSE(tmp == nullptr);
+    ASSERT_EQ("foo", tmp->key());
+}
+
+// Verify incr and decr commands passed in a single string
+TEST(MemcachedParserTest, IncrDecr) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0;
+    ASSERT_TRUE(parser.Parse("incr counter 18446744073709551615\r\n", consumed));
+    ASSERT_EQ(35, consumed);
+    ASSERT_EQ("incr", parser.Name());
+
+    size_t value_size;
+    std::unique_ptr<Execute::Command> cmd = parser.Build(value_size);
+    ASSERT_EQ(0, value_size);
+    Execute::Incr *incr = dynamic_cast<Execute::Incr *>(cmd.get());
+    ASSERT_FALSE(incr == nullptr);
+    ASSERT_EQ("counter", incr->key());
+    ASSERT_EQ(UINT64_MAX, incr->delta());
+
+    parser.Reset();
+    consumed = 0;
+    ASSERT_TRUE(parser.Parse("decr counter 7\r\n", consumed));
+    cmd = parser.Build(value_size);
+    Execute::Decr *decr = dynamic_cast<Execute::Decr *>(cmd.get());
+    ASSERT_FALSE(decr == nullptr);
+    ASSERT_EQ("counter", decr->key());
+    ASSERT_EQ(7, decr->delta());
+    ASSERT_FALSE(parser.NoReply());
+
+    parser.Reset();
+    consumed = 0;
+    ASSERT_TRUE(parser.Parse("incr counter 3 noreply\r\nget counter\r\n", consumed));
+    ASSERT_EQ(24, consumed);
+    ASSERT_TRUE(parser.NoReply());
+    cmd = parser.Build(value_size);
+    incr = dynamic_cast<Execute::Incr *>(cmd.get());
+    ASSERT_FALSE(incr == nullptr);
+    ASSERT_EQ("counter", incr->key());
+    ASSERT_EQ(3, incr->delta());
+
+    parser.Reset();
+    consumed = 0;
+    ASSERT_THROW(parser.Parse("incr counter\r\n", consumed), std::runtime_error);
+
+    parser.Reset();
+    consumed = 0;
+    ASSERT_THROW(parser.Parse("incr counter 3 4\r\n", consumed), std::runtime_error);
+
+    parser.Reset();
+    consumed = 0;
+    ASSERT_THROW(parser.Parse("incr counter 18446744073709551616\r\n", consumed), std::runtime_error);
+}
+
+// Verify cas and gets commands passed in a single string
+TEST(MemcachedParserTest, CasGets) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0;
+    ASSERT_TRUE(parser.Parse("cas foo 5 0 3 12345678901\r\nbar\r\n", consumed));
+    ASSERT_EQ(27, consumed);
+    ASSERT_EQ("cas", parser.Name());
+
+    size_t value_size;
+    std::unique_ptr<Execute::Command> cmd = parser.Build(value_size);
+    ASSERT_EQ(3, value_size);
+    Execute::Cas *cas = dynamic_cast<Execute::Cas *>(cmd.get());
+    ASSERT_FALSE(cas == nullptr);
+    ASSERT_EQ("foo", cas->key());
+    ASSERT_EQ(5, cas->flags());
+    ASSERT_EQ(12345678901ULL, cas->version());
+    ASSERT_FALSE(parser.NoReply());
+
+    parser.Reset();
+    consumed = 0;
+    ASSERT_TRUE(parser.Parse("cas foo 0 0 3 5 noreply\r\nbar\r\n", consumed));
+    ASSERT_TRUE(parser.NoReply());
+    cmd = parser.Build(value_size);
+    cas = dynamic_cast<Execute::Cas *>(cmd.get());
+    ASSERT_FALSE(cas == nullptr);
+    ASSERT_EQ(5, cas->version());
+
+    parser.Reset();
+    consumed = 0;
+    ASSERT_THROW(parser.Parse("cas foo 0 0 3 1 2\r\n", consumed), std::runtime_error);
+
+    parser.Reset();
+    consumed = 0;
+    ASSERT_THROW(parser.Parse("cas foo 0 0 3\r\n", consumed), std::runtime_error);
+
+    parser.Reset();
+    consumed = 0;
+    ASSERT_THROW(parser.Parse("cas foo 0 0 3 \r\n", consumed), std::runtime_error);
+
+    parser.Reset();
+    consumed = 0;
+    ASSERT_THROW(parser.Parse("cas foo 0 0 3 1x\r\n", consumed), std::runtime_error);
+
+    parser.Reset();
+    consumed = 0;
+    ASSERT_TRUE(parser.Parse("gets foo bar\r\n", consumed));
+    cmd = parser.Build(value_size);
+    Execute::Get *gets = dynamic_cast<Execute::Get *>(cmd.get());
+    ASSERT_FALSE(gets == nullptr);
+    ASSERT_TRUE(gets->versions());
+    ASSERT_EQ(2, gets->keys().size());
+}
+
 // Verify simple get command passed in a single string
 TEST(MemcachedParserTest, SimpleGet) {
     Protocol::Parser parser;
@@ -98,3 +228,31 @@ TEST(MemcachedParserTest, Stats) {
     Execute::Stats *tmp = reinterpret_cast<Execute::Stats *>(cmd.get());
     ASSERT_FALSE(tmp == nullptr);
 }
+
+TEST(MemcachedParserTest, Scan) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0;
+    bool cmd_avail = parser.Parse("scan 281474976710656 20\r\n", consumed);
+    ASSERT_TRUE(cmd_avail);
+    ASSERT_EQ(25, consumed);
+    ASSERT_EQ("scan", parser.Name());
+
+    size_t value_size;
+    std::unique_ptr<Execute::Command> cmd = parser.Build(value_size);
+    ASSERT_FALSE(cmd == nullptr);
+    ASSERT_EQ(0, value_size);
+
+    Execute::Scan *tmp = reinterpret_cast<Execute::Scan *>(cmd.get());
+    ASSERT_EQ(281474976710656u, tmp->cursor());
+    ASSERT_EQ(20, tmp->count());
+
+    parser.Reset();
+    ASSERT_TRUE(parser.Parse("scan 0\r\n", consumed));
+    cmd = parser.Build(value_size);
+    ASSERT_EQ(Execute::Scan::kDefaultCount, reinterpret_cast<Execute::Scan *>(cmd.get())->count());
+
+    parser.Reset();
+    ASSERT_TRUE(parser.Parse("scan x1\r\n", consumed));
+    ASSERT_THROW(parser.Build(value_size), std::runtime_error);
+}
@@ -1,16 +1,42 @@
 #include "gtest/gtest.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <iterator>
 #include <set>
+#include <thread>
 #include <vector>
 
 #include <afina/execute/Add.h>
 #include <afina/execute/Append.h>
+#include <afina/execute/Cas.h>
+#include <afina/execute/Decr.h>
 #include <afina/execute/Delete.h>
 #include <afina/execute/Get.h>
+#include <afina/execute/Incr.h>
+#include <afina/execute/Prepend.h>
+#include <afina/execute/Response.h>
+#include <afina/execute/Scan.h>
 #include <afina/execute/Set.h>
+#include <afina/execute/Stats.h>
 
+#include "storage/ARC.h"
+#include "storage/ColdTier.h"
+#include "storage/CuckooFilter.h"
+#include "storage/EpochStripedLRU.h"
+#include "storage/LoggedStorage.h"
+#include "storage/Lz.h"
+#include "storage/NodePool.h"
+#include "storage/SharedMemoryLRU.h"
 #include "storage/SimpleLRU.h"
+#include "storage/Snapshot.h"
+#include "storage/StripedLockLRU.h"
+#include "storage/TimerWheel.h"
+#include "storage/TinyLFU.h"
 
 using namespace Afina::Backend;
 using namespace Afina::Execute;
@@ -147,7 +173,7 @@ std::string pad_space(const std::string &s, size_t length) {
 
 TEST(StorageTest, BigTest) {
     const size_t length = 20;
-    SimpleLRU storage(2 * 100000 * length);
+    SimpleLRU storage(100000 * SimpleLRU::EntrySize(length, length));
 
     for (long i = 0; i < 100000; ++i) {
         auto key = pad_space("Key " + std::to_string(i), length);
@@ -168,7 +194,7 @@ TEST(StorageTest, BigTest) {
 
 TEST(StorageTest, MaxTest) {
     const size_t length = 20;
-    SimpleLRU storage(2 * 1000 * length);
+    SimpleLRU storage(1000 * SimpleLRU::EntrySize(length, length));
 
     std::stringstream ss;
 
@@ -195,3 +221,1786 @@ TEST(StorageTest, MaxTest) {
         EXPECT_FALSE(storage.Get(key, res));
     }
 }
+
+TEST(StorageTest, DeleteReinsert) {
+    const size_t length = 20;
+    SimpleLRU storage(10000 * SimpleLRU::EntrySize(length, length));
+
+    // Many delete/insert rounds leave plenty of tombstones in the index
+    for (long round = 0; round < 10; ++round) {
+        for (long i = 0; i < 10000; ++i) {
+            auto key = pad_space("Key " + std::to_string(i), length);
+            auto val = pad_space("Val " + std::to_string(i + round), length);
+            EXPECT_TRUE(storage.Put(key, val));
+        }
+
+        for (long i = round % 2; i < 10000; i += 2) {
+            auto key = pad_space("Key " + std::to_string(i), length);
+            EXPECT_TRUE(storage.Delete(key));
+        }
+    }
+
+    for (long i = 0; i < 10000; ++i) {
+        auto key = pad_space("Key " + std::to_string(i), length);
+        auto val = pad_space("Val " + std::to_string(i + 9), length);
+
+        std::string res;
+        if (i % 2 == 0) {
+            EXPECT_TRUE(storage.Get(key, res));
+            EXPECT_TRUE(val == res);
+        } else {
+            EXPECT_FALSE(storage.Get(key, res));
+        }
+    }
+}
+
+TEST(StorageTest, GrowValueEvictsOldest) {
+    SimpleLRU storage(3 * SimpleLRU::EntrySize(4, 4));
+
+    EXPECT_TRUE(storage.Put("KEY1", "val1"));
+    EXPECT_TRUE(storage.Put("KEY2", "val2"));
+    EXPECT_TRUE(storage.Put("KEY3", "val3"));
+
+    // Budget doesn't fit new value without eviction of the least recently used entry
+    EXPECT_TRUE(storage.Set("KEY1", "val1val1"));
+
+    std::string value;
+    EXPECT_FALSE(storage.Get("KEY2", value));
+    EXPECT_TRUE(storage.Get("KEY3", value));
+    EXPECT_TRUE(value == "val3");
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_TRUE(value == "val1val1");
+
+    // Entry larger than the whole budget is rejected
+    EXPECT_FALSE(storage.Put("KEY4", std::string(3 * SimpleLRU::EntrySize(4, 4), 'x')));
+}
+
+TEST(StorageTest, PinnedValue) {
+    SimpleLRU storage(3 * SimpleLRU::EntrySize(4, 4));
+    EXPECT_TRUE(storage.Put("KEY1", "val1"));
+
+    Afina::ValueRef pinned;
+    EXPECT_TRUE(storage.Get("KEY1", pinned));
+    EXPECT_EQ(pinned.str(), "val1");
+
+    // Pinned value stays intact through update, removal and eviction
+    EXPECT_TRUE(storage.Put("KEY1", "new1"));
+    Afina::ValueRef updated;
+    EXPECT_TRUE(storage.Get("KEY1", updated));
+    EXPECT_EQ(updated.str(), "new1");
+    EXPECT_TRUE(storage.Delete("KEY1"));
+    for (int i = 0; i < 10; i++) {
+        EXPECT_TRUE(storage.Put("KEY" + std::to_string(i), "val" + std::to_string(i)));
+    }
+    EXPECT_EQ(pinned.str(), "val1");
+    EXPECT_EQ(updated.str(), "new1");
+
+    Afina::ValueRef moved(std::move(pinned));
+    EXPECT_EQ(pinned.data(), nullptr);
+    EXPECT_EQ(moved.str(), "val1");
+
+    std::string value;
+    EXPECT_FALSE(storage.Get("KEY1", updated));
+    EXPECT_TRUE(storage.Get("KEY9", value));
+    EXPECT_EQ(value, "val9");
+}
+
+TEST(StorageTest, ExecuteGetResponse) {
+    SimpleLRU storage;
+    EXPECT_TRUE(storage.Put("KEY1", "val1"));
+    EXPECT_TRUE(storage.Put("KEY2", "val2"));
+
+    Get command({"KEY1", "KEY3", "KEY2"});
+    Response response;
+    command.Execute(storage, "", response);
+    EXPECT_EQ(response.str(), "VALUE KEY1 0 4\r\nval1\r\nVALUE KEY2 0 4\r\nval2\r\nEND");
+    EXPECT_EQ(response.size(), response.str().size());
+
+    std::string out;
+    command.Execute(storage, "", out);
+    EXPECT_EQ(out, response.str());
+}
+
+TEST(StorageTest, StringRefKeys) {
+    SimpleLRU lru;
+    StripedLockLRU striped(1024, 4);
+    for (Afina::Storage *storage : std::vector<Afina::Storage *>{&lru, &striped}) {
+        // Keys are parts of a single buffer, as they come from network
+        const char buffer[] = "get KEY1 KEY2\r\n";
+        Afina::StringRef key1(buffer + 4, 4), key2(buffer + 9, 4);
+
+        EXPECT_TRUE(storage->Put(key1, "val1", Afina::Storage::Meta()));
+        EXPECT_FALSE(storage->PutIfAbsent(key1, "val2", Afina::Storage::Meta()));
+        EXPECT_FALSE(storage->Set(key2, "val2", Afina::Storage::Meta()));
+        EXPECT_TRUE(storage->PutIfAbsent(key2, "val2", Afina::Storage::Meta()));
+
+        // Both kinds of keys refer the same associations
+        std::string value;
+        EXPECT_TRUE(storage->Get("KEY1", value));
+        EXPECT_EQ(value, "val1");
+        EXPECT_TRUE(storage->Set("KEY2", "new2"));
+        EXPECT_TRUE(storage->Get(key2, value));
+        EXPECT_EQ(value, "new2");
+
+        Afina::ValueRef pinned;
+        EXPECT_TRUE(storage->Get(key1, pinned));
+        EXPECT_EQ(pinned.str(), "val1");
+
+        EXPECT_TRUE(storage->Delete(key1));
+        EXPECT_FALSE(storage->Get("KEY1", value));
+        EXPECT_FALSE(storage->Delete(key1));
+    }
+}
+
+TEST(StorageTest, MultiGetPut) {
+    SimpleLRU lru;
+    StripedLockLRU striped(1024, 4);
+    TinyLFU lfu;
+    for (Afina::Storage *storage : std::vector<Afina::Storage *>{&lru, &striped, &lfu}) {
+        std::vector<std::string> keys, values;
+        for (int i = 0; i < 10; i++) {
+            keys.push_back("KEY" + std::to_string(i));
+            values.push_back("val" + std::to_string(i));
+        }
+        keys.push_back("KEY0");
+        values.push_back("new0");
+        EXPECT_EQ(storage->MultiPut(keys, values), 11);
+
+        std::vector<Afina::ValueRef> found;
+        std::vector<std::string> lookup = {"KEY3", "KEY10", "KEY0", "KEY9", "KEY3"};
+        EXPECT_EQ(storage->MultiGet(lookup, found), 4);
+        ASSERT_EQ(found.size(), lookup.size());
+        EXPECT_EQ(found[0].str(), "val3");
+        EXPECT_FALSE(found[1]);
+        EXPECT_EQ(found[2].str(), "new0");
+        EXPECT_EQ(found[3].str(), "val9");
+        EXPECT_EQ(found[4].str(), "val3");
+    }
+}
+
+TEST(StorageTest, StripedShards) {
+    // Shard count is rounded up to a power of two, zero picks the default
+    EXPECT_EQ(StripedLockLRU(1024, 1).shards(), 1);
+    EXPECT_EQ(StripedLockLRU(1024, 5).shards(), 8);
+    StripedLockLRU defaults;
+    EXPECT_GE(defaults.shards(), size_t(StripedLockLRU::kShardsPerCore));
+    EXPECT_EQ(defaults.shards() & (defaults.shards() - 1), 0);
+
+    StripedLockLRU storage(40 * SimpleLRU::EntrySize(5, 5), 3);
+    for (int i = 0; i < 20; i++) {
+        EXPECT_TRUE(storage.Put("KEY" + std::to_string(i), "val" + std::to_string(i)));
+    }
+    for (int i = 0; i < 20; i++) {
+        std::string value;
+        EXPECT_TRUE(storage.Get("KEY" + std::to_string(i), value));
+        EXPECT_EQ(value, "val" + std::to_string(i));
+    }
+}
+
+TEST(StorageTest, StripedSharedBudget) {
+    const size_t entry = SimpleLRU::EntrySize(6, 6);
+    StripedLockLRU storage(100 * entry, 4);
+
+    // Keys of the first shard and of all others, see StripedLockLRU::shard_index
+    std::vector<std::string> hot, cold;
+    for (int i = 0; hot.size() < 60 || cold.size() < 100; i++) {
+        std::string key = pad_space("K" + std::to_string(i), 6);
+        ((HashedKey(key).hash >> 32) % 4 == 0 ? hot : cold).push_back(key);
+    }
+    hot.resize(60);
+    cold.resize(100);
+
+    // Cold keys fill the whole budget, way more than a quarter of it
+    for (auto &key : cold) {
+        EXPECT_TRUE(storage.Put(key, "value0"));
+    }
+
+    // Hot shard takes space over, as other shards repay its demand while they are modified
+    for (int round = 0; round < 20; round++) {
+        for (auto &key : hot) {
+            EXPECT_TRUE(storage.Put(key, "value1"));
+        }
+        for (int i = 0; i < 20; i++) {
+            storage.Delete(cold[i]);
+        }
+    }
+
+    std::string value;
+    size_t hot_found = 0, cold_found = 0;
+    for (auto &key : hot) {
+        hot_found += storage.Get(key, value);
+    }
+    for (auto &key : cold) {
+        cold_found += storage.Get(key, value);
+    }
+    EXPECT_EQ(hot_found, hot.size());
+    EXPECT_LE(hot_found + cold_found, 100);
+}
+
+TEST(StorageTest, StripedReshard) {
+    StripedLockLRU storage(16 << 20, 2);
+    for (int i = 0; i < 2000; i++) {
+        storage.Put("key" + std::to_string(i), "value" + std::to_string(i));
+    }
+    std::vector<Afina::ValueRef> values;
+    std::vector<Afina::Storage::Meta> metas;
+    storage.MultiGet({"key1"}, values, metas);
+    uint64_t version = metas[0].version;
+
+    EXPECT_TRUE(storage.Reshard(8));
+    EXPECT_EQ(storage.shards(), 8);
+    EXPECT_TRUE(storage.resharding());
+
+    // Every key is found while entries move, modifications see the moved entries
+    EXPECT_TRUE(storage.Append("key0", "+"));
+    EXPECT_TRUE(storage.Delete("key2"));
+    EXPECT_EQ(storage.CompareAndSet("key1", "swapped", Afina::Storage::Meta(), version),
+              Afina::Storage::CasStatus::kStored);
+    std::string value;
+    for (int i = 3; i < 2000; i++) {
+        ASSERT_TRUE(storage.Get("key" + std::to_string(i), value)) << i;
+        EXPECT_EQ(value, "value" + std::to_string(i));
+    }
+    for (int i = 0; storage.resharding() && i < 1000; i++) {
+        storage.Get("key3", value);
+    }
+    EXPECT_FALSE(storage.resharding());
+    EXPECT_FALSE(storage.Reshard(8));
+
+    EXPECT_TRUE(storage.Get("key0", value));
+    EXPECT_EQ(value, "value0+");
+    EXPECT_TRUE(storage.Get("key1", value));
+    EXPECT_EQ(value, "swapped");
+    EXPECT_FALSE(storage.Get("key2", value));
+    std::vector<std::string> keys;
+    uint64_t cursor = 0;
+    do {
+        cursor = storage.Scan(cursor, 100, keys);
+    } while (cursor != 0);
+    EXPECT_EQ(keys.size(), 1999);
+
+    // Scan started before resharding misses nothing
+    keys.clear();
+    cursor = storage.Scan(0, 100, keys);
+    EXPECT_TRUE(storage.Reshard(2));
+    do {
+        cursor = storage.Scan(cursor, 100, keys);
+    } while (cursor != 0);
+    EXPECT_EQ(std::set<std::string>(keys.begin(), keys.end()).size(), 1999);
+}
+
+TEST(StorageTest, ConcurrentReshard) {
+    StripedLockLRU storage(16 << 20, 2);
+    std::atomic<bool> stop(false);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 4; t++) {
+        workers.emplace_back([&storage, &stop, t]() {
+            // Each thread owns its keys, so it always knows what they must hold
+            std::vector<int> last(200, -1);
+            std::string value;
+            for (int round = 0; !stop.load() || round < 20; round++) {
+                for (int i = 0; i < 200; i++) {
+                    std::string key = std::to_string(t) + "-" + std::to_string(i);
+                    if (last[i] >= 0) {
+                        ASSERT_TRUE(storage.Get(key, value)) << key;
+                        ASSERT_EQ(value, std::to_string(last[i])) << key;
+                    }
+                    if ((i + round) % 3 == 0) {
+                        storage.Put(key, std::to_string(round));
+                    } else {
+                        storage.Set(key, std::to_string(round));
+                    }
+                    last[i] = last[i] >= 0 || (i + round) % 3 == 0 ? round : -1;
+                }
+            }
+        });
+    }
+
+    for (size_t shards : {16, 4, 32, 1}) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        EXPECT_TRUE(storage.Reshard(shards));
+    }
+    stop = true;
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+    EXPECT_EQ(storage.shards(), 1);
+}
+
+TEST(StorageTest, CuckooFilter) {
+    CuckooFilter filter;
+    std::vector<std::size_t> hashes;
+    for (int i = 0; i < 100000; i++) {
+        hashes.push_back(HashKey("key" + std::to_string(i)));
+    }
+
+    // Filter grows as needed and never loses a hash
+    for (std::size_t i = 0; i < hashes.size(); i++) {
+        if (!filter.insert(hashes[i])) {
+            filter.rebuild(std::vector<std::size_t>(hashes.begin(), hashes.begin() + i + 1));
+        }
+    }
+    for (std::size_t hash : hashes) {
+        ASSERT_TRUE(filter.contains(hash));
+    }
+    EXPECT_LE(filter.bytes(), hashes.size() * 4);
+
+    // Hashes removed are gone, except for rare false positives
+    for (std::size_t i = 0; i < hashes.size(); i += 2) {
+        filter.erase(hashes[i]);
+    }
+    std::size_t false_positives = 0;
+    for (std::size_t i = 0; i < hashes.size(); i++) {
+        if (i % 2 == 1) {
+            ASSERT_TRUE(filter.contains(hashes[i]));
+        } else {
+            false_positives += filter.contains(hashes[i]);
+        }
+    }
+    EXPECT_LT(false_positives, 100);
+}
+
+TEST(StorageTest, FilteredMisses) {
+    StripedLockLRU storage(16 << 20, 2);
+    for (int i = 0; i < 10000; i++) {
+        storage.Put("key" + std::to_string(i), "value");
+    }
+    std::string value;
+    for (int i = 0; i < 10000; i++) {
+        ASSERT_TRUE(storage.Get("key" + std::to_string(i), value));
+        EXPECT_FALSE(storage.Get("none" + std::to_string(i), value));
+    }
+    std::vector<Afina::ValueRef> values;
+    EXPECT_EQ(storage.MultiGet({"key1", "none", "key2"}, values), 2);
+    EXPECT_FALSE(values[1]);
+
+    std::vector<std::pair<std::string, std::string>> stats;
+    storage.Stats(stats);
+    ASSERT_EQ(stats.size(), 4);
+    EXPECT_EQ(stats[0].first, "filter_negatives");
+    EXPECT_GE(std::stoull(stats[0].second), 9990);
+    EXPECT_LE(std::stoull(stats[1].second), 10);
+
+    std::string out;
+    Stats command;
+    command.Execute(storage, "", out);
+    EXPECT_EQ(out.find("STAT filter_negatives "), 0);
+    EXPECT_EQ(out.substr(out.size() - 5), "\r\nEND");
+}
+
+TEST(StorageTest, ConcurrentFilteredReads) {
+    // Small budget makes writers evict and the filter move fingerprints all the time
+    StripedLockLRU storage(1 << 20, 2);
+    for (int i = 0; i < 100; i++) {
+        storage.Put("stable" + std::to_string(i), "value");
+    }
+
+    std::atomic<bool> stop(false);
+    std::thread writer([&storage, &stop]() {
+        for (int i = 0; !stop.load(); i++) {
+            storage.Put("churn" + std::to_string(i), std::string(100, 'x'));
+            storage.Put("stable" + std::to_string(i % 100), "value");
+        }
+    });
+
+    // Keys stable ones are replaced with stay in the filter all the time
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 3; t++) {
+        readers.emplace_back([&storage]() {
+            std::string value;
+            for (int round = 0; round < 2000; round++) {
+                for (int i = 0; i < 100; i += 7) {
+                    ASSERT_TRUE(storage.Get("stable" + std::to_string(i), value));
+                }
+            }
+        });
+    }
+    for (std::thread &reader : readers) {
+        reader.join();
+    }
+    stop = true;
+    writer.join();
+}
+
+TEST(StorageTest, HashedKeys) {
+    // Hash depends on key bytes only, for every length branch of the hash
+    std::string buffer(200, 'x');
+    for (std::size_t size : {0, 1, 3, 4, 8, 16, 17, 48, 49, 100}) {
+        std::string key = buffer.substr(0, size);
+        EXPECT_EQ(HashedKey(key).hash, HashedKey(Afina::StringRef(buffer.data(), size)).hash);
+        if (size > 0) {
+            std::string other = key;
+            other[size - 1] = 'y';
+            EXPECT_NE(HashedKey(key).hash, HashedKey(other).hash);
+        }
+    }
+
+    // All overloads of the thread safe storage go through HashedKey ones
+    ThreadSafeSimplLRU storage;
+    EXPECT_TRUE(storage.Put(HashedKey(std::string("KEY1")), "val1", Afina::Storage::Meta()));
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_EQ(value, "val1");
+    EXPECT_TRUE(storage.Set("KEY1", "val2"));
+    EXPECT_TRUE(storage.Get(HashedKey(std::string("KEY1")), value));
+    EXPECT_EQ(value, "val2");
+    EXPECT_TRUE(storage.Delete(HashedKey(std::string("KEY1"))));
+    EXPECT_FALSE(storage.Get("KEY1", value));
+}
+
+TEST(StorageTest, AppendPrepend) {
+    SimpleLRU lru;
+    StripedLockLRU striped(4096, 4);
+    TinyLFU lfu;
+    EpochStripedLRU epoch(1024, 2);
+    for (Afina::Storage *storage : std::vector<Afina::Storage *>{&lru, &striped, &lfu, &epoch}) {
+        std::string value;
+        EXPECT_FALSE(storage->Append("KEY", "tail"));
+        EXPECT_FALSE(storage->Prepend("KEY", "head"));
+        EXPECT_FALSE(storage->Get("KEY", value));
+
+        EXPECT_TRUE(storage->Put("KEY", "body"));
+        for (int i = 0; i < 10; i++) {
+            EXPECT_TRUE(storage->Append("KEY", std::to_string(i)));
+        }
+        EXPECT_TRUE(storage->Prepend("KEY", "head:"));
+        EXPECT_TRUE(storage->Get("KEY", value));
+        EXPECT_EQ(value, "head:body0123456789");
+
+        // Value pinned before the update stays unchanged
+        Afina::ValueRef pinned;
+        EXPECT_TRUE(storage->Get("KEY", pinned));
+        EXPECT_TRUE(storage->Append("KEY", "!"));
+        EXPECT_EQ(pinned.str(), "head:body0123456789");
+        EXPECT_TRUE(storage->Get("KEY", value));
+        EXPECT_EQ(value, "head:body0123456789!");
+    }
+
+    // Commands
+    std::string value, out;
+    Append("KEY", 0, 0).Execute(lru, "!", out);
+    EXPECT_EQ(out, "STORED");
+    Prepend("NONE", 0, 0).Execute(lru, "!", out);
+    EXPECT_EQ(out, "NOT_STORED");
+    Prepend("KEY", 0, 0).Execute(lru, "<", out);
+    EXPECT_EQ(out, "STORED");
+    EXPECT_TRUE(lru.Get("KEY", value));
+    EXPECT_EQ(value, "<head:body0123456789!!");
+}
+
+TEST(StorageTest, ConcurrentAppend) {
+    StripedLockLRU storage(1 << 20, 4);
+    EXPECT_TRUE(storage.Put("KEY", ""));
+
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 4; t++) {
+        writers.emplace_back([&storage, t] {
+            for (int i = 0; i < 1000; i++) {
+                storage.Append("KEY", std::to_string(t));
+            }
+        });
+    }
+    for (auto &writer : writers) {
+        writer.join();
+    }
+
+    // No append is lost
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY", value));
+    EXPECT_EQ(value.size(), 4000);
+    for (char c : {'0', '1', '2', '3'}) {
+        EXPECT_EQ(std::count(value.begin(), value.end(), c), 1000);
+    }
+}
+
+TEST(StorageTest, Counters) {
+    SimpleLRU lru;
+    StripedLockLRU striped(4096, 4);
+    TinyLFU lfu;
+    EpochStripedLRU epoch(1024, 2);
+    for (Afina::Storage *storage : std::vector<Afina::Storage *>{&lru, &striped, &lfu, &epoch}) {
+        uint64_t value = 0;
+        EXPECT_EQ(storage->Increment("KEY", 1, value), Afina::Storage::CounterStatus::kNotFound);
+
+        EXPECT_TRUE(storage->Put("KEY", "text"));
+        EXPECT_EQ(storage->Increment("KEY", 1, value), Afina::Storage::CounterStatus::kNotNumber);
+        EXPECT_TRUE(storage->Put("KEY", "18446744073709551616"));
+        EXPECT_EQ(storage->Increment("KEY", 1, value), Afina::Storage::CounterStatus::kNotNumber);
+
+        EXPECT_TRUE(storage->Put("KEY", "98"));
+        EXPECT_EQ(storage->Increment("KEY", 1, value), Afina::Storage::CounterStatus::kUpdated);
+        EXPECT_EQ(value, 99);
+        EXPECT_EQ(storage->Increment("KEY", 1, value), Afina::Storage::CounterStatus::kUpdated);
+        EXPECT_EQ(value, 100);
+        EXPECT_EQ(storage->Decrement("KEY", 95, value), Afina::Storage::CounterStatus::kUpdated);
+        EXPECT_EQ(value, 5);
+        EXPECT_EQ(storage->Decrement("KEY", 10, value), Afina::Storage::CounterStatus::kUpdated);
+        EXPECT_EQ(value, 0);
+
+        std::string text;
+        EXPECT_TRUE(storage->Get("KEY", text));
+        EXPECT_EQ(text, "0");
+
+        // Increment wraps around
+        EXPECT_TRUE(storage->Put("KEY", "18446744073709551615"));
+        EXPECT_EQ(storage->Increment("KEY", 2, value), Afina::Storage::CounterStatus::kUpdated);
+        EXPECT_EQ(value, 1);
+    }
+
+    // Same number of digits is written right over the old ones
+    Afina::ValueRef pinned;
+    EXPECT_TRUE(lru.Put("KEY", "10"));
+    EXPECT_TRUE(lru.Get("KEY", pinned));
+    const char *data = pinned.data();
+    pinned.reset();
+    uint64_t value;
+    EXPECT_EQ(lru.Increment("KEY", 89, value), Afina::Storage::CounterStatus::kUpdated);
+    EXPECT_TRUE(lru.Get("KEY", pinned));
+    EXPECT_EQ(pinned.data(), data);
+    EXPECT_EQ(pinned.str(), "99");
+
+    // Pinned value is never changed
+    EXPECT_EQ(lru.Increment("KEY", 1, value), Afina::Storage::CounterStatus::kUpdated);
+    EXPECT_EQ(pinned.str(), "99");
+
+    // Commands
+    std::string out;
+    Incr("KEY", 5).Execute(lru, "", out);
+    EXPECT_EQ(out, "105");
+    Decr("KEY", 200).Execute(lru, "", out);
+    EXPECT_EQ(out, "0");
+    Incr("NONE", 1).Execute(lru, "", out);
+    EXPECT_EQ(out, "NOT_FOUND");
+}
+
+TEST(StorageTest, ConcurrentIncrement) {
+    StripedLockLRU storage(1 << 20, 4);
+    EXPECT_TRUE(storage.Put("KEY", "0"));
+
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 4; t++) {
+        writers.emplace_back([&storage] {
+            uint64_t value;
+            for (int i = 0; i < 1000; i++) {
+                storage.Increment("KEY", 1, value);
+            }
+        });
+    }
+    for (auto &writer : writers) {
+        writer.join();
+    }
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY", value));
+    EXPECT_EQ(value, "4000");
+}
+
+TEST(StorageTest, CompareAndSet) {
+    SimpleLRU lru;
+    StripedLockLRU striped(4096, 4);
+    TinyLFU lfu;
+    ARC arc;
+    EpochStripedLRU epoch(1024, 2);
+    for (Afina::Storage *storage : std::vector<Afina::Storage *>{&lru, &striped, &lfu, &arc, &epoch}) {
+        Afina::Storage::Meta meta;
+        EXPECT_EQ(storage->CompareAndSet("KEY", "val", meta, 0), Afina::Storage::CasStatus::kNotFound);
+
+        EXPECT_TRUE(storage->Put("KEY", "val1"));
+        std::vector<Afina::ValueRef> values;
+        std::vector<Afina::Storage::Meta> metas;
+        EXPECT_EQ(storage->MultiGet({"KEY", "NONE"}, values, metas), 1);
+        uint64_t version = metas[0].version;
+
+        // Somebody else changes value meanwhile
+        EXPECT_TRUE(storage->Set("KEY", "val2"));
+        EXPECT_EQ(storage->CompareAndSet("KEY", "val3", meta, version), Afina::Storage::CasStatus::kExists);
+
+        EXPECT_EQ(storage->MultiGet({"KEY"}, values, metas), 1);
+        EXPECT_NE(metas[0].version, version);
+        version = metas[0].version;
+        EXPECT_EQ(storage->CompareAndSet("KEY", "val3", meta, version), Afina::Storage::CasStatus::kStored);
+        EXPECT_EQ(storage->CompareAndSet("KEY", "val4", meta, version), Afina::Storage::CasStatus::kExists);
+
+        std::string value;
+        EXPECT_TRUE(storage->Get("KEY", value));
+        EXPECT_EQ(value, "val3");
+    }
+
+    // Every kind of update changes version, even if value stays the same
+    std::vector<uint64_t> versions;
+    std::vector<Afina::ValueRef> values;
+    std::vector<Afina::Storage::Meta> metas;
+    uint64_t counter;
+    for (Afina::Storage *storage : std::vector<Afina::Storage *>{&arc, &lfu, &lru}) {
+        versions.clear();
+        EXPECT_TRUE(storage->Put("NUM", "1"));
+        for (int i = 0; i < 5; i++) {
+            switch (i) {
+            case 1:
+                storage->Put("NUM", "1");
+                break;
+            case 2:
+                storage->Increment("NUM", 0, counter);
+                break;
+            case 3:
+                storage->Append("NUM", "");
+                break;
+            case 4:
+                storage->Set("NUM", std::string(100, '1'));
+                break;
+            }
+            EXPECT_EQ(storage->MultiGet({"NUM"}, values, metas), 1);
+            versions.push_back(metas[0].version);
+        }
+        EXPECT_EQ(std::set<uint64_t>(versions.begin(), versions.end()).size(), versions.size());
+    }
+
+    // Commands
+    std::string out;
+    Get({"NUM"}, true).Execute(lru, "", out);
+    EXPECT_EQ(out, "VALUE NUM 0 100 " + std::to_string(versions.back()) + "\r\n" + std::string(100, '1') + "\r\nEND");
+    Cas("NUM", 0, 0, versions.back()).Execute(lru, "2", out);
+    EXPECT_EQ(out, "STORED");
+    Cas("NUM", 0, 0, versions.back()).Execute(lru, "3", out);
+    EXPECT_EQ(out, "EXISTS");
+    Cas("NONE", 0, 0, 0).Execute(lru, "3", out);
+    EXPECT_EQ(out, "NOT_FOUND");
+}
+
+TEST(StorageTest, Flags) {
+    SimpleLRU lru;
+    StripedLockLRU striped(4096, 4);
+    EpochStripedLRU epoch(1024, 2);
+    ARC arc;
+    TinyLFU lfu;
+    for (Afina::Storage *storage : std::vector<Afina::Storage *>{&lru, &striped, &epoch, &arc, &lfu}) {
+        std::string out;
+        Set("KEY", 0xdeadbeef, 0).Execute(*storage, "1", out);
+        Get({"KEY"}).Execute(*storage, "", out);
+        EXPECT_EQ(out, "VALUE KEY 3735928559 1\r\n1\r\nEND");
+
+        // Value updates keep flags
+        Append("KEY", 1, 0).Execute(*storage, "0", out);
+        Prepend("KEY", 2, 0).Execute(*storage, "0", out);
+        Incr("KEY", 1).Execute(*storage, "", out);
+        std::vector<Afina::ValueRef> values;
+        std::vector<Afina::Storage::Meta> metas;
+        EXPECT_EQ(storage->MultiGet({"KEY"}, values, metas), 1);
+        EXPECT_EQ(std::string(values[0].data(), values[0].size()), "11");
+        EXPECT_EQ(metas[0].flags, 0xdeadbeef);
+
+        // Stores replace them
+        Cas("KEY", 7, 0, metas[0].version).Execute(*storage, "cas", out);
+        EXPECT_EQ(out, "STORED");
+        Get({"KEY"}, true).Execute(*storage, "", out);
+        EXPECT_EQ(out.substr(0, 14), "VALUE KEY 7 3 ");
+
+        EXPECT_TRUE(storage->Put("KEY", "plain"));
+        Get({"KEY"}).Execute(*storage, "", out);
+        EXPECT_EQ(out, "VALUE KEY 0 5\r\nplain\r\nEND");
+    }
+}
+
+TEST(StorageTest, Snapshot) {
+    const std::string path = "storage_test.snapshot";
+    SimpleLRU lru(16 * 1024);
+    StripedLockLRU striped(64 * 1024, 4);
+    EpochStripedLRU epoch(16 * 1024, 2);
+    TinyLFU lfu(16 * 1024);
+    ARC arc(16 * 1024);
+    for (Afina::Storage *storage : std::vector<Afina::Storage *>{&lru, &striped, &epoch, &lfu, &arc}) {
+        for (int i = 0; i < 50; i++) {
+            Afina::Storage::Meta meta;
+            meta.flags = i;
+            EXPECT_TRUE(storage->Put("key" + std::to_string(i), std::string(i, 'v'), meta));
+        }
+        EXPECT_EQ(SaveSnapshot(*storage, path), 50);
+
+        SimpleLRU restored(16 * 1024);
+        EXPECT_EQ(LoadSnapshot(restored, path), 50);
+        for (int i = 0; i < 50; i++) {
+            std::string value;
+            EXPECT_TRUE(restored.Get("key" + std::to_string(i), value));
+            EXPECT_EQ(value, std::string(i, 'v'));
+        }
+    }
+
+    // Attributes are kept, expiration time is absolute
+    Afina::Storage::Meta meta;
+    meta.expire = std::time(nullptr) + 1000;
+    meta.flags = 42;
+    EXPECT_TRUE(lru.Put("key0", "expires", meta));
+    std::string touched;
+    EXPECT_TRUE(lru.Get("key1", touched));
+    SaveSnapshot(lru, path);
+    SimpleLRU restored(16 * 1024);
+    LoadSnapshot(restored, path);
+    std::vector<Afina::ValueRef> values;
+    std::vector<Afina::Storage::Meta> metas;
+    EXPECT_EQ(restored.MultiGet({"key0", "key2"}, values, metas), 2);
+    EXPECT_EQ(metas[0].expire, meta.expire);
+    EXPECT_EQ(metas[0].flags, 42);
+    EXPECT_EQ(metas[1].flags, 2);
+
+    // Entries are saved from the least recently used, so storage smaller than the snapshot keeps the recent ones
+    SimpleLRU small(2 * SimpleLRU::EntrySize(4, 7));
+    LoadSnapshot(small, path);
+    std::string value;
+    EXPECT_TRUE(small.Get("key0", value));
+    EXPECT_TRUE(small.Get("key1", value));
+    EXPECT_FALSE(small.Get("key2", value));
+
+    // Broken snapshot is rejected, missing one is empty
+    std::string truncated = path + ".broken";
+    {
+        std::ifstream in(path, std::ios::binary);
+        std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        std::ofstream out(truncated, std::ios::binary);
+        out << data.substr(0, data.size() - 10);
+    }
+    EXPECT_THROW(LoadSnapshot(restored, truncated), std::runtime_error);
+    std::remove(truncated.c_str());
+    std::remove(path.c_str());
+    EXPECT_EQ(LoadSnapshot(restored, path), 0);
+}
+
+TEST(StorageTest, ConcurrentSnapshot) {
+    const std::string path = "storage_concurrent_test.snapshot";
+    StripedLockLRU storage(1 << 20, 8);
+    std::atomic<bool> stop(false);
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 4; t++) {
+        writers.emplace_back([&, t]() {
+            for (int i = 0; !stop.load(); i++) {
+                storage.Put("key" + std::to_string(t) + "_" + std::to_string(i % 1000), std::string(i % 100, 'v'));
+            }
+        });
+    }
+
+    std::size_t saved = 0;
+    for (int i = 0; i < 10; i++) {
+        saved = SaveSnapshot(storage, path);
+    }
+    stop.store(true);
+    for (std::thread &writer : writers) {
+        writer.join();
+    }
+
+    // Each part is consistent on its own, so every entry saved gets loaded
+    StripedLockLRU restored(1 << 20, 8);
+    EXPECT_EQ(LoadSnapshot(restored, path), saved);
+    std::remove(path.c_str());
+}
+
+TEST(StorageTest, OperationLog) {
+    const std::string path = "storage_test.oplog";
+    std::remove(path.c_str());
+    {
+        LoggedStorage storage(std::make_shared<ThreadSafeSimplLRU>(), path, std::chrono::milliseconds(1));
+        storage.Start();
+        Afina::Storage::Meta meta;
+        meta.flags = 7;
+        EXPECT_TRUE(storage.Put("KEY1", "val1", meta));
+        EXPECT_TRUE(storage.PutIfAbsent("KEY2", "val2"));
+        EXPECT_TRUE(storage.Set("KEY2", "val3"));
+        EXPECT_TRUE(storage.Append("KEY2", "+"));
+        EXPECT_TRUE(storage.Prepend("KEY2", "-"));
+        EXPECT_TRUE(storage.Put("NUM", "10"));
+        uint64_t counter;
+        EXPECT_EQ(storage.Increment("NUM", 5, counter), Afina::Storage::CounterStatus::kUpdated);
+        EXPECT_EQ(storage.Decrement("NUM", 2, counter), Afina::Storage::CounterStatus::kUpdated);
+        EXPECT_TRUE(storage.Put("GONE", "val"));
+        EXPECT_TRUE(storage.Delete("GONE"));
+
+        // Failed modifications are not logged
+        EXPECT_FALSE(storage.Set("NONE", "val"));
+        EXPECT_FALSE(storage.Delete("NONE"));
+        storage.Stop();
+    }
+
+    std::size_t logged;
+    {
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        logged = in.tellg();
+    }
+
+    LoggedStorage restored(std::make_shared<ThreadSafeSimplLRU>(), path, std::chrono::milliseconds(0));
+    restored.Start();
+    std::string value;
+    EXPECT_TRUE(restored.Get("KEY1", value));
+    EXPECT_EQ(value, "val1");
+    EXPECT_TRUE(restored.Get("KEY2", value));
+    EXPECT_EQ(value, "-val3+");
+    EXPECT_TRUE(restored.Get("NUM", value));
+    EXPECT_EQ(value, "13");
+    EXPECT_FALSE(restored.Get("GONE", value));
+
+    std::vector<Afina::ValueRef> values;
+    std::vector<Afina::Storage::Meta> metas;
+    EXPECT_EQ(restored.MultiGet({"KEY1"}, values, metas), 1);
+    EXPECT_EQ(metas[0].flags, 7);
+
+    // Log is compacted to a record per entry on start
+    EXPECT_LT(restored.log().size(), logged);
+    EXPECT_TRUE(restored.Put("KEY3", "val4"));
+    restored.Stop();
+
+    // Torn record at the end is ignored
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::app);
+        out << "garbage";
+    }
+    ThreadSafeSimplLRU backend;
+    OperationLog log(path, std::chrono::milliseconds(0));
+    EXPECT_EQ(log.Recover(backend), 4);
+    EXPECT_TRUE(backend.Get("KEY3", value));
+    EXPECT_EQ(value, "val4");
+    std::remove(path.c_str());
+}
+
+TEST(StorageTest, OperationLogEvictions) {
+    const std::string path = "storage_evictions_test.oplog";
+    std::remove(path.c_str());
+    std::size_t max_size = 2 * SimpleLRU::EntrySize(4, 4);
+    {
+        LoggedStorage storage(std::make_shared<ThreadSafeSimplLRU>(max_size), path, std::chrono::milliseconds(1));
+        storage.Start();
+        EXPECT_TRUE(storage.Put("KEY1", "val1"));
+        EXPECT_TRUE(storage.PutIfAbsent("KEY2", "val2"));
+
+        // Gets aren't logged, so replay evicts KEY1 instead unless eviction of KEY2 is logged
+        std::string value;
+        EXPECT_TRUE(storage.Get("KEY1", value));
+        EXPECT_TRUE(storage.Put("KEY3", "val3"));
+        EXPECT_FALSE(storage.Get("KEY2", value));
+        storage.Stop();
+    }
+
+    LoggedStorage restored(std::make_shared<ThreadSafeSimplLRU>(max_size), path, std::chrono::milliseconds(0));
+    restored.Start();
+    std::string value;
+    EXPECT_TRUE(restored.Get("KEY1", value));
+    EXPECT_FALSE(restored.Get("KEY2", value));
+    EXPECT_TRUE(restored.Get("KEY3", value));
+    restored.Stop();
+    std::remove(path.c_str());
+}
+
+TEST(StorageTest, ConcurrentOperationLog) {
+    const std::string path = "storage_concurrent_test.oplog";
+    std::remove(path.c_str());
+    std::string expected;
+    {
+        LoggedStorage storage(std::make_shared<StripedLockLRU>(1 << 20, 4), path, std::chrono::milliseconds(1));
+        storage.Start();
+        std::vector<std::thread> workers;
+        for (int t = 0; t < 4; t++) {
+            workers.emplace_back([&storage, t]() {
+                uint64_t counter;
+                for (int i = 0; i < 1000; i++) {
+                    // Same keys are updated by every thread, so log must keep the order storage has applied
+                    storage.Put("key" + std::to_string(i % 10), std::to_string(t * 1000 + i));
+                    if (storage.Increment("counter", 1, counter) == Afina::Storage::CounterStatus::kNotFound) {
+                        storage.PutIfAbsent("counter", "1");
+                    }
+                }
+            });
+        }
+        for (std::thread &worker : workers) {
+            worker.join();
+        }
+        for (int i = 0; i < 10; i++) {
+            std::string value;
+            EXPECT_TRUE(storage.Get("key" + std::to_string(i), value));
+            expected += value + " ";
+        }
+        std::string value;
+        EXPECT_TRUE(storage.Get("counter", value));
+        expected += value;
+        storage.Stop();
+    }
+
+    LoggedStorage restored(std::make_shared<StripedLockLRU>(1 << 20, 4), path, std::chrono::milliseconds(1));
+    restored.Start();
+    std::string actual;
+    for (int i = 0; i < 10; i++) {
+        std::string value;
+        EXPECT_TRUE(restored.Get("key" + std::to_string(i), value));
+        actual += value + " ";
+    }
+    std::string value;
+    EXPECT_TRUE(restored.Get("counter", value));
+    actual += value;
+    EXPECT_EQ(actual, expected);
+    restored.Stop();
+    std::remove(path.c_str());
+}
+
+TEST(StorageTest, SharedMemoryWarmRestart) {
+    const std::string path = "storage_test.shm";
+    std::remove(path.c_str());
+    uint64_t version;
+    {
+        SharedMemoryLRU storage(path, 1 << 20);
+        EXPECT_FALSE(storage.attached());
+        Afina::Storage::Meta meta;
+        meta.flags = 7;
+        EXPECT_TRUE(storage.Put("KEY1", "val1", meta));
+        EXPECT_TRUE(storage.PutIfAbsent("KEY2", "val2"));
+        EXPECT_FALSE(storage.PutIfAbsent("KEY2", "val3"));
+        EXPECT_TRUE(storage.Append("KEY2", std::string(1000, '+')));
+        EXPECT_TRUE(storage.Put("NUM", "10"));
+        uint64_t counter;
+        EXPECT_EQ(storage.Increment("NUM", 5, counter), Afina::Storage::CounterStatus::kUpdated);
+        EXPECT_EQ(counter, 15);
+        EXPECT_TRUE(storage.Put("GONE", "val"));
+        EXPECT_TRUE(storage.Delete("GONE"));
+        EXPECT_EQ(storage.size(), 3);
+
+        // Second process can't attach the same storage
+        EXPECT_THROW(SharedMemoryLRU(path, 1 << 20), std::runtime_error);
+
+        std::vector<Afina::ValueRef> values;
+        std::vector<Afina::Storage::Meta> metas;
+        EXPECT_EQ(storage.MultiGet({"KEY1"}, values, metas), 1);
+        version = metas[0].version;
+    }
+
+    SharedMemoryLRU restored(path, 1 << 20);
+    EXPECT_TRUE(restored.attached());
+    EXPECT_EQ(restored.size(), 3);
+    std::string value;
+    EXPECT_TRUE(restored.Get("KEY2", value));
+    EXPECT_EQ(value, "val2" + std::string(1000, '+'));
+    EXPECT_TRUE(restored.Get("NUM", value));
+    EXPECT_EQ(value, "15");
+    EXPECT_FALSE(restored.Get("GONE", value));
+
+    std::vector<Afina::ValueRef> values;
+    std::vector<Afina::Storage::Meta> metas;
+    EXPECT_EQ(restored.MultiGet({"KEY1"}, values, metas), 1);
+    EXPECT_EQ(values[0].str(), "val1");
+    EXPECT_EQ(metas[0].flags, 7);
+    EXPECT_EQ(metas[0].version, version);
+    EXPECT_EQ(restored.CompareAndSet("KEY1", "val4", Afina::Storage::Meta(), version),
+              Afina::Storage::CasStatus::kStored);
+    EXPECT_EQ(restored.CompareAndSet("KEY1", "val5", Afina::Storage::Meta(), version),
+              Afina::Storage::CasStatus::kExists);
+
+    std::size_t exported = 0;
+    EXPECT_TRUE(restored.Export([&exported](Afina::Storage::Item &item) { exported++; }));
+    EXPECT_EQ(exported, 3);
+    std::remove(path.c_str());
+}
+
+TEST(StorageTest, SharedMemoryEviction) {
+    const std::string path = "storage_eviction_test.shm";
+    std::remove(path.c_str());
+    SharedMemoryLRU storage(path, 64 << 10);
+
+    // Arena is filled many times over, oldest entries get evicted
+    std::string value(200, 'x');
+    for (int i = 0; i < 1000; i++) {
+        EXPECT_TRUE(storage.Put("key" + std::to_string(i), value));
+    }
+    std::string result;
+    EXPECT_TRUE(storage.Get("key999", result));
+    EXPECT_FALSE(storage.Get("key0", result));
+    EXPECT_LT(storage.size(), 1000);
+    EXPECT_GT(storage.size(), 0);
+
+    // Entry of a larger class evicts only until freed blocks merge into one it fits
+    std::size_t before = storage.size();
+    EXPECT_TRUE(storage.Put("medium", std::string(2 << 10, 'm')));
+    EXPECT_TRUE(storage.Get("medium", result));
+    EXPECT_GT(storage.size(), before / 2);
+
+    // Entry of the other size class takes the whole arena once everything is evicted
+    std::string big(16 << 10, 'y');
+    EXPECT_TRUE(storage.Put("big", big));
+    EXPECT_TRUE(storage.Get("big", result));
+    EXPECT_EQ(result, big);
+    EXPECT_FALSE(storage.Put("huge", std::string(64 << 10, 'z')));
+    std::remove(path.c_str());
+}
+
+TEST(StorageTest, ColdTier) {
+    ColdTier cold("storage_test.cold", 1 << 20);
+    SimpleLRU storage(SimpleLRU::EntrySize(4, 4) * 4, SimpleLRU::Eviction::kLRU, nullptr, &cold);
+    Afina::Storage::Meta meta;
+    meta.flags = 7;
+    EXPECT_TRUE(storage.Put("KEY0", "val0", meta));
+    for (int i = 1; i < 10; i++) {
+        EXPECT_TRUE(storage.Put("KEY" + std::to_string(i), "val" + std::to_string(i)));
+    }
+    EXPECT_EQ(cold.size(), 6);
+
+    // Cold value misses, but gets promoted once read back
+    std::string value;
+    EXPECT_FALSE(storage.Get("KEY0", value));
+    for (int i = 0; i < 1000 && !storage.Get("KEY0", value); i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(value, "val0");
+    std::vector<Afina::ValueRef> values;
+    std::vector<Afina::Storage::Meta> metas;
+    EXPECT_EQ(storage.MultiGet({"KEY0"}, values, metas), 1);
+    EXPECT_EQ(metas[0].flags, 7);
+
+    // Newer value wins over the one being read
+    EXPECT_FALSE(storage.Get("KEY2", value));
+    EXPECT_TRUE(storage.Put("KEY2", "new2"));
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_TRUE(storage.Get("KEY2", value));
+    EXPECT_EQ(value, "new2");
+
+    // Deleted cold value is never promoted
+    EXPECT_TRUE(storage.Delete("KEY3"));
+    EXPECT_FALSE(storage.Delete("KEY3"));
+    EXPECT_FALSE(storage.Get("KEY3", value));
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_FALSE(storage.Get("KEY3", value));
+
+    // Cold values are there for modifications as well
+    EXPECT_FALSE(storage.PutIfAbsent("KEY1", "new1"));
+    EXPECT_TRUE(storage.Set("KEY4", "new4"));
+    EXPECT_TRUE(storage.Get("KEY4", value));
+    EXPECT_EQ(value, "new4");
+    bool appended = false;
+    for (int i = 0; i < 1000 && !(appended = storage.Append("KEY5", "+")); i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_TRUE(appended);
+    EXPECT_TRUE(storage.Get("KEY5", value));
+    EXPECT_EQ(value, "val5+");
+}
+
+TEST(StorageTest, ColdTierExpiredPut) {
+    ColdTier cold("storage_test.cold", 1 << 20);
+    SimpleLRU storage(SimpleLRU::EntrySize(4, 4) * 4, SimpleLRU::Eviction::kLRU, nullptr, &cold);
+    for (int i = 0; i < 10; i++) {
+        EXPECT_TRUE(storage.Put("KEY" + std::to_string(i), "val" + std::to_string(i)));
+    }
+
+    // Association that expires right away invalidates the cold copy, so it is never promoted back
+    Afina::Storage::Meta past;
+    past.expire = 1;
+    EXPECT_TRUE(storage.Put("KEY0", "new0", past));
+    std::string value;
+    EXPECT_FALSE(storage.Get("KEY0", value));
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_FALSE(storage.Get("KEY0", value));
+    EXPECT_FALSE(storage.Get("KEY0", value));
+}
+
+TEST(StorageTest, LzRoundTrip) {
+    std::vector<std::string> inputs = {"", "a", "abcd", std::string(1000, 'x'), "abcabcabcabcabcabcabcabc"};
+    std::string json;
+    for (int i = 0; i < 200; i++) {
+        json += "{\"id\": " + std::to_string(i) + ", \"name\": \"user" + std::to_string(i) + "\", \"active\": true},";
+    }
+    inputs.push_back(json);
+    std::string noise;
+    uint32_t state = 12345;
+    for (int i = 0; i < 5000; i++) {
+        state = state * 1103515245 + 12345;
+        noise.push_back(static_cast<char>(state >> 16));
+    }
+    inputs.push_back(noise);
+
+    for (const std::string &input : inputs) {
+        std::string packed(input.size() + input.size() / 255 + 16, '\0');
+        std::size_t size = LzCompress(input.data(), input.size(), &packed[0], packed.size());
+        ASSERT_GT(size, 0);
+        std::string output(input.size(), '\0');
+        EXPECT_TRUE(LzDecompress(packed.data(), size, &output[0], output.size()));
+        EXPECT_EQ(output, input);
+
+        // Block of the other raw size is rejected
+        output.push_back('\0');
+        EXPECT_FALSE(LzDecompress(packed.data(), size, &output[0], output.size()));
+    }
+    // Text shrinks a lot, noise doesn't
+    std::string packed(json.size(), '\0');
+    EXPECT_GT(LzCompress(json.data(), json.size(), &packed[0], json.size() / 4), 0);
+    EXPECT_EQ(LzCompress(noise.data(), noise.size(), &packed[0], noise.size() / 2), 0);
+}
+
+TEST(StorageTest, CompressedValues) {
+    std::string json;
+    for (int i = 0; i < 100; i++) {
+        json += "{\"id\": " + std::to_string(i) + ", \"name\": \"user\", \"active\": true},";
+    }
+
+    // Storage holds two raw values only, compressed ones fit many more
+    SimpleLRU storage(SimpleLRU::EntrySize(4, json.size()) * 2, SimpleLRU::Eviction::kLRU, nullptr, nullptr, 256);
+    for (int i = 0; i < 8; i++) {
+        EXPECT_TRUE(storage.Put("KEY" + std::to_string(i), json + std::to_string(i)));
+    }
+    std::string value;
+    for (int i = 0; i < 8; i++) {
+        EXPECT_TRUE(storage.Get("KEY" + std::to_string(i), value));
+        EXPECT_EQ(value, json + std::to_string(i));
+    }
+
+    Afina::ValueRef ref;
+    EXPECT_TRUE(storage.Get("KEY0", ref));
+    EXPECT_EQ(ref.str(), json + "0");
+    EXPECT_TRUE(storage.Set("KEY0", json + "new"));
+    EXPECT_EQ(ref.str(), json + "0");
+
+    EXPECT_TRUE(storage.Append("KEY1", "+"));
+    EXPECT_TRUE(storage.Prepend("KEY1", "-"));
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_EQ(value, "-" + json + "1+");
+
+    // Counter compressed is still a counter
+    SimpleLRU counters(1024, SimpleLRU::Eviction::kLRU, nullptr, nullptr, 8);
+    EXPECT_TRUE(counters.Put("NUM", "00000000000000000042"));
+    uint64_t counter;
+    EXPECT_EQ(counters.Increment("NUM", 5, counter), Afina::Storage::CounterStatus::kUpdated);
+    EXPECT_EQ(counter, 47);
+    EXPECT_TRUE(counters.Get("NUM", value));
+    EXPECT_EQ(value, "47");
+
+    std::size_t exported = 0;
+    storage.Export([&](Afina::Storage::Item &item) {
+        if (item.key == "KEY1") {
+            EXPECT_EQ(item.value.str(), "-" + json + "1+");
+        }
+        exported++;
+    });
+    EXPECT_GT(exported, 2);
+}
+
+TEST(StorageTest, NodePool) {
+    // Freed block is reused by the next allocation of its class
+    void *block = NodePool::Allocate(100);
+    NodePool::Free(block, 100);
+    EXPECT_EQ(NodePool::Allocate(112), block);
+    NodePool::Free(block, 112);
+    EXPECT_EQ(NodePool::BlockSize(100), 112);
+    EXPECT_EQ(NodePool::BlockSize(1000), 1000);
+
+    // Blocks allocated by one thread and freed by others, as pinned nodes are
+    std::vector<std::vector<char *>> blocks(4);
+    for (auto &part : blocks) {
+        for (int i = 0; i < 10000; i++) {
+            part.push_back(static_cast<char *>(NodePool::Allocate(96 + i % 128)));
+            std::memset(part.back(), i & 0xff, 96 + i % 128);
+        }
+    }
+    std::vector<std::thread> workers;
+    for (auto &part : blocks) {
+        workers.emplace_back([&part]() {
+            for (std::size_t i = 0; i < part.size(); i++) {
+                EXPECT_EQ(part[i][95], static_cast<char>(i & 0xff));
+                NodePool::Free(part[i], 96 + i % 128);
+                void *other = NodePool::Allocate(64);
+                NodePool::Free(other, 64);
+            }
+        });
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+TEST(StorageTest, ScanGrowingIndex) {
+    SimpleLRU storage(16 << 20);
+    std::set<std::string> expected;
+    for (int i = 0; i < 1000; i++) {
+        expected.insert("key" + std::to_string(i));
+        storage.Put("key" + std::to_string(i), "value");
+    }
+
+    // Keys present during the whole iteration are returned exactly once while index grows between batches
+    std::multiset<std::string> seen;
+    uint64_t cursor = 0;
+    int extra = 0;
+    do {
+        std::vector<std::string> keys;
+        cursor = storage.Scan(cursor, 10, keys);
+        seen.insert(keys.begin(), keys.end());
+        for (int i = 0; i < 50; i++, extra++) {
+            storage.Put("extra" + std::to_string(extra), "value");
+        }
+    } while (cursor != 0);
+
+    for (const std::string &key : expected) {
+        EXPECT_EQ(seen.count(key), 1) << key;
+    }
+}
+
+TEST(StorageTest, ScanStriped) {
+    StripedLockLRU storage(16 << 20, 4);
+    for (int i = 0; i < 1000; i++) {
+        storage.Put("key" + std::to_string(i), "value");
+    }
+
+    std::vector<std::string> keys;
+    uint64_t cursor = 0;
+    do {
+        cursor = storage.Scan(cursor, 7, keys);
+    } while (cursor != 0);
+    std::set<std::string> unique(keys.begin(), keys.end());
+    EXPECT_EQ(keys.size(), 1000);
+    EXPECT_EQ(unique.size(), 1000);
+
+    // Command prints the batch followed by the next cursor
+    std::string out;
+    Scan scan(0, 2000);
+    scan.Execute(storage, "", out);
+    EXPECT_EQ(out.substr(out.size() - 15), "\r\nCURSOR 0\r\nEND");
+    EXPECT_EQ(std::count(out.begin(), out.end(), '\n'), 1001);
+}
+
+TEST(StorageTest, ScanEpochStriped) {
+    EpochStripedLRU storage(16 << 20, 4);
+    std::set<std::string> expected;
+    for (int i = 0; i < 1000; i++) {
+        expected.insert("key" + std::to_string(i));
+        storage.Put("key" + std::to_string(i), "value");
+    }
+
+    // Batches are bounded, buckets are returned whole only, and tables grow between them
+    std::multiset<std::string> seen;
+    uint64_t cursor = 0;
+    int extra = 0;
+    do {
+        std::vector<std::string> keys;
+        cursor = storage.Scan(cursor, 10, keys);
+        EXPECT_LT(keys.size(), 20);
+        seen.insert(keys.begin(), keys.end());
+        for (int i = 0; i < 5; i++, extra++) {
+            storage.Put("extra" + std::to_string(extra), "value");
+        }
+    } while (cursor != 0);
+
+    for (const std::string &key : expected) {
+        EXPECT_EQ(seen.count(key), 1) << key;
+    }
+}
+
+template <typename T> void ScanGrowing(T &storage) {
+    std::set<std::string> expected;
+    for (int i = 0; i < 500; i++) {
+        expected.insert("key" + std::to_string(i));
+        storage.Put("key" + std::to_string(i), "value");
+    }
+
+    // Keys present during the whole iteration are returned exactly once while index grows between batches
+    std::multiset<std::string> seen;
+    uint64_t cursor = 0;
+    int extra = 0;
+    do {
+        std::vector<std::string> keys;
+        cursor = storage.Scan(cursor, 4, keys);
+        seen.insert(keys.begin(), keys.end());
+        for (int i = 0; i < 5; i++, extra++) {
+            storage.Put("extra" + std::to_string(extra), "value");
+        }
+    } while (cursor != 0);
+
+    for (const std::string &key : expected) {
+        EXPECT_EQ(seen.count(key), 1) << key;
+    }
+}
+
+TEST(StorageTest, ScanIndexed) {
+    ARC arc(16 << 20);
+    ScanGrowing(arc);
+    TinyLFU lfu(16 << 20);
+    ScanGrowing(lfu);
+}
+
+TEST(StorageTest, ScanDefault) {
+    // Storage without index of its own has only Export to take keys from
+    struct : public Afina::Storage {
+        bool Put(const std::string &key, const std::string &value) override { return true; }
+        bool PutIfAbsent(const std::string &key, const std::string &value) override { return true; }
+        bool Set(const std::string &key, const std::string &value) override { return true; }
+        bool Delete(const std::string &key) override { return true; }
+        bool Get(const std::string &key, std::string &value) override { return false; }
+        bool Export(const std::function<void(Item &item)> &visit) override {
+            for (int i = 0; i < 100; i++) {
+                Item item("key" + std::to_string(i), Afina::ValueRef::Copy("value"), Meta());
+                visit(item);
+            }
+            return true;
+        }
+    } storage;
+
+    std::vector<std::string> keys;
+    uint64_t cursor = 0;
+    int batches = 0;
+    do {
+        std::size_t before = keys.size();
+        cursor = storage.Scan(cursor, 30, keys);
+        EXPECT_LE(keys.size() - before, 30);
+        batches++;
+    } while (cursor != 0);
+    std::set<std::string> unique(keys.begin(), keys.end());
+    EXPECT_EQ(batches, 4);
+    EXPECT_EQ(unique.size(), 100);
+}
+
+TEST(StorageTest, ClockSecondChance) {
+    SimpleLRU storage(3 * SimpleLRU::EntrySize(4, 4), SimpleLRU::Eviction::kClock);
+
+    EXPECT_TRUE(storage.Put("KEY1", "val1"));
+    EXPECT_TRUE(storage.Put("KEY2", "val2"));
+    EXPECT_TRUE(storage.Put("KEY3", "val3"));
+
+    // KEY1 is the oldest one, but it has been referenced so KEY2 goes first
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_TRUE(storage.Put("KEY4", "val4"));
+
+    EXPECT_FALSE(storage.Get("KEY2", value));
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_TRUE(value == "val1");
+    EXPECT_TRUE(storage.Get("KEY3", value));
+    EXPECT_TRUE(storage.Get("KEY4", value));
+}
+
+TEST(StorageTest, ConcurrentClockReads) {
+    const size_t length = 20;
+    StripedLockLRU storage(2 * 10000 * SimpleLRU::EntrySize(length, length), 4, SimpleLRU::Eviction::kClock);
+    for (long i = 0; i < 10000; ++i) {
+        EXPECT_TRUE(storage.Put(pad_space("Key " + std::to_string(i), length),
+                                pad_space("Val " + std::to_string(i), length)));
+    }
+
+    std::vector<std::thread> readers;
+    std::atomic<long> errors(0);
+    for (int t = 0; t < 4; ++t) {
+        readers.emplace_back([&storage, &errors, length, t] {
+            std::string res;
+            for (long i = t; i < 10000; i += 2) {
+                auto key = pad_space("Key " + std::to_string(i), length);
+                if (!storage.Get(key, res) || res != pad_space("Val " + std::to_string(i), length)) {
+                    errors++;
+                }
+            }
+        });
+    }
+    for (auto &reader : readers) {
+        reader.join();
+    }
+    EXPECT_EQ(0, errors.load());
+}
+
+TEST(EpochStripedLRUTest, PutGetDelete) {
+    EpochStripedLRU storage(100 * EpochStripedLRU::EntrySize(7, 8), 2);
+
+    // Enough entries to grow tables several times and to evict
+    for (int i = 0; i < 1000; i++) {
+        std::string key = "KEY" + std::to_string(1000 + i);
+        EXPECT_TRUE(storage.Put(key, "v" + key));
+    }
+
+    std::string value;
+    EXPECT_FALSE(storage.Get("KEY1000", value));
+    EXPECT_TRUE(storage.Get("KEY1999", value));
+    EXPECT_EQ(value, "vKEY1999");
+
+    EXPECT_FALSE(storage.PutIfAbsent("KEY1999", "other"));
+    EXPECT_TRUE(storage.Set("KEY1999", "other"));
+    EXPECT_TRUE(storage.Get("KEY1999", value));
+    EXPECT_EQ(value, "other");
+
+    EXPECT_TRUE(storage.Delete("KEY1999"));
+    EXPECT_FALSE(storage.Get("KEY1999", value));
+    EXPECT_FALSE(storage.Set("KEY1999", "other"));
+    EXPECT_FALSE(storage.Delete("KEY1999"));
+}
+
+TEST(EpochStripedLRUTest, PinnedValue) {
+    Afina::ValueRef pinned;
+    {
+        EpochStripedLRU storage(1024, 1);
+        EXPECT_TRUE(storage.Put("KEY1", "val1"));
+        EXPECT_TRUE(storage.Get("KEY1", pinned));
+        EXPECT_TRUE(storage.Put("KEY1", "new1"));
+        EXPECT_TRUE(storage.Delete("KEY1"));
+        EXPECT_EQ(pinned.str(), "val1");
+    }
+
+    // Value outlives the storage
+    EXPECT_EQ(pinned.str(), "val1");
+}
+
+TEST(EpochStripedLRUTest, ConcurrentReadWrite) {
+    EpochStripedLRU storage(200 * EpochStripedLRU::EntrySize(6, 6), 4);
+    for (int i = 0; i < 100; i++) {
+        storage.Put("KEY" + std::to_string(100 + i), "val" + std::to_string(100 + i));
+    }
+
+    // Readers must never see partial or foreign values while writers update, delete and evict
+    std::atomic<bool> stop(false);
+    std::atomic<int> errors(0);
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; t++) {
+        readers.emplace_back([&storage, &stop, &errors]() {
+            std::string value;
+            while (!stop.load()) {
+                for (int i = 0; i < 1000; i++) {
+                    std::string suffix = std::to_string(100 + i);
+                    if (storage.Get("KEY" + suffix, value) && value != "val" + suffix && value != "new" + suffix) {
+                        errors++;
+                    }
+                }
+            }
+        });
+    }
+
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 2; t++) {
+        writers.emplace_back([&storage, t]() {
+            for (int round = 0; round < 20; round++) {
+                for (int i = t; i < 900; i += 2) {
+                    std::string suffix = std::to_string(100 + i);
+                    storage.Put("KEY" + suffix, (round % 2 ? "val" : "new") + suffix);
+                    if (i % 7 == 0) {
+                        storage.Delete("KEY" + suffix);
+                    }
+                }
+            }
+        });
+    }
+    for (auto &writer : writers) {
+        writer.join();
+    }
+    stop.store(true);
+    for (auto &reader : readers) {
+        reader.join();
+    }
+    EXPECT_EQ(errors.load(), 0);
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY999", value));
+    EXPECT_EQ(value, "val999");
+}
+
+// SimpleLRU with manually controlled time
+class ManualClockLRU : public SimpleLRU {
+public:
+    ManualClockLRU(size_t max_size, int64_t now) : SimpleLRU(max_size), moment(now) {}
+
+    int64_t moment;
+
+protected:
+    int64_t now() const override { return moment; }
+};
+
+TEST(StorageTest, ExpireEntries) {
+    int64_t start = std::time(nullptr);
+    ManualClockLRU storage(1024, start);
+
+    Afina::Storage::Meta soon, later;
+    soon.expire = start + 10;
+    later.expire = start + 5000;
+
+    EXPECT_TRUE(storage.Put("KEY1", "val1", soon));
+    EXPECT_TRUE(storage.Put("KEY2", "val2", later));
+    EXPECT_TRUE(storage.Put("KEY3", "val3"));
+
+    std::string value;
+    storage.moment = start + 9;
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_EQ(value, "val1");
+
+    storage.moment = start + 10;
+    EXPECT_FALSE(storage.Get("KEY1", value));
+    EXPECT_TRUE(storage.PutIfAbsent("KEY1", "new1"));
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_EQ(value, "new1");
+
+    // Plain Set drops expiration time
+    EXPECT_TRUE(storage.Set("KEY2", "new2"));
+    storage.moment = start + 100000;
+    EXPECT_TRUE(storage.Get("KEY2", value));
+    EXPECT_EQ(value, "new2");
+    EXPECT_TRUE(storage.Get("KEY3", value));
+
+    // Already expired association is never stored
+    Afina::Storage::Meta past;
+    past.expire = 1;
+    EXPECT_TRUE(storage.Put("KEY3", "new3", past));
+    EXPECT_FALSE(storage.Get("KEY3", value));
+    EXPECT_FALSE(storage.Set("KEY3", "new3"));
+
+    // Append keeps expiration time while growing the value
+    Afina::Storage::Meta next;
+    next.expire = storage.moment + 10;
+    EXPECT_TRUE(storage.Put("KEY4", "val4", next));
+    EXPECT_TRUE(storage.Append("KEY4", std::string(100, 'x')));
+    EXPECT_TRUE(storage.Get("KEY4", value));
+    EXPECT_EQ(value.size(), 104);
+    storage.moment = next.expire;
+    EXPECT_FALSE(storage.Get("KEY4", value));
+}
+
+TEST(StorageTest, ExpiredReleaseSpace) {
+    int64_t start = std::time(nullptr);
+    ManualClockLRU storage(10 * SimpleLRU::EntrySize(5, 5), start);
+
+    Afina::Storage::Meta meta;
+    meta.expire = start + 3600;
+    for (int i = 0; i < 5; i++) {
+        EXPECT_TRUE(storage.Put("KEY" + std::to_string(i), "val" + std::to_string(i), meta));
+    }
+    for (int i = 5; i < 10; i++) {
+        EXPECT_TRUE(storage.Put("KEY" + std::to_string(i), "val" + std::to_string(i)));
+    }
+
+    // Space of expired entries is reused, entries without expiration survive
+    storage.moment = start + 3600;
+    for (int i = 10; i < 15; i++) {
+        EXPECT_TRUE(storage.Put("KEY" + std::to_string(i), "val" + std::to_string(i)));
+    }
+
+    std::string value;
+    for (int i = 0; i < 15; i++) {
+        EXPECT_EQ(storage.Get("KEY" + std::to_string(i), value), i >= 5) << i;
+    }
+}
+
+// Storage with manually controlled time
+template <typename T> class ManualClock : public T {
+public:
+    ManualClock(size_t max_size, int64_t now) : T(max_size), moment(now) {}
+    ManualClock(size_t max_size, size_t num_shards, int64_t now) : T(max_size, num_shards), moment(now) {}
+
+    int64_t moment;
+
+protected:
+    int64_t now() const override { return moment; }
+};
+
+template <typename T> void ExpireEntriesOf(T &storage) {
+    int64_t start = storage.moment;
+    Afina::Storage::Meta soon;
+    soon.expire = start + 10;
+
+    EXPECT_TRUE(storage.Put("KEY1", "val1", soon));
+    EXPECT_TRUE(storage.Put("KEY2", "val2", soon));
+    EXPECT_TRUE(storage.Put("KEY3", "val3"));
+    EXPECT_TRUE(storage.Append("KEY2", "!"));
+
+    std::string value;
+    storage.moment = start + 9;
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_TRUE(storage.Get("KEY2", value));
+    EXPECT_EQ(value, "val2!");
+
+    storage.moment = start + 10;
+    EXPECT_FALSE(storage.Get("KEY1", value));
+    EXPECT_FALSE(storage.Set("KEY2", "new2"));
+    EXPECT_TRUE(storage.Get("KEY3", value));
+    EXPECT_TRUE(storage.PutIfAbsent("KEY1", "new1"));
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_EQ(value, "new1");
+
+    int exported = 0;
+    storage.Export([&exported](Afina::Storage::Item &item) { exported++; });
+    EXPECT_EQ(exported, 2);
+}
+
+template <typename T> void ExpiredDroppedOf(T &storage) {
+    int64_t start = storage.moment;
+    std::vector<std::string> evictions;
+    storage.SetEvictionListener([&evictions](Afina::StringRef key) { evictions.push_back(key.str()); });
+
+    // Storage gets full of entries that expire
+    Afina::Storage::Meta soon;
+    soon.expire = start + 10;
+    int stored = 0;
+    while (evictions.empty()) {
+        EXPECT_TRUE(storage.Put("OLD" + std::to_string(stored++), "value", soon));
+    }
+
+    // Once they expire their space is free without any eviction, though nobody has touched them
+    evictions.clear();
+    storage.moment = start + 10;
+    for (int i = 0; i + 1 < stored; i++) {
+        EXPECT_TRUE(storage.Put("NEW" + std::to_string(i), "value"));
+    }
+    EXPECT_TRUE(evictions.empty()) << evictions.size();
+}
+
+TEST(StorageTest, ExpiredDroppedEverywhere) {
+    int64_t start = std::time(nullptr);
+    ManualClock<TinyLFU> lfu(4096, start);
+    ExpiredDroppedOf(lfu);
+    ManualClock<ARC> arc(4096, start);
+    ExpiredDroppedOf(arc);
+    ManualClock<EpochStripedLRU> epoch(4096, 1, start);
+    ExpiredDroppedOf(epoch);
+}
+
+TEST(StorageTest, ExpireEntriesEverywhere) {
+    int64_t start = std::time(nullptr);
+    ManualClock<TinyLFU> lfu(4096, start);
+    ExpireEntriesOf(lfu);
+    ManualClock<ARC> arc(4096, start);
+    ExpireEntriesOf(arc);
+    ManualClock<EpochStripedLRU> epoch(4096, start);
+    ExpireEntriesOf(epoch);
+
+    // Backend without expiration support refuses association that expires later
+    struct : public Afina::Storage {
+        bool Put(const std::string &key, const std::string &value) override { return true; }
+        bool PutIfAbsent(const std::string &key, const std::string &value) override { return true; }
+        bool Set(const std::string &key, const std::string &value) override { return true; }
+        bool Delete(const std::string &key) override { return true; }
+        bool Get(const std::string &key, std::string &value) override { return false; }
+    } backend;
+    Afina::Storage &plain = backend;
+    Afina::Storage::Meta later;
+    later.expire = start + 1000;
+    EXPECT_FALSE(plain.Put("KEY", "val", later));
+    EXPECT_TRUE(plain.Put("KEY", "val", Afina::Storage::Meta()));
+    std::string out;
+    Set("KEY", 0, 1000).Execute(plain, "val", out);
+    EXPECT_EQ(out, "NOT_STORED");
+}
+
+namespace {
+
+struct timer_node {
+    timer_node *timer_prev;
+    timer_node *timer_next;
+    uint8_t timer_slot;
+    uint32_t expire;
+};
+
+} // namespace
+
+TEST(TimerWheelTest, ExpireInOrder) {
+    const uint32_t start = 1000000;
+    TimerWheel<timer_node> wheel(start);
+
+    // Expiration times across all levels of the wheel and beyond
+    std::vector<uint32_t> delays = {1, 2, 63, 64, 65, 100, 4095, 4096, 5000, 300000, 20000000, 40000000};
+    std::vector<timer_node> nodes(delays.size());
+    for (size_t i = 0; i < delays.size(); i++) {
+        nodes[i].expire = start + delays[i];
+        wheel.add(nodes[i]);
+    }
+    EXPECT_EQ(wheel.size(), delays.size());
+
+    // Removed element never expires
+    wheel.remove(nodes[5]);
+    EXPECT_EQ(wheel.size(), delays.size() - 1);
+
+    std::vector<uint32_t> expired;
+    uint32_t now = start;
+    while (wheel.size() > 0) {
+        now += 37;
+        wheel.advance(now, [&](timer_node &node) {
+            EXPECT_LE(node.expire, now);
+            EXPECT_GT(node.expire + 37, now);
+            expired.push_back(node.expire - start);
+        });
+    }
+
+    delays.erase(delays.begin() + 5);
+    EXPECT_EQ(expired, delays);
+}
+
+TEST(TinyLFUTest, PutGetDelete) {
+    TinyLFU storage;
+
+    EXPECT_TRUE(storage.Put("KEY1", "val1"));
+    EXPECT_TRUE(storage.Put("KEY2", "val2"));
+    EXPECT_FALSE(storage.PutIfAbsent("KEY1", "val3"));
+    EXPECT_TRUE(storage.Set("KEY1", "val11"));
+    EXPECT_FALSE(storage.Set("KEY3", "val3"));
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_TRUE(value == "val11");
+    EXPECT_TRUE(storage.Get("KEY2", value));
+    EXPECT_TRUE(value == "val2");
+
+    EXPECT_TRUE(storage.Delete("KEY1"));
+    EXPECT_FALSE(storage.Delete("KEY1"));
+    EXPECT_FALSE(storage.Get("KEY1", value));
+}
+
+TEST(TinyLFUTest, ScanResistance) {
+    const size_t length = 20;
+    TinyLFU storage(1000 * TinyLFU::EntrySize(length, length));
+
+    // Hot set is accessed many times
+    for (int round = 0; round < 5; ++round) {
+        for (long i = 0; i < 500; ++i) {
+            auto key = pad_space("Hot " + std::to_string(i), length);
+            std::string res;
+            if (!storage.Get(key, res)) {
+                EXPECT_TRUE(storage.Put(key, pad_space("Val " + std::to_string(i), length)));
+            }
+        }
+    }
+
+    // Single pass over many keys that are never used again
+    for (long i = 0; i < 10000; ++i) {
+        EXPECT_TRUE(storage.Put(pad_space("Scan " + std::to_string(i), length), pad_space("Val", length)));
+    }
+
+    long hits = 0;
+    for (long i = 0; i < 500; ++i) {
+        std::string res;
+        hits += storage.Get(pad_space("Hot " + std::to_string(i), length), res);
+    }
+    EXPECT_GT(hits, 450);
+}
+
+TEST(ARCTest, PutGetDelete) {
+    ARC storage;
+
+    EXPECT_TRUE(storage.Put("KEY1", "val1"));
+    EXPECT_TRUE(storage.Put("KEY2", "val2"));
+    EXPECT_FALSE(storage.PutIfAbsent("KEY1", "val3"));
+    EXPECT_TRUE(storage.Set("KEY1", "val11"));
+    EXPECT_FALSE(storage.Set("KEY3", "val3"));
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_TRUE(value == "val11");
+    EXPECT_TRUE(storage.Get("KEY2", value));
+    EXPECT_TRUE(value == "val2");
+
+    EXPECT_TRUE(storage.Delete("KEY1"));
+    EXPECT_FALSE(storage.Delete("KEY1"));
+    EXPECT_FALSE(storage.Get("KEY1", value));
+}
+
+TEST(ARCTest, FrequentSurvivesScan) {
+    const size_t length = 20;
+    ARC storage(100 * ARC::EntrySize(length, length));
+
+    // Entries accessed twice get to T2
+    for (int round = 0; round < 2; ++round) {
+        for (long i = 0; i < 50; ++i) {
+            auto key = pad_space("Hot " + std::to_string(i), length);
+            std::string res;
+            if (!storage.Get(key, res)) {
+                EXPECT_TRUE(storage.Put(key, pad_space("Val " + std::to_string(i), length)));
+            }
+        }
+    }
+
+    // Scan only cycles through T1
+    for (long i = 0; i < 1000; ++i) {
+        EXPECT_TRUE(storage.Put(pad_space("Scan " + std::to_string(i), length), pad_space("Val", length)));
+    }
+
+    for (long i = 0; i < 50; ++i) {
+        std::string res;
+        EXPECT_TRUE(storage.Get(pad_space("Hot " + std::to_string(i), length), res));
+        EXPECT_TRUE(res == pad_space("Val " + std::to_string(i), length));
+    }
+}